@@ -12,7 +12,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <array>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
 
 #include "helpers/Logger.h"
 
@@ -21,6 +28,28 @@
 #include "Model.h"
 #include "stb_image.h"
 #include "Texture.h"
+#include "Cubemap.h"
+#include "SamplerCache.h"
+#include "ShadowAtlas.h"
+#include "ShadowCascades.h"
+#include "GLState.h"
+#include "GBuffer.h"
+#include "GpuCulling.h"
+#include "GpuMemoryTracker.h"
+#include "ImageBasedLighting.h"
+#include "InstanceBuffer.h"
+#include "LightClusters.h"
+#include "RenderQueue.h"
+#include "RenderThread.h"
+#include "Benchmarks.h"
+#include "ShaderBatch.h"
+#include "ShaderPermutations.h"
+#include "TransformBatch.h"
+#include "TransformBenchmark.h"
+#include "UniformBlocks.h"
+#include "UniformRing.h"
+#include "helpers/AllocationCounter.h"
+#include "helpers/GLExtensions.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -29,6 +58,9 @@ void error_callback(int error, const char* description);
 void processInput(GLFWwindow* window);
 
 void CenterWindow(GLFWwindow* window, GLFWmonitor* monitor);
+std::vector<PointLight> CreatePointLights(int count, const glm::vec3* fixedPositions, int fixedCount);
+void GetFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+bool IsSphereInFrustum(const glm::vec4 planes[6], const glm::vec3& center, float radius);
 
 int screenWidth = 1280;
 int screenHeight = 720;
@@ -41,13 +73,72 @@ bool firstMouse = true;
 
 bool gameModeKeyDown = false;
 bool flashLightOn = false;
+// Moves the red box around so the shadow atlas has a caster to track
+bool animateRedBox = false;
 bool flashLightKeyDown = false;
+bool reloadShaders = false;
+bool reloadShadersKeyDown = false;
+
+LightingFeatures lightingFeatures;
+
+// Deferred shading of the lit meshes instead of forward
+bool deferredShading = false;
+
+// Clustered lighting, the light count is 2^clusteredLightExponent
+int clusteredLightExponent = 2;
+const int MAX_CLUSTERED_LIGHT_EXPONENT = 12;
+// Steps through every light count from 4 to 4096 and logs the cost of each, -1 when not running
+int lightSweepExponent = -1;
+int lightSweepFrame = 0;
+float lightSweepBinMs = 0.0f;
+const int LIGHT_SWEEP_FRAMES = 60;
+
+bool uniformBenchmark = false;
+// Dense spheres with the per-vertex inverse() against the CPU computed matrices
+bool transformBenchmark = false;
+
+// Spinning boxes around the scene and a grid of nanosuits, one instanced draw per mesh
+bool instancedProps = false;
+int propCount = 1024;
+const int MAX_PROPS = 16384;
+bool instancedCrowd = false;
+int crowdSize = 4;	// crowdSize * crowdSize nanosuits
+const int MAX_CROWD_SIZE = 8;
+
+// A field of props culled against the frustum and last frame's depth by a compute shader
+bool gpuCulling = false;
+int gpuCulledObjects = 16384;
+
+// The debug windows of the subsystems on the render thread. Off by default: the main thread waits
+// for the render thread to draw them, which stops the two frames from overlapping.
+bool rendererWindows = false;
+
+// What the render thread measured in its last frame, published for the main thread's UI
+struct RendererStats
+{
+	// Last GPU time of the forward and deferred paths, for comparison
+	float m_forwardGpuMs;
+	float m_geometryGpuMs;
+	float m_deferredLightingGpuMs;
+	size_t m_lightCount;
+	float m_lightBinMs;
+	unsigned int m_lightWorkers;
+	size_t m_lightIndexCount;
+	int m_maxLightsPerCluster;
+	size_t m_drawLoopAllocations;
+	Benchmarks::UniformResult m_uniformBenchmark;
+};
+std::mutex rendererStatsMutex;
+RendererStats publishedStats = {};
 
 float deltaTime = 0.0f; // Time between current frame and last frame
 float lastFrame = 0.0f; // Time of last frame
 
 int main()
 {
+	auto startupBegin = std::chrono::high_resolution_clock::now();
+	bool firstFrame = true;
+
 	Logger::Init();
 	
 	GLFWwindow* window;
@@ -95,6 +186,16 @@ int main()
 		return -1;
 	}
 
+	// Declared before every object that owns GL resources, so it is destroyed after them
+	// and their destructors still run with a live context
+	struct GlfwTerminator
+	{
+		~GlfwTerminator() { glfwTerminate(); }
+	} glfwTerminator;
+
+	GLExtensions::Init((GLADloadproc)glfwGetProcAddress);
+	ShaderBatch::EnableParallelCompile();
+
 	// Initialize ImGui
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -110,7 +211,11 @@ int main()
 	ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init(glsl_version);
 
-	glEnable(GL_DEPTH_TEST);
+	GLState::Invalidate();
+	GLState::SetDepthTest(true);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	SamplerCache::Init();
 
 	std::stringstream ss;
 	ss << "--------------------------------\n";
@@ -171,65 +276,360 @@ int main()
 	glGenVertexArrays(1, &boxVAO);
 	glGenBuffers(1, &boxVBO);
 
-	glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, boxVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(boxVertices), boxVertices, GL_STATIC_DRAW);
+	GpuMemoryTracker::TrackBuffer(boxVBO, sizeof(boxVertices), GpuMemoryCategory::VertexBuffer, "boxVBO", "vec3");
 
-	glBindVertexArray(boxVAO);
+	GLState::BindVertexArray(boxVAO);
 
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
 
 
-	Shader shaderRed("res/shaders/ubo_test.vs", "res/shaders/ubo_test_red.fs");
-	Shader shaderGreen("res/shaders/ubo_test.vs", "res/shaders/ubo_test_green.fs");
-	Shader shaderBlue("res/shaders/ubo_test.vs", "res/shaders/ubo_test_blue.fs");
-	Shader shaderYellow("res/shaders/ubo_test.vs", "res/shaders/ubo_test_yellow.fs");
+	// Used in place of any box program that is still compiling
+	Shader fallbackShader("res/shaders/ubo_test.vs", "res/shaders/light_fragment.glsl");
+
+	// Everything else is submitted up front and compiles while we load assets
+	ShaderBatch shaderBatch;
+	Shader shaderRed("res/shaders/ubo_test.vs", "res/shaders/ubo_test_red.fs", ShaderCompileMode::Deferred);
+	Shader shaderGreen("res/shaders/ubo_test.vs", "res/shaders/ubo_test_green.fs", ShaderCompileMode::Deferred);
+	Shader shaderBlue("res/shaders/ubo_test.vs", "res/shaders/ubo_test_blue.fs", ShaderCompileMode::Deferred);
+	Shader shaderYellow("res/shaders/ubo_test.vs", "res/shaders/ubo_test_yellow.fs", ShaderCompileMode::Deferred);
+	Shader skyboxShader("res/shaders/skybox_vertex.glsl", "res/shaders/skybox_fragment.glsl", ShaderCompileMode::Deferred);
+	shaderBatch.Add(shaderRed);
+	shaderBatch.Add(shaderGreen);
+	shaderBatch.Add(shaderBlue);
+	shaderBatch.Add(shaderYellow);
+	shaderBatch.Add(skyboxShader);
+	Shader propShader("res/shaders/ubo_test_instanced.vs", "res/shaders/ubo_test_instanced.fs", ShaderCompileMode::Deferred);
+	shaderBatch.Add(propShader);
+
+	// Every lighting permutation up front, so toggling a light never waits on the compiler. The image
+	// based ambient is off by default, its variants are submitted the first frame it is switched on.
+	ShaderPermutations litPermutations("res/shaders/lit_vertex.glsl", "res/shaders/lit_fragment.glsl", LightingFeatures::GetDefines);
+	litPermutations.Prewarm(LightingFeatures::GetAllKeys(false));
+
+	// Deferred path: the geometry pass only cares about the specular map, the lighting pass about
+	// everything else since the specular mask is read from the G-buffer
+	LightingFeatures geometryFeatures;
+	geometryFeatures.m_pointLights = 0;
+	geometryFeatures.m_dirLight = false;
+	geometryFeatures.m_imageBasedLighting = false;
+	ShaderPermutations gBufferPermutations("res/shaders/lit_vertex.glsl", "res/shaders/gbuffer_fragment.glsl", LightingFeatures::GetDefines);
+	std::vector<uint32_t> geometryKeys;
+	for (bool specularMap : { false, true })
+	{
+		geometryFeatures.m_specularMap = specularMap;
+		geometryKeys.push_back(geometryFeatures.GetKey());
+	}
+	gBufferPermutations.Prewarm(geometryKeys);
+
+	auto getDeferredKeys = [](bool imageBasedLighting)
+	{
+		std::vector<uint32_t> keys;
+		for (uint32_t key : LightingFeatures::GetAllKeys(imageBasedLighting))
+		{
+			if (LightingFeatures::FromKey(key).m_specularMap)
+				keys.push_back(key);
+		}
+		return keys;
+	};
+	ShaderPermutations deferredPermutations("res/shaders/framebuffer_vertex.glsl", "res/shaders/deferred_fragment.glsl", LightingFeatures::GetDefines);
+	deferredPermutations.Prewarm(getDeferredKeys(false));
+	bool iblPermutationsSubmitted = false;
+
+	// The lit permutations again with the per-object matrices read per instance, compiled on first use
+	ShaderPermutations crowdPermutations("res/shaders/lit_vertex_instanced.glsl", "res/shaders/lit_fragment.glsl", LightingFeatures::GetDefines);
+	InstanceBuffer crowdInstances(MAX_CROWD_SIZE * MAX_CROWD_SIZE, "crowd");
+	InstanceBuffer propInstances(MAX_PROPS, "props");
+	// Created the first time GPU culling is switched on, with its shaders and MAX_OBJECTS sized buffers
+	std::unique_ptr<GpuCulling> gpuCulledField;
+	GBuffer gBuffer;
+	ShadowCascades shadowCascades;
+	bool shadowsBlockValidated = false;
+	ShadowAtlas shadowAtlas;
+	bool shadowAtlasBlockValidated = false;
+	// Created the first time the benchmark is switched on, its spheres and shaders are only for it
+	std::unique_ptr<TransformBenchmark> transformStress;
+
+	// Skybox
+	std::vector<std::string> skyboxFaces = {
+		"res/textures/skybox/right.jpg",
+		"res/textures/skybox/left.jpg",
+		"res/textures/skybox/top.jpg",
+		"res/textures/skybox/bottom.jpg",
+		"res/textures/skybox/front.jpg",
+		"res/textures/skybox/back.jpg"
+	};
+	Cubemap skybox(skyboxFaces, "cache/skybox.cubemap");
+	ImageBasedLighting imageBasedLighting(skybox, "cache/skybox.ibl");
+	bool environmentBlockValidated = false;
+
+	// Lit scene
+	Model nanosuit("res/models/nanosuit/nanosuit.obj");
+
+	const glm::mat4 nanosuitModel = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.75f, -3.0f)), glm::vec3(0.2f));
+	glm::vec3 boxPositions[] = {
+		glm::vec3(-0.75f, 0.75f, 0.0f),		// top-left
+		glm::vec3(0.75f, 0.75f, 0.0f),		// top-right
+		glm::vec3(-0.75f, -0.75f, 0.0f),	// bottom-left
+		glm::vec3(0.75f, -0.75f, 0.0f)		// bottom-right
+	};
+	const glm::vec3 redBoxHome = boxPositions[0];
+	const float boxRadius = 0.87f;	// bounding sphere of the unit box
+
+	// Model, MVP and normal matrices of every object, recomputed once per frame. Each object also
+	// has a bounding sphere in its own space and, for the boxes, the flat program it is drawn with.
+	Shader* boxShaders[] = { &shaderRed, &shaderGreen, &shaderBlue, &shaderYellow };
+	TransformBatch objectTransforms(1 + std::size(boxPositions));
+	std::vector<glm::vec4> objectBounds;
+	std::vector<Shader*> objectShaders;
+	auto addObject = [&](const glm::mat4& model, const glm::vec4& bounds, Shader* shader)
+	{
+		objectBounds.push_back(bounds);
+		objectShaders.push_back(shader);
+		return objectTransforms.Add(model);
+	};
+	// The nanosuit's sphere is around its chest
+	const int nanosuitObject = addObject(nanosuitModel, glm::vec4(0.0f, 7.7f, 0.0f, 8.9f), nullptr);
+	std::vector<int> boxObjects;
+	for (size_t i = 0; i < std::size(boxPositions); i++)
+		boxObjects.push_back(addObject(glm::translate(glm::mat4(1.0f), boxPositions[i]), glm::vec4(0.0f, 0.0f, 0.0f, boxRadius), boxShaders[i % std::size(boxShaders)]));
+
+	// Collects each pass's draws and issues them sorted by state, reused every frame
+	// Camera, lights and per-draw matrices, written into a fresh slice every frame
+	UniformRing frameUniforms(64 * 1024, "frame");
+	RenderQueue renderQueue(frameUniforms);
+
+	glm::vec3 pointLightPositions[] = {
+		glm::vec3(0.7f, 0.2f, 2.0f),
+		glm::vec3(2.3f, -3.3f, -4.0f),
+		glm::vec3(-4.0f, 2.0f, -12.0f),
+		glm::vec3(0.0f, 0.0f, -3.0f)
+	};
 
 
-	unsigned int uniformBlockIndexRed		= glGetUniformBlockIndex(shaderRed.GetId(), "Matrices");
-	unsigned int uniformBlockIndexGreen		= glGetUniformBlockIndex(shaderGreen.GetId(), "Matrices");
-	unsigned int uniformBlockIndexBlue		= glGetUniformBlockIndex(shaderBlue.GetId(), "Matrices");
-	unsigned int uniformBlockIndexYellow	= glGetUniformBlockIndex(shaderYellow.GetId(), "Matrices");
+	// The first four are the lights of the fixed point light array, the rest are scattered around the scene
+	LightClusters lightClusters;
+	int clusteredLightCount = 1 << clusteredLightExponent;
+	lightClusters.SetLights(CreatePointLights(clusteredLightCount, pointLightPositions, 4));
+	bool clusterParamsValidated = false;
+
+	// The Matrices and Object blocks are bound to points 0 and 6 in the shaders themselves, so
+	// nothing has to query the (possibly still compiling) programs here. The fallback program is
+	// already linked, so the C++ mirrors are checked against it.
+	ValidateUniformBlock<MatricesBlock>(fallbackShader);
+	ValidateUniformBlock<ObjectBlock>(fallbackShader);
+
+	// Camera and lights for every lit program, written once per frame. The lights never move
+	// except for the spotlight, so everything else is filled in here once.
+	static_assert(FrameBlock::MAX_POINT_LIGHTS == LightingFeatures::MAX_POINT_LIGHTS, "include/frame.glsl holds every point light a permutation can use");
+	FrameBlock frame = {};
+	frame.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	frame.dirLight.ambient = glm::vec3(0.05f);
+	frame.dirLight.diffuse = glm::vec3(0.4f);
+	frame.dirLight.specular = glm::vec3(0.5f);
+	for (int i = 0; i < FrameBlock::MAX_POINT_LIGHTS; i++)
+	{
+		PointLightStd140& light = frame.pointLights[i];
+		light.position = pointLightPositions[i];
+		light.ambient = glm::vec3(0.05f);
+		light.diffuse = glm::vec3(0.8f);
+		light.specular = glm::vec3(1.0f);
+		light.constant = 1.0f;
+		light.linear = 0.09f;
+		light.quadratic = 0.032f;
+	}
+	frame.spotLight.ambient = glm::vec3(0.0f);
+	frame.spotLight.diffuse = glm::vec3(1.0f);
+	frame.spotLight.specular = glm::vec3(1.0f);
+	frame.spotLight.constant = 1.0f;
+	frame.spotLight.linear = 0.09f;
+	frame.spotLight.quadratic = 0.032f;
+	frame.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+	frame.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+
+	bool frameBlockValidated = false;
+
+	// The packet the render thread is drawing, for the callbacks below that are built once
+	const FramePacket* renderedPacket = nullptr;
+
+	// Once per bound program, the camera and lights come from the Frame block and the per-object
+	// matrices are set by the render queue
+	std::function<void(const Shader&)> setupLitShader = [&](const Shader& litShader)
+	{
+		litShader.SetFloat("material.shininess", 32.0f);
 
-	glUniformBlockBinding(shaderRed.GetId(), uniformBlockIndexRed, 0);
-	glUniformBlockBinding(shaderGreen.GetId(), uniformBlockIndexGreen, 0);
-	glUniformBlockBinding(shaderBlue.GetId(), uniformBlockIndexBlue, 0);
-	glUniformBlockBinding(shaderYellow.GetId(), uniformBlockIndexYellow, 0);
+		// Every lit variant shares these blocks, checking the first one that is drawn is enough
+		if (!frameBlockValidated && litShader.FindUniformBlock("Frame"))
+		{
+			ValidateUniformBlock<FrameBlock>(litShader);
+			frameBlockValidated = true;
+		}
+		if (renderedPacket->m_lighting.m_clustered && !clusterParamsValidated && litShader.FindUniformBlock("ClusterParams"))
+		{
+			ValidateUniformBlock<ClusterParamsBlock>(litShader);
+			clusterParamsValidated = true;
+		}
+		if (!shadowsBlockValidated && litShader.FindUniformBlock("Shadows"))
+		{
+			ValidateUniformBlock<ShadowsBlock>(litShader);
+			shadowsBlockValidated = true;
+		}
+		if (!shadowAtlasBlockValidated && litShader.FindUniformBlock("ShadowAtlas"))
+		{
+			ValidateUniformBlock<ShadowAtlasBlock>(litShader);
+			shadowAtlasBlockValidated = true;
+		}
+		if (!environmentBlockValidated && litShader.FindUniformBlock("Environment"))
+		{
+			ValidateUniformBlock<EnvironmentBlock>(litShader);
+			environmentBlockValidated = true;
+		}
+	};
 
-	unsigned int uboMatrices;
-	glGenBuffers(1, &uboMatrices);
+	// Everything in the scene casts shadows, the depth program is bound by ShadowCascades
+	std::function<void(const Shader&)> drawShadowCasters = [&](const Shader& depthShader)
+	{
+		depthShader.SetMat4("model", renderedPacket->m_objects[nanosuitObject].m_model);
+		nanosuit.DrawDepth();
 
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);	// Allocate enough data for the uniform buffer
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		GLState::BindVertexArray(boxVAO);
+		for (int box : boxObjects)
+		{
+			depthShader.SetMat4("model", renderedPacket->m_objects[box].m_model);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+		}
+	};
 
-	glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
+	// Range of the fixed point lights and the spotlight, which share their attenuation
+	const PointLightStd140& firstPointLight = frame.pointLights[0];
+	const float pointLightRadius = LightClusters::GetLightRadius({ firstPointLight.position, firstPointLight.ambient, firstPointLight.diffuse, firstPointLight.specular,
+		firstPointLight.constant, firstPointLight.linear, firstPointLight.quadratic });
+	const float spotLightRadius = LightClusters::GetLightRadius({ glm::vec3(0.0f), frame.spotLight.ambient, frame.spotLight.diffuse, frame.spotLight.specular,
+		frame.spotLight.constant, frame.spotLight.linear, frame.spotLight.quadratic });
 
-	// Loop until the user closes the window
-	while (!glfwWindowShouldClose(window))
+	// Only programs whose files (or #includes) were edited get rebuilt
+	std::function<void()> reloadChangedShaders = [&]()
 	{
-		// DeltaTime calculation
-		float currentFrame = float(glfwGetTime());
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
+		fallbackShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+		for (Shader* shader : { &shaderRed, &shaderGreen, &shaderBlue, &shaderYellow, &skyboxShader, &propShader })
+		{
+			if (shader->ReloadIfChanged(ShaderCompileMode::Deferred))
+				shaderBatch.Add(*shader);
+		}
+		litPermutations.ReloadChanged();
+		gBufferPermutations.ReloadChanged();
+		deferredPermutations.ReloadChanged();
+		crowdPermutations.ReloadChanged();
+		shadowCascades.ReloadShaders();
+		shadowAtlas.ReloadShaders();
+		if (transformStress)
+			transformStress->ReloadShaders();
+		if (gpuCulledField)
+			gpuCulledField->ReloadShaders();
+	};
 
-		// Input
-		processInput(window);
+	// The debug windows of everything that lives on the render thread, drawn there while the main
+	// thread waits in the middle of its ImGui frame
+	std::function<void()> drawRendererWindows = [&]()
+	{
+		GpuMemoryTracker::DrawImGui();
+		GLState::DrawImGui();
+		litPermutations.DrawImGui("Lit permutations");
+		if (deferredShading)
+			deferredPermutations.DrawImGui("Deferred lighting permutations");
+		if (lightingFeatures.m_dirLight && lightingFeatures.m_dirShadows)
+			shadowCascades.DrawImGui("Shadow cascades");
+		if (lightingFeatures.m_localShadows && LightingFeatures::FromKey(lightingFeatures.GetKey()).m_localShadows)
+			shadowAtlas.DrawImGui("Shadow atlas");
+		if (lightingFeatures.m_imageBasedLighting)
+			imageBasedLighting.DrawImGui("Image based lighting");
+		if (transformBenchmark && transformStress)
+			transformStress->DrawImGui("Transform benchmark");
+		renderQueue.DrawImGui("Render queue");
+		frameUniforms.DrawImGui("Frame uniforms");
+		if (instancedProps)
+			propInstances.DrawImGui("Instanced props");
+		if (instancedCrowd)
+			crowdInstances.DrawImGui("Instanced crowd");
+		if (gpuCulling && gpuCulledField)
+			gpuCulledField->DrawImGui("GPU culling");
+	};
 
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+	RendererStats renderedStats = {};
+
+	// Every GL call of a frame, made on the render thread from what the main thread put in the packet
+	std::function<void(const FramePacket&)> renderFrame = [&](const FramePacket& packet)
+	{
+		renderedPacket = &packet;
+		const LightingFeatures& lighting = packet.m_lighting;
+		const float aspect = (float)packet.m_width / (float)packet.m_height;
+
+		GLState::BeginFrame();
+		glViewport(0, 0, packet.m_width, packet.m_height);
 
 		// ==============================================================
 		// Rendering Preparation
 		// ==============================================================
 		// Now we only have to set our view and projection matrices once per frame.
-		glm::mat4 projection = glm::perspective(glm::radians(camera.GetZoom()), (float)screenWidth / (float)screenHeight, 0.1f, 1000.0f);
-		glm::mat4 view = camera.GetViewMatrix();
-		glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		size_t allocationsBefore = AllocationCounter::GetThreadCount();
+
+		frameUniforms.Begin();
+		frameUniforms.Bind<MatricesBlock>(0, frameUniforms.Push(MatricesBlock{ packet.m_projection, packet.m_view }));
+
+		frame.view = packet.m_view;
+		frame.projection = packet.m_projection;
+		frame.inverseViewProjection = glm::inverse(packet.m_projection * packet.m_view);
+		frame.viewPos = packet.m_cameraPosition;
+		frame.spotLight.position = packet.m_cameraPosition;
+		frame.spotLight.direction = packet.m_cameraDirection;
+		frameUniforms.Bind<FrameBlock>(2, frameUniforms.Push(frame));
+
+		// Shadow maps first, they leave their own framebuffer and viewport bound
+		if (packet.m_dirShadows)
+		{
+			shadowCascades.Update(packet.m_view, packet.m_fieldOfView, aspect, 0.1f, frame.dirLight.direction);
+			shadowCascades.Render(drawShadowCasters);
+			glViewport(0, 0, packet.m_width, packet.m_height);
+			shadowCascades.Bind(frameUniforms);
+		}
+
+		// The tiles of the casters that moved have to be rendered again
+		for (const glm::vec4& bounds : packet.m_movedCasters)
+			shadowAtlas.MarkDirty(glm::vec3(bounds), bounds.w);
+
+		if (packet.m_localShadows)
+		{
+			for (int i = 0; i < ShadowAtlas::MAX_POINT_LIGHTS; i++)
+			{
+				bool castsShadow = !lighting.m_clustered && i < lighting.m_pointLights;
+				shadowAtlas.SetPointLight(i, castsShadow, frame.pointLights[i].position, pointLightRadius);
+			}
+			shadowAtlas.SetSpotLight(lighting.m_spotLight, frame.spotLight.position, frame.spotLight.direction, frame.spotLight.outerCutOff, spotLightRadius);
+			shadowAtlas.Update(packet.m_cameraPosition);
+			shadowAtlas.Render(drawShadowCasters);
+			glViewport(0, 0, packet.m_width, packet.m_height);
+			shadowAtlas.Bind(frameUniforms);
+		}
+
+		// Bin the lights for this view, the lit variants read the results from the SSBOs
+		lightClusters.SetProjection(packet.m_fieldOfView, aspect, 0.1f, 1000.0f, packet.m_width, packet.m_height);
+		if (lighting.m_clustered)
+		{
+			lightClusters.Update(packet.m_view);
+			lightClusters.Bind();
+		}
+		if (lighting.m_imageBasedLighting)
+		{
+			if (!iblPermutationsSubmitted)
+			{
+				litPermutations.Prewarm(LightingFeatures::GetAllKeys(true));
+				deferredPermutations.Prewarm(getDeferredKeys(true));
+				iblPermutationsSubmitted = true;
+			}
+			imageBasedLighting.Bind();
+		}
 
 		// ==============================================================
 		// Rendering
@@ -238,51 +638,392 @@ int main()
 		glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glm::mat4 model = glm::mat4(1.0f);
-
-		// Red box
-		glBindVertexArray(boxVAO);
-		model = glm::translate(glm::mat4(1.0f), glm::vec3(-0.75f, 0.75f, 0.0f)); // move top-left
-		shaderRed.Use();
-		shaderRed.SetMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-		// Green box
-		glBindVertexArray(boxVAO);
-		model = glm::translate(glm::mat4(1.0f), glm::vec3(0.75f, 0.75f, 0.0f)); // move top-right
-		shaderGreen.Use();
-		shaderGreen.SetMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		
-		// Blue box
-		glBindVertexArray(boxVAO);
-		model = glm::translate(glm::mat4(1.0f), glm::vec3(-0.75f, -0.75f, 0.0f)); // move bottom-left
-		shaderBlue.Use();
-		shaderBlue.SetMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		
-		// Yellow box
-		glBindVertexArray(boxVAO);
-		model = glm::translate(glm::mat4(1.0f), glm::vec3(0.75f, -0.75f, 0.0f)); // move bottom-right
-		shaderYellow.Use();
-		shaderYellow.SetMat4("model", model);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		// Finalize whatever finished compiling since last frame, never blocks
+		shaderBatch.Poll();
+
+		// Nanosuit, every mesh gets the smallest lit permutation for the enabled lights. Drawn before
+		// the boxes, since the deferred lighting pass writes depth over everything it shades.
+		litPermutations.Poll();
+		gBufferPermutations.Poll();
+		deferredPermutations.Poll();
+		crowdPermutations.Poll();
+		bool nanosuitVisible = std::find(packet.m_visibleObjects.begin(), packet.m_visibleObjects.end(), nanosuitObject) != packet.m_visibleObjects.end();
+		if (packet.m_deferredShading)
+		{
+			gBuffer.Resize(packet.m_width, packet.m_height);
+			gBuffer.BeginGeometryPass();
+			renderQueue.Begin(packet.m_view);
+			if (nanosuitVisible)
+				nanosuit.Submit(renderQueue, gBufferPermutations, geometryFeatures, packet.m_objects[nanosuitObject], setupLitShader);
+			renderQueue.Execute();
+			gBuffer.EndGeometryPass();
+
+			// The specular mask comes from the G-buffer, so one lighting variant covers every mesh
+			LightingFeatures deferredFeatures = lighting;
+			deferredFeatures.m_specularMap = true;
+			uint32_t deferredKey = deferredFeatures.GetKey();
+			Shader& deferredShader = deferredPermutations.Get(deferredKey);
+			if (deferredShader.IsReady())
+			{
+				GpuTimer& timer = deferredPermutations.GetTimer(deferredKey);
+				timer.Begin();
+				deferredShader.Use();
+				setupLitShader(deferredShader);
+				gBuffer.BindTextures(deferredShader, 0);
+				gBuffer.DrawLightingPass();
+				timer.End();
+			}
+		}
+
+		// Forward pass, everything lit or flat goes through the queue and is drawn in state order
+		renderQueue.Begin(packet.m_view);
+		for (int object : packet.m_visibleObjects)
+		{
+			if (object == nanosuitObject)
+			{
+				if (!packet.m_deferredShading)
+					nanosuit.Submit(renderQueue, litPermutations, lighting, packet.m_objects[object], setupLitShader);
+				continue;
+			}
+
+			Shader* boxShader = objectShaders[object];
+			if (!boxShader->IsReady())
+				boxShader = &fallbackShader;
+			RenderItem box = { boxShader, nullptr, boxVAO, 36, &packet.m_objects[object], nullptr, nullptr };
+			renderQueue.Submit(RenderPass::Opaque, box);
+		}
+		renderQueue.Execute();
+
+		// A disc of small boxes turning around the scene, rewritten every frame
+		if (!packet.m_props.empty() && propShader.IsReady())
+		{
+			propInstances.Begin();
+			propInstances.Add(packet.m_props.data(), int(packet.m_props.size()));
+			propShader.Use();
+			propInstances.Bind();
+			propInstances.DrawArrays(boxVAO, 36);
+			propInstances.End();
+		}
+
+		// Nanosuits in rows behind the scene, lit like the real one
+		if (!packet.m_crowd.empty())
+		{
+			crowdInstances.Begin();
+			crowdInstances.Add(packet.m_crowd.data(), int(packet.m_crowd.size()));
+			crowdInstances.Bind();
+			nanosuit.DrawInstanced(crowdInstances, crowdPermutations, lighting, setupLitShader);
+			crowdInstances.End();
+		}
+
+		// Props culled and drawn without the CPU touching a single one of them
+		if (packet.m_gpuCulledObjects > 0)
+		{
+			if (!gpuCulledField)
+				gpuCulledField = std::make_unique<GpuCulling>();
+			if (gpuCulledField->GetObjectCount() != packet.m_gpuCulledObjects)
+				gpuCulledField->CreateObjects(packet.m_gpuCulledObjects);
+			gpuCulledField->Cull(packet.m_projection, packet.m_view);
+			gpuCulledField->Draw();
+		}
+
+		Shader& benchmarkShader = litPermutations.Get(lighting.GetKey());
+		if (packet.m_uniformBenchmark && benchmarkShader.IsReady())
+		{
+			renderedStats.m_uniformBenchmark = Benchmarks::UniformSetters(benchmarkShader, "material.shininess", 32.0f, 10000);
+		}
+		if (packet.m_transformBenchmark)
+		{
+			if (!transformStress)
+				transformStress = std::make_unique<TransformBenchmark>();
+			transformStress->Run();
+			glViewport(0, 0, packet.m_width, packet.m_height);
+		}
+
+		// Skybox, drawn last so only the uncovered pixels pass the depth test
+		if (skyboxShader.IsReady())
+		{
+			GLState::SetDepthFunc(GL_LEQUAL);
+			skyboxShader.Use();
+			skyboxShader.SetMat4("projection", packet.m_projection);
+			skyboxShader.SetMat4("view", glm::mat4(glm::mat3(packet.m_view))); // strip the translation
+			skyboxShader.SetInt("cubemap", 0);
+			skybox.Use(GL_TEXTURE0);
+			GLState::BindVertexArray(boxVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 36);
+			GLState::SetDepthFunc(GL_LESS);
+		}
+
+		// Every opaque draw is in, this depth is what next frame's GPU culling tests against
+		if (packet.m_gpuCulledObjects > 0)
+			gpuCulledField->UpdateDepthPyramid(0, packet.m_width, packet.m_height, packet.m_projection * packet.m_view);
 
 		// ==============================================================
 		// End Rendering
 		// ==============================================================
-		
+		frameUniforms.End();
 
+		renderedStats.m_drawLoopAllocations = AllocationCounter::GetThreadCount() - allocationsBefore;
 
 		// Draw ImGui at the end
+		GpuMemoryTracker::TrackImGui(packet.m_ui.Get());
+		if (packet.m_ui.Get())
+			ImGui_ImplOpenGL3_RenderDrawData(packet.m_ui.Get());
+		// ImGui binds its own program, VAO, texture and blend state
+		GLState::Invalidate();
+
+		// Only the path drawn this frame has fresh timings
+		if (packet.m_deferredShading)
+		{
+			renderedStats.m_geometryGpuMs = gBufferPermutations.GetFrameMilliseconds();
+			renderedStats.m_deferredLightingGpuMs = deferredPermutations.GetFrameMilliseconds();
+		}
+		else
+		{
+			renderedStats.m_forwardGpuMs = litPermutations.GetFrameMilliseconds();
+		}
+		renderedStats.m_lightCount = lightClusters.GetLightCount();
+		renderedStats.m_lightBinMs = lightClusters.GetBinMilliseconds();
+		renderedStats.m_lightWorkers = lightClusters.GetWorkerCount();
+		renderedStats.m_lightIndexCount = lightClusters.GetIndexCount();
+		renderedStats.m_maxLightsPerCluster = lightClusters.GetMaxLightsPerCluster();
+		{
+			std::lock_guard<std::mutex> lock(rendererStatsMutex);
+			publishedStats = renderedStats;
+		}
+
+		if (firstFrame)
+		{
+			firstFrame = false;
+			std::stringstream startup;
+			startup << "Startup to first frame: " << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startupBegin).count() << " ms";
+			Logger::LogSuccess(startup.str());
+		}
+	};
+
+	// ImGui draws with its own device objects, created here while the context is still current
+	ImGui_ImplOpenGL3_CreateDeviceObjects();
+	FilteringTier filteringTier = SamplerCache::GetFilteringTier();
+
+	// From here on only the render thread touches GL
+	RenderThread renderThread(window, renderFrame);
+	renderThread.Start();
+
+	// Loop until the user closes the window
+	while (!glfwWindowShouldClose(window))
+	{
+		// DeltaTime calculation
+		float currentFrame = float(glfwGetTime());
+		deltaTime = currentFrame - lastFrame;
+		lastFrame = currentFrame;
+
+		// Input
+		processInput(window);
+
+		RendererStats stats;
+		{
+			std::lock_guard<std::mutex> lock(rendererStatsMutex);
+			stats = publishedStats;
+		}
+
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+
+		ImGui::Begin("Renderer");
+		if (ImGui::BeginCombo("Texture filtering", SamplerCache::GetTierName(filteringTier)))
+		{
+			for (int i = 0; i <= int(FilteringTier::Anisotropic16x); i++)
+			{
+				FilteringTier tier = FilteringTier(i);
+				if (ImGui::Selectable(SamplerCache::GetTierName(tier), tier == filteringTier))
+				{
+					filteringTier = tier;
+					renderThread.Enqueue([tier]() { SamplerCache::SetFilteringTier(tier); });
+				}
+			}
+			ImGui::EndCombo();
+		}
+		ImGui::Checkbox("Directional light", &lightingFeatures.m_dirLight);
+		if (lightingFeatures.m_dirLight)
+			ImGui::Checkbox("Cascaded shadows", &lightingFeatures.m_dirShadows);
+		ImGui::Checkbox("Clustered point lights", &lightingFeatures.m_clustered);
+		if (lightingFeatures.m_clustered)
+		{
+			ImGui::SliderInt("Lights (2^n)", &clusteredLightExponent, 2, MAX_CLUSTERED_LIGHT_EXPONENT);
+			ImGui::Text("%zu lights, CPU binning %.3f ms on %u threads", stats.m_lightCount, stats.m_lightBinMs, stats.m_lightWorkers);
+			ImGui::Text("%zu light indices, max %d lights per cluster", stats.m_lightIndexCount, stats.m_maxLightsPerCluster);
+			if (lightSweepExponent < 0 && ImGui::Button("Sweep 4 -> 4096 lights"))
+			{
+				lightSweepExponent = 2;
+				lightSweepFrame = 0;
+				lightSweepBinMs = 0.0f;
+			}
+		}
+		else
+		{
+			ImGui::SliderInt("Point lights", &lightingFeatures.m_pointLights, 0, LightingFeatures::MAX_POINT_LIGHTS);
+		}
+		ImGui::Text("Spotlight: %s (F)", flashLightOn ? "on" : "off");
+		ImGui::Checkbox("Point and spot light shadows", &lightingFeatures.m_localShadows);
+		ImGui::Checkbox("Animate red box", &animateRedBox);
+		ImGui::Checkbox("Image based ambient", &lightingFeatures.m_imageBasedLighting);
+		ImGui::Checkbox("Deferred shading", &deferredShading);
+		ImGui::Text("Lit meshes GPU: forward %.3f ms, deferred %.3f ms", stats.m_forwardGpuMs, stats.m_geometryGpuMs + stats.m_deferredLightingGpuMs);
+		ImGui::Text("  (deferred: geometry %.3f ms + lighting %.3f ms)", stats.m_geometryGpuMs, stats.m_deferredLightingGpuMs);
+		if (ImGui::Button("Reload changed shaders (F5)"))
+			reloadShaders = true;
+		ImGui::Text("Heap allocations in draw loop: %zu", stats.m_drawLoopAllocations);
+		ImGui::Checkbox("Uniform benchmark (10k sets/frame)", &uniformBenchmark);
+		if (uniformBenchmark)
+		{
+			ImGui::Text("glGetUniformLocation: %.1f ns/set", stats.m_uniformBenchmark.m_uncachedNs);
+			ImGui::Text("Reflected cache:      %.1f ns/set", stats.m_uniformBenchmark.m_cachedNs);
+			ImGui::Text("Uniform<float>:       %.1f ns/set", stats.m_uniformBenchmark.m_handleNs);
+		}
+		ImGui::Checkbox("Transform benchmark", &transformBenchmark);
+		ImGui::Checkbox("Instanced props", &instancedProps);
+		if (instancedProps)
+			ImGui::SliderInt("Props", &propCount, 1, MAX_PROPS);
+		ImGui::Checkbox("Instanced nanosuit crowd", &instancedCrowd);
+		if (instancedCrowd)
+			ImGui::SliderInt("Crowd size", &crowdSize, 1, MAX_CROWD_SIZE);
+		ImGui::Checkbox("GPU culled props", &gpuCulling);
+		if (gpuCulling)
+			ImGui::SliderInt("GPU culled objects", &gpuCulledObjects, 1024, GpuCulling::MAX_OBJECTS);
+		ImGui::Checkbox("Renderer debug windows (wait for the render thread)", &rendererWindows);
+		ImGui::End();
+
+		renderThread.DrawImGui("Render thread");
+		lightingFeatures.m_spotLight = flashLightOn;
+		if (rendererWindows)
+			renderThread.Call(drawRendererWindows);
+
+		// Light sweep, every count is held long enough for the GPU timers to settle
+		if (lightSweepExponent >= 0)
+		{
+			clusteredLightExponent = lightSweepExponent;
+			if (lightSweepFrame >= LIGHT_SWEEP_FRAMES / 2)
+				lightSweepBinMs += stats.m_lightBinMs;
+
+			if (++lightSweepFrame == LIGHT_SWEEP_FRAMES)
+			{
+				float gpuMs = deferredShading ? stats.m_geometryGpuMs + stats.m_deferredLightingGpuMs : stats.m_forwardGpuMs;
+
+				std::stringstream sweep;
+				sweep << "Clustered lights (" << (deferredShading ? "deferred" : "forward") << "): " << stats.m_lightCount << " lights, CPU binning "
+					<< lightSweepBinMs / (LIGHT_SWEEP_FRAMES / 2) << " ms, GPU lit meshes " << gpuMs << " ms, max " << stats.m_maxLightsPerCluster << " lights per cluster";
+				Logger::Log(sweep.str());
+
+				lightSweepFrame = 0;
+				lightSweepBinMs = 0.0f;
+				lightSweepExponent = lightSweepExponent < MAX_CLUSTERED_LIGHT_EXPONENT ? lightSweepExponent + 1 : -1;
+			}
+		}
+		if (lightSweepExponent >= 0)
+			lightingFeatures.m_clustered = true;
+
+		if ((1 << clusteredLightExponent) != clusteredLightCount)
+		{
+			clusteredLightCount = 1 << clusteredLightExponent;
+			std::vector<PointLight> lights = CreatePointLights(clusteredLightCount, pointLightPositions, 4);
+			renderThread.Enqueue([&lightClusters, lights]() { lightClusters.SetLights(lights); });
+		}
+
+		if (reloadShaders)
+		{
+			reloadShaders = false;
+			renderThread.Enqueue(reloadChangedShaders);
+		}
+
+		// ==============================================================
+		// Simulation, everything the render thread needs goes into the packet
+		// ==============================================================
+		FramePacket& packet = renderThread.BeginPacket();
+		packet.m_width = screenWidth;
+		packet.m_height = screenHeight;
+		packet.m_fieldOfView = glm::radians(camera.GetZoom());
+		packet.m_projection = glm::perspective(packet.m_fieldOfView, (float)screenWidth / (float)screenHeight, 0.1f, 1000.0f);
+		packet.m_view = camera.GetViewMatrix();
+		packet.m_cameraPosition = camera.GetPosition();
+		packet.m_cameraDirection = camera.GetDirection();
+
+		packet.m_lighting = lightingFeatures;
+		packet.m_deferredShading = deferredShading;
+		packet.m_dirShadows = lightingFeatures.m_dirLight && lightingFeatures.m_dirShadows;
+		packet.m_localShadows = lightingFeatures.m_localShadows && LightingFeatures::FromKey(lightingFeatures.GetKey()).m_localShadows;
+
+		// The red box is the only caster that moves, its old and new bounds dirty the tiles it passes through
+		packet.m_movedCasters.clear();
+		if (animateRedBox)
+		{
+			glm::vec3 previous = boxPositions[0];
+			boxPositions[0] = redBoxHome + glm::vec3(std::sin(currentFrame), 0.0f, std::cos(currentFrame) - 1.0f);
+			packet.m_movedCasters.push_back(glm::vec4(previous, boxRadius));
+			packet.m_movedCasters.push_back(glm::vec4(boxPositions[0], boxRadius));
+			objectTransforms.SetModel(boxObjects[0], glm::translate(glm::mat4(1.0f), boxPositions[0]));
+		}
+		glm::mat4 viewProjection = packet.m_projection * packet.m_view;
+		objectTransforms.Update(viewProjection);
+		packet.m_objects.assign(&objectTransforms.Get(0), &objectTransforms.Get(0) + objectTransforms.GetCount());
+
+		glm::vec4 frustumPlanes[6];
+		GetFrustumPlanes(viewProjection, frustumPlanes);
+		packet.m_visibleObjects.clear();
+		for (int object = 0; object < int(objectTransforms.GetCount()); object++)
+		{
+			const glm::mat4& model = objectTransforms.GetModel(object);
+			glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(objectBounds[object]), 1.0f));
+			float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+			if (IsSphereInFrustum(frustumPlanes, center, objectBounds[object].w * scale))
+				packet.m_visibleObjects.push_back(object);
+		}
+
+		packet.m_props.clear();
+		if (instancedProps)
+		{
+			for (int i = 0; i < propCount; i++)
+			{
+				float angle = i * 2.39996f + currentFrame * 0.2f;	// golden angle spiral
+				float radius = 4.0f + 0.15f * std::sqrt(float(i));
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(radius * std::cos(angle), -2.5f, radius * std::sin(angle) - 3.0f));
+				model = glm::scale(glm::rotate(model, angle * 3.0f, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.15f));
+				float hue = float(i) / propCount * 6.2832f;
+				glm::vec4 color(0.5f + 0.5f * std::cos(hue), 0.5f + 0.5f * std::cos(hue - 2.0944f), 0.5f + 0.5f * std::cos(hue + 2.0944f), 1.0f);
+				packet.m_props.push_back({ model, glm::mat3x4(1.0f), color });
+			}
+			InstanceBuffer::ComputeNormalMatrices(packet.m_props.data(), int(packet.m_props.size()));
+		}
+
+		packet.m_crowd.clear();
+		if (instancedCrowd)
+		{
+			for (int row = 0; row < crowdSize; row++)
+			{
+				for (int column = 0; column < crowdSize; column++)
+				{
+					glm::vec3 offset((column - (crowdSize - 1) * 0.5f) * 2.0f, 0.0f, -3.0f - row * 2.5f);
+					packet.m_crowd.push_back({ glm::translate(glm::mat4(1.0f), offset) * nanosuitModel, glm::mat3x4(1.0f), glm::vec4(1.0f) });
+				}
+			}
+			InstanceBuffer::ComputeNormalMatrices(packet.m_crowd.data(), int(packet.m_crowd.size()));
+		}
+
+		packet.m_gpuCulledObjects = gpuCulling ? gpuCulledObjects : 0;
+		packet.m_uniformBenchmark = uniformBenchmark;
+		packet.m_transformBenchmark = transformBenchmark;
+
+		// The draw lists belong to the ImGui context, the render thread gets a copy
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		packet.m_ui.CopyFrom(ImGui::GetDrawData());
+		renderThread.SubmitPacket();
 
-		// Swap buffers and poll IO events
-		glfwSwapBuffers(window);
+		// Poll IO events, the render thread swaps the buffers
 		glfwPollEvents();
 	}
 
+	// Draws what is still queued and hands the context back for the cleanup
+	renderThread.Stop();
+
 	// Cleanup ImGui
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
@@ -291,16 +1032,17 @@ int main()
 	// Cleanup OpenGL buffers
 	glDeleteVertexArrays(1, &boxVAO);
 	glDeleteBuffers(1, &boxVBO);
+	GpuMemoryTracker::UntrackBuffer(boxVBO);
+	SamplerCache::Shutdown();
 
-	glfwTerminate();
 	return 0;
 }
 
+// The render thread sets the viewport from each frame's packet
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	screenWidth = width;
 	screenHeight = height;
-	glViewport(0, 0, width, height);
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -346,6 +1088,14 @@ void processInput(GLFWwindow* window)
 	if (glfwGetKey(window, GLFW_KEY_GRAVE_ACCENT) == GLFW_PRESS)
 		gameModeKeyDown = true;
 
+	if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS && !reloadShadersKeyDown)
+	{
+		reloadShadersKeyDown = true;
+		reloadShaders = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_RELEASE)
+		reloadShadersKeyDown = false;
+
 	if (glfwGetKey(window, GLFW_KEY_GRAVE_ACCENT) == GLFW_RELEASE && gameModeKeyDown)
 	{
 		gameModeKeyDown = false;
@@ -394,6 +1144,54 @@ void processInput(GLFWwindow* window)
 	}
 }
 
+std::vector<PointLight> CreatePointLights(int count, const glm::vec3* fixedPositions, int fixedCount)
+{
+	std::vector<PointLight> lights;
+	for (int i = 0; i < std::min(count, fixedCount); i++)
+	{
+		lights.push_back({ fixedPositions[i], glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f });
+	}
+
+	// Small coloured lights without ambient, so thousands of them do not wash the scene out.
+	// Always the same seed so every run (and every sweep) sees the same scene.
+	std::mt19937 random(1337);
+	std::uniform_real_distribution<float> x(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> y(-4.0f, 4.0f);
+	std::uniform_real_distribution<float> z(-15.0f, 5.0f);
+	std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+	for (int i = fixedCount; i < count; i++)
+	{
+		glm::vec3 color(channel(random), channel(random), channel(random));
+		lights.push_back({ glm::vec3(x(random), y(random), z(random)), glm::vec3(0.0f), color, color, 1.0f, 0.7f, 1.8f });
+	}
+	return lights;
+}
+
+// Gribb-Hartmann: the planes are sums and differences of the rows of the view projection, with
+// their normals pointing into the frustum
+void GetFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::mat4 rows = glm::transpose(viewProjection);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (int i = 0; i < 6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+bool IsSphereInFrustum(const glm::vec4 planes[6], const glm::vec3& center, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
 void CenterWindow(GLFWwindow* window, GLFWmonitor* monitor)
 {
 	if (!monitor)
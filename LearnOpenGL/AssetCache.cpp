@@ -0,0 +1,59 @@
+#include "AssetCache.h"
+
+#include "helpers/Logger.h"
+
+std::unordered_map<uint64_t, unsigned int> AssetCache::m_Textures;
+std::unordered_map<uint64_t, AssetCache::MeshBuffers> AssetCache::m_Meshes;
+
+size_t AssetCache::m_TextureBytes = 0;
+size_t AssetCache::m_MeshBytes = 0;
+unsigned int AssetCache::m_TextureHits = 0;
+unsigned int AssetCache::m_MeshHits = 0;
+size_t AssetCache::m_TextureBytesSaved = 0;
+size_t AssetCache::m_MeshBytesSaved = 0;
+
+bool AssetCache::FindTexture(uint64_t hash, size_t bytes, unsigned int& textureId)
+{
+	auto it = m_Textures.find(hash);
+	if (it == m_Textures.end())
+		return false;
+
+	textureId = it->second;
+	m_TextureHits++;
+	m_TextureBytesSaved += bytes;
+	return true;
+}
+
+void AssetCache::AddTexture(uint64_t hash, unsigned int textureId, size_t bytes)
+{
+	m_Textures[hash] = textureId;
+	m_TextureBytes += bytes;
+}
+
+bool AssetCache::FindMesh(uint64_t hash, size_t bytes, MeshBuffers& buffers)
+{
+	auto it = m_Meshes.find(hash);
+	if (it == m_Meshes.end())
+		return false;
+
+	buffers = it->second;
+	m_MeshHits++;
+	m_MeshBytesSaved += bytes;
+	return true;
+}
+
+void AssetCache::AddMesh(uint64_t hash, const MeshBuffers& buffers, size_t bytes)
+{
+	m_Meshes[hash] = buffers;
+	m_MeshBytes += bytes;
+}
+
+void AssetCache::LogStats()
+{
+	std::stringstream ss;
+	ss << "AssetCache: " << m_Textures.size() << " unique textures (" << m_TextureBytes / 1024 << " KB, "
+		<< m_TextureHits << " duplicates, " << m_TextureBytesSaved / 1024 << " KB saved), "
+		<< m_Meshes.size() << " unique meshes (" << m_MeshBytes / 1024 << " KB, "
+		<< m_MeshHits << " duplicates, " << m_MeshBytesSaved / 1024 << " KB saved)";
+	Logger::Log(ss.str());
+}
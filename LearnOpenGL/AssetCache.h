@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// Shares one GL object per unique piece of content. Textures and meshes are keyed by
+// a hash of their decoded pixels / vertex+index data, so identical assets exported
+// under different names (or mirrored meshes coming out of Assimp) are only uploaded once.
+class AssetCache
+{
+public:
+	struct MeshBuffers
+	{
+		unsigned int m_VAO;
+		unsigned int m_VBO;
+		unsigned int m_EBO;
+	};
+
+public:
+	// Returns true and fills in the existing object when the content was seen before.
+	static bool FindTexture(uint64_t hash, size_t bytes, unsigned int& textureId);
+	static void AddTexture(uint64_t hash, unsigned int textureId, size_t bytes);
+
+	static bool FindMesh(uint64_t hash, size_t bytes, MeshBuffers& buffers);
+	static void AddMesh(uint64_t hash, const MeshBuffers& buffers, size_t bytes);
+
+	static size_t GetBytesSaved() { return m_TextureBytesSaved + m_MeshBytesSaved; }
+	static void LogStats();
+
+private:
+	static std::unordered_map<uint64_t, unsigned int> m_Textures;
+	static std::unordered_map<uint64_t, MeshBuffers> m_Meshes;
+
+	static size_t m_TextureBytes;
+	static size_t m_MeshBytes;
+	static unsigned int m_TextureHits;
+	static unsigned int m_MeshHits;
+	static size_t m_TextureBytesSaved;
+	static size_t m_MeshBytesSaved;
+};
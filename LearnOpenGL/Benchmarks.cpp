@@ -0,0 +1,40 @@
+#include "Benchmarks.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+
+#include "Shader.h"
+
+Benchmarks::UniformResult Benchmarks::UniformSetters(const Shader& shader, UniformName name, float value, int count)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	auto start = Clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		glUniform1f(glGetUniformLocation(shader.GetId(), name.m_name), value);
+	}
+	auto uncached = Clock::now() - start;
+
+	start = Clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		shader.SetFloat(name, value);
+	}
+	auto cached = Clock::now() - start;
+
+	Uniform<float> handle = shader.GetUniform<float>(name);
+	start = Clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		handle.Set(value);
+	}
+	auto resolved = Clock::now() - start;
+
+	UniformResult result;
+	result.m_uncachedNs = std::chrono::duration<float, std::nano>(uncached).count() / count;
+	result.m_cachedNs = std::chrono::duration<float, std::nano>(cached).count() / count;
+	result.m_handleNs = std::chrono::duration<float, std::nano>(resolved).count() / count;
+	return result;
+}
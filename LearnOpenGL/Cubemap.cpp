@@ -0,0 +1,260 @@
+#include "Cubemap.h"
+
+#include "stb_image.h"
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "helpers/Hash.h"
+#include "helpers/Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+
+namespace
+{
+	const uint32_t COOKED_MAGIC = 0x45425543; // "CUBE"
+	const uint32_t COOKED_VERSION = 1;
+	const int CHANNELS = 3;
+
+	struct CookedHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_version;
+		uint64_t m_sourceHash;
+		uint32_t m_size;
+		uint32_t m_levels;
+	};
+
+	size_t LevelFaceBytes(int size, int level)
+	{
+		int levelSize = std::max(size >> level, 1);
+		return size_t(levelSize) * levelSize * CHANNELS;
+	}
+
+	size_t TotalBytes(int size, int levels)
+	{
+		size_t total = 0;
+		for (int level = 0; level < levels; level++)
+			total += LevelFaceBytes(size, level) * 6;
+		return total;
+	}
+
+	// 2x2 box filter down to the next mip level
+	void Downsample(const unsigned char* src, int srcSize, unsigned char* dst)
+	{
+		int dstSize = std::max(srcSize / 2, 1);
+		for (int y = 0; y < dstSize; y++)
+		{
+			int y0 = std::min(y * 2, srcSize - 1);
+			int y1 = std::min(y * 2 + 1, srcSize - 1);
+			for (int x = 0; x < dstSize; x++)
+			{
+				int x0 = std::min(x * 2, srcSize - 1);
+				int x1 = std::min(x * 2 + 1, srcSize - 1);
+				for (int c = 0; c < CHANNELS; c++)
+				{
+					int sum = src[(y0 * srcSize + x0) * CHANNELS + c] + src[(y0 * srcSize + x1) * CHANNELS + c]
+						+ src[(y1 * srcSize + x0) * CHANNELS + c] + src[(y1 * srcSize + x1) * CHANNELS + c];
+					dst[(y * dstSize + x) * CHANNELS + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// Cheap staleness key: face paths plus their size and modification time
+	uint64_t HashSources(const std::vector<std::string>& faces)
+	{
+		uint64_t hash = 0;
+		for (const std::string& face : faces)
+		{
+			std::error_code error;
+			uint64_t fileSize = std::filesystem::file_size(face, error);
+			auto writeTime = std::filesystem::last_write_time(face, error).time_since_epoch().count();
+
+			hash = HashBytes(face.data(), face.size(), hash);
+			hash = HashBytes(&fileSize, sizeof(fileSize), hash);
+			hash = HashBytes(&writeTime, sizeof(writeTime), hash);
+		}
+		return hash;
+	}
+
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+Cubemap::Cubemap(const std::vector<std::string>& faces, const std::string& cookedPath)
+	: m_Id(0)
+	, m_Size(0)
+	, m_Levels(0)
+	, m_SourceHash(HashSources(faces))
+{
+	m_Sampler.m_wrap = SamplerWrap::ClampToEdge;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::stringstream ss;
+	if (LoadCooked(cookedPath, m_SourceHash))
+	{
+		ss << "Cubemap: warm load from " << cookedPath << " took " << MillisecondsSince(start) << " ms";
+		Logger::LogSuccess(ss.str());
+	}
+	else if (LoadFaces(faces, cookedPath, m_SourceHash))
+	{
+		ss << "Cubemap: cold load (decode + mips + cook) took " << MillisecondsSince(start) << " ms";
+		Logger::LogSuccess(ss.str());
+	}
+}
+
+void Cubemap::Use(GLenum texture)
+{
+	GLState::BindTexture(texture - GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, m_Id);
+	SamplerCache::Bind(texture - GL_TEXTURE0, m_Sampler);
+}
+
+bool Cubemap::LoadCooked(const std::string& cookedPath, uint64_t sourceHash)
+{
+	std::ifstream file(cookedPath, std::ios::binary);
+	if (!file)
+		return false;
+
+	CookedHeader header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.m_magic != COOKED_MAGIC || header.m_version != COOKED_VERSION || header.m_sourceHash != sourceHash)
+	{
+		Logger::LogWarning("Cubemap: cooked file is stale, rebuilding " + cookedPath);
+		return false;
+	}
+
+	m_Size = int(header.m_size);
+	m_Levels = int(header.m_levels);
+
+	std::vector<unsigned char> pixels(TotalBytes(m_Size, m_Levels));
+	file.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+	if (!file)
+	{
+		Logger::LogWarning("Cubemap: cooked file is truncated, rebuilding " + cookedPath);
+		return false;
+	}
+
+	Upload(pixels, cookedPath);
+	return true;
+}
+
+bool Cubemap::LoadFaces(const std::vector<std::string>& faces, const std::string& cookedPath, uint64_t sourceHash)
+{
+	if (faces.size() != 6)
+	{
+		Logger::LogError("Cubemap: expected 6 faces");
+		return false;
+	}
+
+	// Cubemap faces are sampled with a left-handed convention, never flip them
+	stbi_set_flip_vertically_on_load(false);
+
+	struct Face
+	{
+		int m_size = 0;
+		std::vector<std::vector<unsigned char>> m_levels;
+	};
+
+	// Decode every face and build its mip chain on a separate thread
+	std::vector<std::future<Face>> tasks;
+	for (const std::string& path : faces)
+	{
+		tasks.push_back(std::async(std::launch::async, [path]()
+		{
+			Face face;
+			int width, height, nrChannels;
+			unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, CHANNELS);
+			if (!data)
+				return face;
+
+			if (width != height)
+			{
+				stbi_image_free(data);
+				return face;
+			}
+
+			face.m_size = width;
+			face.m_levels.emplace_back(data, data + size_t(width) * height * CHANNELS);
+			stbi_image_free(data);
+
+			for (int size = width; size > 1; size /= 2)
+			{
+				std::vector<unsigned char> level(LevelFaceBytes(size / 2, 0));
+				Downsample(face.m_levels.back().data(), size, level.data());
+				face.m_levels.push_back(std::move(level));
+			}
+			return face;
+		}));
+	}
+
+	std::vector<Face> decoded;
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		decoded.push_back(tasks[i].get());
+		if (decoded.back().m_size == 0 || decoded.back().m_size != decoded.front().m_size)
+		{
+			Logger::LogError("Cubemap: failed to load face " + faces[i]);
+			return false;
+		}
+	}
+
+	m_Size = decoded.front().m_size;
+	m_Levels = int(decoded.front().m_levels.size());
+
+	// Interleave into level-major, face-minor order so every level is one contiguous 6-layer upload
+	std::vector<unsigned char> pixels;
+	pixels.reserve(TotalBytes(m_Size, m_Levels));
+	for (int level = 0; level < m_Levels; level++)
+	{
+		for (const Face& face : decoded)
+		{
+			pixels.insert(pixels.end(), face.m_levels[level].begin(), face.m_levels[level].end());
+		}
+	}
+
+	Upload(pixels, cookedPath);
+
+	// Cook the result for the next run
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cookedPath).parent_path(), error);
+
+	std::ofstream file(cookedPath, std::ios::binary);
+	if (file)
+	{
+		CookedHeader header{ COOKED_MAGIC, COOKED_VERSION, sourceHash, uint32_t(m_Size), uint32_t(m_Levels) };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+	}
+	else
+	{
+		Logger::LogWarning("Cubemap: could not write cooked file " + cookedPath);
+	}
+
+	return true;
+}
+
+void Cubemap::Upload(const std::vector<unsigned char>& pixels, const std::string& owner)
+{
+	glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &m_Id);
+	glTextureStorage2D(m_Id, m_Levels, GL_RGB8, m_Size, m_Size);
+	GpuMemoryTracker::TrackTexture(m_Id, pixels.size(), GpuMemoryCategory::Cubemap, owner, "GL_RGB8");
+
+	// Tightly packed RGB rows are not 4-byte aligned on the small mip levels
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	size_t offset = 0;
+	for (int level = 0; level < m_Levels; level++)
+	{
+		int levelSize = std::max(m_Size >> level, 1);
+		glTextureSubImage3D(m_Id, level, 0, 0, 0, levelSize, levelSize, 6, GL_RGB, GL_UNSIGNED_BYTE, pixels.data() + offset);
+		offset += LevelFaceBytes(m_Size, level) * 6;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SamplerCache.h"
+
+// Cubemap texture built from six face images (+X, -X, +Y, -Y, +Z, -Z).
+// On a cold load the faces are decoded and mipmapped in parallel, then written to a single
+// cooked file holding every face and mip level. Warm loads read that file in one go and upload
+// each mip level of all six faces with a single glTextureSubImage3D call.
+class Cubemap
+{
+public:
+	Cubemap(const std::vector<std::string>& faces, const std::string& cookedPath);
+
+	unsigned int GetId() const { return m_Id; }
+	int GetSize() const { return m_Size; }
+	int GetLevels() const { return m_Levels; }
+	// Changes whenever one of the face images does, for keying data derived from the cubemap
+	uint64_t GetSourceHash() const { return m_SourceHash; }
+
+	void Use(GLenum texture);
+
+private:
+	bool LoadCooked(const std::string& cookedPath, uint64_t sourceHash);
+	bool LoadFaces(const std::vector<std::string>& faces, const std::string& cookedPath, uint64_t sourceHash);
+	void Upload(const std::vector<unsigned char>& pixels, const std::string& owner);
+
+private:
+	unsigned int m_Id;
+	int m_Size;
+	int m_Levels;
+	uint64_t m_SourceHash;
+	SamplerDesc m_Sampler;
+};
@@ -0,0 +1,44 @@
+#include "FramePacket.h"
+
+#include <cstring>
+
+namespace
+{
+	// ImVector's assignment frees its storage first, this keeps it
+	template<typename T>
+	void CopyBuffer(const ImVector<T>& source, ImVector<T>& destination)
+	{
+		destination.resize(source.Size);
+		if (source.Size > 0)
+			std::memcpy(destination.Data, source.Data, source.size_in_bytes());
+	}
+}
+
+ImGuiDrawDataCopy::~ImGuiDrawDataCopy()
+{
+	for (ImDrawList* list : m_Lists)
+		IM_DELETE(list);
+}
+
+void ImGuiDrawDataCopy::CopyFrom(const ImDrawData* drawData)
+{
+	if (!drawData || !drawData->Valid)
+	{
+		m_DrawData.Clear();
+		return;
+	}
+
+	// Only the buffers are read when drawing, the lists do not need ImGui's shared data
+	while (m_Lists.size() < size_t(drawData->CmdListsCount))
+		m_Lists.push_back(IM_NEW(ImDrawList)(nullptr));
+	for (int i = 0; i < drawData->CmdListsCount; i++)
+	{
+		const ImDrawList* source = drawData->CmdLists[i];
+		CopyBuffer(source->CmdBuffer, m_Lists[i]->CmdBuffer);
+		CopyBuffer(source->IdxBuffer, m_Lists[i]->IdxBuffer);
+		CopyBuffer(source->VtxBuffer, m_Lists[i]->VtxBuffer);
+	}
+
+	m_DrawData = *drawData;
+	m_DrawData.CmdLists = m_Lists.data();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "deps/imgui/imgui.h"
+
+#include "InstanceBuffer.h"
+#include "LightingFeatures.h"
+#include "TransformBatch.h"
+
+// ImGui's draw data for one frame, copied out of the ImGui context so the render thread can draw
+// it while the main thread already builds the next frame's UI. The lists are kept between frames,
+// so copying does not allocate once they are as big as the biggest frame so far.
+class ImGuiDrawDataCopy
+{
+public:
+	ImGuiDrawDataCopy() = default;
+	~ImGuiDrawDataCopy();
+
+	ImGuiDrawDataCopy(const ImGuiDrawDataCopy&) = delete;
+	ImGuiDrawDataCopy& operator=(const ImGuiDrawDataCopy&) = delete;
+
+	// Call after ImGui::Render()
+	void CopyFrom(const ImDrawData* drawData);
+	// Null before the first copy. The ImGui renderers take a non-const pointer but only read it.
+	ImDrawData* Get() const { return m_DrawData.Valid ? &m_DrawData : nullptr; }
+
+private:
+	mutable ImDrawData m_DrawData;
+	std::vector<ImDrawList*> m_Lists;
+};
+
+// Everything the render thread needs to draw one frame, written by the main thread and then only
+// read until the frame is drawn. The vectors keep their capacity from frame to frame.
+struct FramePacket
+{
+	int m_width;
+	int m_height;
+
+	glm::mat4 m_projection;
+	glm::mat4 m_view;
+	glm::vec3 m_cameraPosition;
+	glm::vec3 m_cameraDirection;
+	float m_fieldOfView;	// vertical, in radians
+
+	LightingFeatures m_lighting;
+	bool m_deferredShading;
+	bool m_dirShadows;
+	bool m_localShadows;
+
+	// Every object in the scene, since shadows are also cast from outside the view
+	std::vector<ObjectTransform> m_objects;
+	// Indices into m_objects of the ones inside the view frustum
+	std::vector<int> m_visibleObjects;
+	// Bounding spheres (center, radius) that a moving shadow caster left or entered
+	std::vector<glm::vec4> m_movedCasters;
+
+	// Empty when the instanced props or crowd are off
+	std::vector<InstanceData> m_props;
+	std::vector<InstanceData> m_crowd;
+	int m_gpuCulledObjects;	// 0 when GPU culling is off
+
+	bool m_uniformBenchmark;
+	bool m_transformBenchmark;
+
+	ImGuiDrawDataCopy m_ui;
+};
@@ -0,0 +1,156 @@
+#include "GBuffer.h"
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "Shader.h"
+#include "helpers/Logger.h"
+
+GBuffer::GBuffer()
+	: m_Framebuffer(0)
+	, m_AlbedoSpecular(0)
+	, m_Normal(0)
+	, m_Depth(0)
+	, m_Width(0)
+	, m_Height(0)
+	, m_QuadVAO(0)
+	, m_QuadVBO(0)
+{
+	float quadVertices[] = {
+		// positions   // texCoords
+		-1.0f,  1.0f,  0.0f, 1.0f,
+		-1.0f, -1.0f,  0.0f, 0.0f,
+		 1.0f, -1.0f,  1.0f, 0.0f,
+
+		-1.0f,  1.0f,  0.0f, 1.0f,
+		 1.0f, -1.0f,  1.0f, 0.0f,
+		 1.0f,  1.0f,  1.0f, 1.0f
+	};
+
+	// Laid out for framebuffer_vertex.glsl
+	glCreateBuffers(1, &m_QuadVBO);
+	glNamedBufferData(m_QuadVBO, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+	GpuMemoryTracker::TrackBuffer(m_QuadVBO, sizeof(quadVertices), GpuMemoryCategory::VertexBuffer, "GBuffer quad", "vec2 + vec2");
+
+	glCreateVertexArrays(1, &m_QuadVAO);
+	glVertexArrayVertexBuffer(m_QuadVAO, 0, m_QuadVBO, 0, 4 * sizeof(float));
+	glEnableVertexArrayAttrib(m_QuadVAO, 0);
+	glVertexArrayAttribFormat(m_QuadVAO, 0, 2, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(m_QuadVAO, 0, 0);
+	glEnableVertexArrayAttrib(m_QuadVAO, 1);
+	glVertexArrayAttribFormat(m_QuadVAO, 1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float));
+	glVertexArrayAttribBinding(m_QuadVAO, 1, 0);
+}
+
+GBuffer::~GBuffer()
+{
+	DestroyTargets();
+
+	GpuMemoryTracker::UntrackBuffer(m_QuadVBO);
+	glDeleteBuffers(1, &m_QuadVBO);
+	glDeleteVertexArrays(1, &m_QuadVAO);
+}
+
+void GBuffer::Resize(int width, int height)
+{
+	if (width == m_Width && height == m_Height)
+		return;
+
+	m_Width = width;
+	m_Height = height;
+
+	DestroyTargets();
+	if (m_Width > 0 && m_Height > 0)
+		CreateTargets();
+}
+
+void GBuffer::BeginGeometryPass()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+
+	// Every target is written where there is geometry, so only depth really needs clearing;
+	// the rest is cleared too so leftovers never show up in a debugger
+	const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float farDepth = 1.0f;
+	GLState::SetDepthMask(true);
+	glClearNamedFramebufferfv(m_Framebuffer, GL_COLOR, 0, zero);
+	glClearNamedFramebufferfv(m_Framebuffer, GL_COLOR, 1, zero);
+	glClearNamedFramebufferfv(m_Framebuffer, GL_DEPTH, 0, &farDepth);
+}
+
+void GBuffer::EndGeometryPass()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::BindTextures(const Shader& shader, unsigned int firstUnit)
+{
+	const unsigned int textures[] = { m_AlbedoSpecular, m_Normal, m_Depth };
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		// Read with texelFetch, so no sampler state is needed
+		GLState::BindTexture(firstUnit + i, GL_TEXTURE_2D, textures[i]);
+		GLState::BindSampler(firstUnit + i, 0);
+	}
+
+	shader.SetInt("gAlbedoSpecular", firstUnit);
+	shader.SetInt("gNormal", firstUnit + 1);
+	shader.SetInt("gDepth", firstUnit + 2);
+}
+
+void GBuffer::DrawLightingPass()
+{
+	GLState::SetDepthFunc(GL_ALWAYS);
+	GLState::BindVertexArray(m_QuadVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	GLState::SetDepthFunc(GL_LESS);
+}
+
+void GBuffer::CreateTargets()
+{
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_AlbedoSpecular);
+	glTextureStorage2D(m_AlbedoSpecular, 1, GL_RGBA8, m_Width, m_Height);
+	GpuMemoryTracker::TrackTexture(m_AlbedoSpecular, GpuMemoryTracker::TextureBytes(m_Width, m_Height, 1, 4, 1), GpuMemoryCategory::Attachment, "GBuffer albedo + specular", "GL_RGBA8");
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_Normal);
+	glTextureStorage2D(m_Normal, 1, GL_RG16, m_Width, m_Height);
+	GpuMemoryTracker::TrackTexture(m_Normal, GpuMemoryTracker::TextureBytes(m_Width, m_Height, 1, 4, 1), GpuMemoryCategory::Attachment, "GBuffer normal", "GL_RG16");
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_Depth);
+	glTextureStorage2D(m_Depth, 1, GL_DEPTH_COMPONENT32F, m_Width, m_Height);
+	GpuMemoryTracker::TrackTexture(m_Depth, GpuMemoryTracker::TextureBytes(m_Width, m_Height, 1, 4, 1), GpuMemoryCategory::Attachment, "GBuffer depth", "GL_DEPTH_COMPONENT32F");
+
+	glCreateFramebuffers(1, &m_Framebuffer);
+	glNamedFramebufferTexture(m_Framebuffer, GL_COLOR_ATTACHMENT0, m_AlbedoSpecular, 0);
+	glNamedFramebufferTexture(m_Framebuffer, GL_COLOR_ATTACHMENT1, m_Normal, 0);
+	glNamedFramebufferTexture(m_Framebuffer, GL_DEPTH_ATTACHMENT, m_Depth, 0);
+
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(m_Framebuffer, 2, drawBuffers);
+
+	if (glCheckNamedFramebufferStatus(m_Framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		Logger::LogError("GBuffer: framebuffer is not complete");
+}
+
+void GBuffer::DestroyTargets()
+{
+	if (m_Framebuffer == 0)
+		return;
+
+	glDeleteFramebuffers(1, &m_Framebuffer);
+	const unsigned int textures[] = { m_AlbedoSpecular, m_Normal, m_Depth };
+	for (unsigned int texture : textures)
+	{
+		GpuMemoryTracker::UntrackTexture(texture);
+	}
+	glDeleteTextures(3, textures);
+
+	// Deleting unbinds them from every unit, and new textures may get the same names back
+	GLState::Invalidate();
+
+	m_Framebuffer = 0;
+	m_AlbedoSpecular = 0;
+	m_Normal = 0;
+	m_Depth = 0;
+}
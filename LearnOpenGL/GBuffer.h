@@ -0,0 +1,52 @@
+#pragma once
+
+class Shader;
+
+// Render targets of the deferred path (layout in res/shaders/include/gbuffer.glsl):
+// RGBA8 albedo + specular mask, RG16 octahedral normal and a 32F depth texture from which
+// the lighting pass reconstructs world positions. 12 bytes per pixel in total.
+//
+// The geometry pass fills it with gbuffer_fragment.glsl, then deferred_fragment.glsl shades
+// every covered pixel exactly once in a fullscreen pass, using the clustered light lists when
+// they are enabled, so lighting cost follows lit pixels instead of overdraw times lights.
+class GBuffer
+{
+public:
+	GBuffer();
+	~GBuffer();
+
+	GBuffer(const GBuffer&) = delete;
+	GBuffer& operator=(const GBuffer&) = delete;
+
+	// Reallocates the targets when the size changed
+	void Resize(int width, int height);
+
+	// Binds and clears the G-buffer for the geometry pass
+	void BeginGeometryPass();
+	// Back to the default framebuffer
+	void EndGeometryPass();
+
+	// Binds the targets to texture units firstUnit.. and points the lighting shader's samplers at them
+	void BindTextures(const Shader& shader, unsigned int firstUnit);
+	// Fullscreen quad for the lighting pass. Writes the G-buffer depth, so forward passes drawn
+	// afterwards (transparent or unlit objects, the skybox) are still depth tested against it.
+	void DrawLightingPass();
+
+	int GetWidth() const { return m_Width; }
+	int GetHeight() const { return m_Height; }
+
+private:
+	void CreateTargets();
+	void DestroyTargets();
+
+private:
+	unsigned int m_Framebuffer;
+	unsigned int m_AlbedoSpecular;
+	unsigned int m_Normal;
+	unsigned int m_Depth;
+	int m_Width;
+	int m_Height;
+
+	unsigned int m_QuadVAO;
+	unsigned int m_QuadVBO;
+};
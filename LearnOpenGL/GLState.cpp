@@ -0,0 +1,274 @@
+#include "GLState.h"
+
+#include "deps/imgui/imgui.h"
+
+namespace
+{
+	const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	const char* CALL_NAMES[] = { "Program", "Vertex array", "Texture", "Sampler", "Buffer", "Depth", "Blend" };
+	static_assert(sizeof(CALL_NAMES) / sizeof(CALL_NAMES[0]) == size_t(GLStateCall::Count), "name every GLStateCall");
+}
+
+GLuint GLState::m_Program = UNKNOWN;
+GLuint GLState::m_VertexArray = UNKNOWN;
+unsigned int GLState::m_ActiveUnit = UNKNOWN;
+GLuint GLState::m_Textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+GLuint GLState::m_Samplers[MAX_TEXTURE_UNITS];
+GLuint GLState::m_Buffers[BUFFER_TARGET_COUNT];
+GLState::IndexedBinding GLState::m_UniformBindings[MAX_BUFFER_BINDINGS];
+GLState::IndexedBinding GLState::m_StorageBindings[MAX_BUFFER_BINDINGS];
+
+int GLState::m_DepthTest = -1;
+int GLState::m_DepthMask = -1;
+int GLState::m_Blend = -1;
+GLenum GLState::m_DepthFunc = UNKNOWN;
+GLenum GLState::m_BlendSource = UNKNOWN;
+GLenum GLState::m_BlendDestination = UNKNOWN;
+
+size_t GLState::m_Issued[size_t(GLStateCall::Count)] = {};
+size_t GLState::m_Filtered[size_t(GLStateCall::Count)] = {};
+size_t GLState::m_LastIssuedByCall[size_t(GLStateCall::Count)] = {};
+size_t GLState::m_LastFilteredByCall[size_t(GLStateCall::Count)] = {};
+size_t GLState::m_LastIssued = 0;
+size_t GLState::m_LastFiltered = 0;
+
+void GLState::UseProgram(GLuint program)
+{
+	if (Filter(GLStateCall::Program, m_Program == program))
+		return;
+
+	glUseProgram(program);
+	m_Program = program;
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	if (Filter(GLStateCall::VertexArray, m_VertexArray == vao))
+		return;
+
+	glBindVertexArray(vao);
+	m_VertexArray = vao;
+
+	// The element array binding is part of the VAO
+	m_Buffers[BufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+}
+
+void GLState::BindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+	int targetIndex = TextureTargetIndex(target);
+	if (unit >= MAX_TEXTURE_UNITS || targetIndex < 0)
+	{
+		Filter(GLStateCall::Texture, false);
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		m_ActiveUnit = unit;
+		return;
+	}
+
+	if (Filter(GLStateCall::Texture, m_Textures[unit][targetIndex] == texture))
+		return;
+
+	if (m_ActiveUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		m_ActiveUnit = unit;
+	}
+	glBindTexture(target, texture);
+	m_Textures[unit][targetIndex] = texture;
+}
+
+void GLState::BindSampler(unsigned int unit, GLuint sampler)
+{
+	if (Filter(GLStateCall::Sampler, unit < MAX_TEXTURE_UNITS && m_Samplers[unit] == sampler))
+		return;
+
+	glBindSampler(unit, sampler);
+	if (unit < MAX_TEXTURE_UNITS)
+		m_Samplers[unit] = sampler;
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	int targetIndex = BufferTargetIndex(target);
+	if (Filter(GLStateCall::Buffer, targetIndex >= 0 && m_Buffers[targetIndex] == buffer))
+		return;
+
+	glBindBuffer(target, buffer);
+	if (targetIndex >= 0)
+		m_Buffers[targetIndex] = buffer;
+}
+
+void GLState::BindBufferRange(GLenum target, unsigned int index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	IndexedBinding* bindings = target == GL_UNIFORM_BUFFER ? m_UniformBindings : target == GL_SHADER_STORAGE_BUFFER ? m_StorageBindings : nullptr;
+	IndexedBinding* binding = bindings && index < MAX_BUFFER_BINDINGS ? &bindings[index] : nullptr;
+
+	if (Filter(GLStateCall::Buffer, binding && binding->m_buffer == buffer && binding->m_offset == offset && binding->m_size == size))
+		return;
+
+	if (size == 0)
+		glBindBufferBase(target, index, buffer);
+	else
+		glBindBufferRange(target, index, buffer, offset, size);
+
+	if (binding)
+		*binding = { buffer, offset, size };
+
+	// Indexed binds also replace the generic binding point of the target
+	int targetIndex = BufferTargetIndex(target);
+	if (targetIndex >= 0)
+		m_Buffers[targetIndex] = buffer;
+}
+
+void GLState::SetDepthTest(bool enabled)
+{
+	if (Filter(GLStateCall::Depth, m_DepthTest == int(enabled)))
+		return;
+
+	if (enabled)
+		glEnable(GL_DEPTH_TEST);
+	else
+		glDisable(GL_DEPTH_TEST);
+	m_DepthTest = int(enabled);
+}
+
+void GLState::SetDepthFunc(GLenum func)
+{
+	if (Filter(GLStateCall::Depth, m_DepthFunc == func))
+		return;
+
+	glDepthFunc(func);
+	m_DepthFunc = func;
+}
+
+void GLState::SetDepthMask(bool enabled)
+{
+	if (Filter(GLStateCall::Depth, m_DepthMask == int(enabled)))
+		return;
+
+	glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	m_DepthMask = int(enabled);
+}
+
+void GLState::SetBlend(bool enabled)
+{
+	if (Filter(GLStateCall::Blend, m_Blend == int(enabled)))
+		return;
+
+	if (enabled)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+	m_Blend = int(enabled);
+}
+
+void GLState::SetBlendFunc(GLenum source, GLenum destination)
+{
+	if (Filter(GLStateCall::Blend, m_BlendSource == source && m_BlendDestination == destination))
+		return;
+
+	glBlendFunc(source, destination);
+	m_BlendSource = source;
+	m_BlendDestination = destination;
+}
+
+void GLState::Invalidate()
+{
+	m_Program = UNKNOWN;
+	m_VertexArray = UNKNOWN;
+	m_ActiveUnit = UNKNOWN;
+	for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			m_Textures[unit][target] = UNKNOWN;
+		m_Samplers[unit] = UNKNOWN;
+	}
+	for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+	{
+		m_Buffers[target] = UNKNOWN;
+	}
+	for (unsigned int index = 0; index < MAX_BUFFER_BINDINGS; index++)
+	{
+		m_UniformBindings[index] = { UNKNOWN, 0, 0 };
+		m_StorageBindings[index] = { UNKNOWN, 0, 0 };
+	}
+
+	m_DepthTest = -1;
+	m_DepthMask = -1;
+	m_Blend = -1;
+	m_DepthFunc = UNKNOWN;
+	m_BlendSource = UNKNOWN;
+	m_BlendDestination = UNKNOWN;
+}
+
+void GLState::BeginFrame()
+{
+	m_LastIssued = 0;
+	m_LastFiltered = 0;
+	for (size_t i = 0; i < size_t(GLStateCall::Count); i++)
+	{
+		m_LastIssuedByCall[i] = m_Issued[i];
+		m_LastFilteredByCall[i] = m_Filtered[i];
+		m_LastIssued += m_Issued[i];
+		m_LastFiltered += m_Filtered[i];
+		m_Issued[i] = 0;
+		m_Filtered[i] = 0;
+	}
+}
+
+void GLState::DrawImGui()
+{
+	ImGui::Begin("GL State");
+	ImGui::Text("Last frame: %zu issued, %zu filtered", m_LastIssued, m_LastFiltered);
+	ImGui::Separator();
+
+	ImGui::Columns(3, "glstate");
+	ImGui::Text("State"); ImGui::NextColumn();
+	ImGui::Text("Issued"); ImGui::NextColumn();
+	ImGui::Text("Filtered"); ImGui::NextColumn();
+	ImGui::Separator();
+	for (size_t i = 0; i < size_t(GLStateCall::Count); i++)
+	{
+		ImGui::TextUnformatted(CALL_NAMES[i]); ImGui::NextColumn();
+		ImGui::Text("%zu", m_LastIssuedByCall[i]); ImGui::NextColumn();
+		ImGui::Text("%zu", m_LastFilteredByCall[i]); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::End();
+}
+
+bool GLState::Filter(GLStateCall call, bool redundant)
+{
+	if (redundant)
+		m_Filtered[size_t(call)]++;
+	else
+		m_Issued[size_t(call)]++;
+	return redundant;
+}
+
+int GLState::TextureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_CUBE_MAP: return 1;
+	case GL_TEXTURE_2D_ARRAY: return 2;
+	case GL_TEXTURE_3D: return 3;
+	default: return -1;
+	}
+}
+
+int GLState::BufferTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_SHADER_STORAGE_BUFFER: return 3;
+	case GL_DRAW_INDIRECT_BUFFER: return 4;
+	case GL_DISPATCH_INDIRECT_BUFFER: return 5;
+	default: return -1;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstddef>
+
+enum class GLStateCall
+{
+	Program,
+	VertexArray,
+	Texture,
+	Sampler,
+	Buffer,
+	Depth,
+	Blend,
+	Count
+};
+
+// Shadow copy of the GL binding and fixed-function state we touch every frame. Every setter
+// compares against the shadow first and only calls into the driver when the value changes.
+// Anything that changes GL state behind our back (ImGui, raw glBind* calls) must be followed
+// by Invalidate(), which forgets the shadow so the next call of each kind goes through.
+// Call Invalidate() once after the context is created as well.
+class GLState
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+	static const unsigned int MAX_BUFFER_BINDINGS = 16;
+
+	static void UseProgram(GLuint program);
+	static void BindVertexArray(GLuint vao);
+	static void BindTexture(unsigned int unit, GLenum target, GLuint texture);
+	static void BindSampler(unsigned int unit, GLuint sampler);
+	static void BindBuffer(GLenum target, GLuint buffer);
+	// Indexed uniform / shader storage bindings, size 0 binds the whole buffer
+	static void BindBufferRange(GLenum target, unsigned int index, GLuint buffer, GLintptr offset = 0, GLsizeiptr size = 0);
+
+	static void SetDepthTest(bool enabled);
+	static void SetDepthFunc(GLenum func);
+	static void SetDepthMask(bool enabled);
+	static void SetBlend(bool enabled);
+	static void SetBlendFunc(GLenum source, GLenum destination);
+
+	static void Invalidate();
+
+	// Rolls this frame's counters over so DrawImGui() shows complete frames
+	static void BeginFrame();
+	static void DrawImGui();
+
+	static size_t GetIssued() { return m_LastIssued; }
+	static size_t GetFiltered() { return m_LastFiltered; }
+
+private:
+	static bool Filter(GLStateCall call, bool redundant);
+	static int TextureTargetIndex(GLenum target);
+	static int BufferTargetIndex(GLenum target);
+
+private:
+	struct IndexedBinding
+	{
+		GLuint m_buffer;
+		GLintptr m_offset;
+		GLsizeiptr m_size;
+	};
+
+	static const int TEXTURE_TARGET_COUNT = 4;
+	static const int BUFFER_TARGET_COUNT = 6;
+
+	static GLuint m_Program;
+	static GLuint m_VertexArray;
+	static unsigned int m_ActiveUnit;
+	static GLuint m_Textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	static GLuint m_Samplers[MAX_TEXTURE_UNITS];
+	static GLuint m_Buffers[BUFFER_TARGET_COUNT];
+	static IndexedBinding m_UniformBindings[MAX_BUFFER_BINDINGS];
+	static IndexedBinding m_StorageBindings[MAX_BUFFER_BINDINGS];
+
+	// -1 = unknown
+	static int m_DepthTest;
+	static int m_DepthMask;
+	static int m_Blend;
+	static GLenum m_DepthFunc;
+	static GLenum m_BlendSource;
+	static GLenum m_BlendDestination;
+
+	static size_t m_Issued[size_t(GLStateCall::Count)];
+	static size_t m_Filtered[size_t(GLStateCall::Count)];
+	static size_t m_LastIssuedByCall[size_t(GLStateCall::Count)];
+	static size_t m_LastFilteredByCall[size_t(GLStateCall::Count)];
+	static size_t m_LastIssued;
+	static size_t m_LastFiltered;
+};
@@ -0,0 +1,427 @@
+#include "GpuCulling.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "deps/imgui/imgui.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "InstanceBuffer.h"
+#include "helpers/GLExtensions.h"
+#include "helpers/Logger.h"
+
+namespace
+{
+	// Storage bindings gpu_cull.comp expects, the instances are at InstanceBuffer::STORAGE_BINDING
+	const unsigned int CULL_OBJECT_BINDING = 5;
+	const unsigned int MESH_BINDING = 6;
+	const unsigned int COMMAND_BINDING = 7;
+	const unsigned int COUNT_BINDING = 8;
+	// Frames between writing the draw count and reading it back, so the read never waits
+	const int READBACK_DELAY = 3;
+
+	// std430 CullObject in gpu_cull.comp
+	struct CullObject
+	{
+		glm::vec4 m_sphere;		// world center, radius
+		glm::uvec4 m_mesh;		// x = index into the mesh table
+	};
+
+	// std430 CullMesh in gpu_cull.comp
+	struct CullMesh
+	{
+		unsigned int m_indexCount;
+		unsigned int m_firstIndex;
+		int m_baseVertex;
+		float m_radius;			// bounding sphere around the origin
+	};
+
+	// Layout glMultiDrawElementsIndirect reads, DrawCommand in gpu_cull.comp
+	struct DrawElementsIndirectCommand
+	{
+		unsigned int m_count;
+		unsigned int m_instanceCount;
+		unsigned int m_firstIndex;
+		int m_baseVertex;
+		unsigned int m_baseInstance;
+	};
+
+	void AddBox(std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+	{
+		for (int i = 0; i < 8; i++)
+			vertices.push_back(glm::vec3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f));
+		// Two counterclockwise triangles per face, seen from outside
+		const unsigned int faces[6][4] = {
+			{ 0, 4, 6, 2 }, { 1, 3, 7, 5 },	// -X, +X
+			{ 0, 1, 5, 4 }, { 2, 6, 7, 3 },	// -Y, +Y
+			{ 0, 2, 3, 1 }, { 4, 5, 7, 6 }	// -Z, +Z
+		};
+		for (const auto& face : faces)
+		{
+			for (unsigned int corner : { 0, 1, 2, 0, 2, 3 })
+				indices.push_back(face[corner]);
+		}
+	}
+
+	void AddSphere(std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices, int segments, int rings)
+	{
+		const float pi = 3.14159265f;
+		for (int ring = 0; ring <= rings; ring++)
+		{
+			float phi = pi * ring / rings;
+			for (int segment = 0; segment <= segments; segment++)
+			{
+				float theta = 2.0f * pi * segment / segments;
+				vertices.push_back(0.5f * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+			}
+		}
+		for (int ring = 0; ring < rings; ring++)
+		{
+			for (int segment = 0; segment < segments; segment++)
+			{
+				unsigned int a = ring * (segments + 1) + segment;
+				unsigned int b = a + segments + 1;
+				for (unsigned int index : { a, a + 1, b, a + 1, b + 1, b })
+					indices.push_back(index);
+			}
+		}
+	}
+}
+
+GpuCulling::GpuCulling()
+	: m_VertexArray(0)
+	, m_VertexBuffer(0)
+	, m_IndexBuffer(0)
+	, m_InstanceIndexBuffer(0)
+	, m_MeshBuffer(0)
+	, m_MeshCount(0)
+	, m_InstanceBuffer(0)
+	, m_CullObjectBuffer(0)
+	, m_CommandBuffer(0)
+	, m_CountBuffer(0)
+	, m_CountReadback(0)
+	, m_ObjectCount(0)
+	, m_Frame(0)
+	, m_VisibleCount(0)
+	, m_DepthCopy(0)
+	, m_DepthCopyFramebuffer(0)
+	, m_Pyramid(0)
+	, m_PyramidWidth(0)
+	, m_PyramidHeight(0)
+	, m_PyramidLevels(0)
+	, m_PyramidViewProjection(1.0f)
+	, m_PyramidValid(false)
+	, m_Occlusion(true)
+	, m_CullShader("res/shaders/gpu_cull.comp")
+	, m_PyramidShader("res/shaders/depth_pyramid.comp")
+	, m_DrawShader("res/shaders/gpu_culled_vertex.glsl", "res/shaders/gpu_culled_fragment.glsl")
+{
+	CreateMeshes();
+
+	glCreateBuffers(1, &m_InstanceBuffer);
+	glNamedBufferStorage(m_InstanceBuffer, MAX_OBJECTS * sizeof(InstanceData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	GpuMemoryTracker::TrackBuffer(m_InstanceBuffer, MAX_OBJECTS * sizeof(InstanceData), GpuMemoryCategory::StorageBuffer, "GpuCulling instances", "Instance");
+
+	glCreateBuffers(1, &m_CullObjectBuffer);
+	glNamedBufferStorage(m_CullObjectBuffer, MAX_OBJECTS * sizeof(CullObject), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	GpuMemoryTracker::TrackBuffer(m_CullObjectBuffer, MAX_OBJECTS * sizeof(CullObject), GpuMemoryCategory::StorageBuffer, "GpuCulling bounds", "CullObject");
+
+	glCreateBuffers(1, &m_CommandBuffer);
+	glNamedBufferStorage(m_CommandBuffer, MAX_OBJECTS * sizeof(DrawElementsIndirectCommand), nullptr, 0);
+	GpuMemoryTracker::TrackBuffer(m_CommandBuffer, MAX_OBJECTS * sizeof(DrawElementsIndirectCommand), GpuMemoryCategory::StorageBuffer, "GpuCulling commands", "DrawElementsIndirectCommand");
+
+	glCreateBuffers(1, &m_CountBuffer);
+	glNamedBufferStorage(m_CountBuffer, sizeof(unsigned int), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	GpuMemoryTracker::TrackBuffer(m_CountBuffer, sizeof(unsigned int), GpuMemoryCategory::StorageBuffer, "GpuCulling draw count", "uint");
+
+	glCreateBuffers(1, &m_CountReadback);
+	glNamedBufferStorage(m_CountReadback, READBACK_DELAY * sizeof(unsigned int), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	GpuMemoryTracker::TrackBuffer(m_CountReadback, READBACK_DELAY * sizeof(unsigned int), GpuMemoryCategory::StorageBuffer, "GpuCulling draw count readback", "uint");
+
+	glCreateFramebuffers(1, &m_DepthCopyFramebuffer);
+
+	if (!GLExtensions::HasIndirectDrawCount())
+		Logger::LogWarning("GpuCulling: GL_ARB_indirect_parameters is not supported, culled objects are drawn with an instance count of 0");
+}
+
+GpuCulling::~GpuCulling()
+{
+	for (unsigned int buffer : { m_VertexBuffer, m_IndexBuffer, m_InstanceIndexBuffer, m_MeshBuffer, m_InstanceBuffer, m_CullObjectBuffer, m_CommandBuffer, m_CountBuffer, m_CountReadback })
+	{
+		glDeleteBuffers(1, &buffer);
+		GpuMemoryTracker::UntrackBuffer(buffer);
+	}
+	glDeleteVertexArrays(1, &m_VertexArray);
+	for (unsigned int texture : { m_DepthCopy, m_Pyramid })
+	{
+		glDeleteTextures(1, &texture);
+		GpuMemoryTracker::UntrackTexture(texture);
+	}
+	glDeleteFramebuffers(1, &m_DepthCopyFramebuffer);
+	GLState::Invalidate();
+}
+
+void GpuCulling::CreateMeshes()
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<CullMesh> meshes;
+
+	// Indices are relative to each mesh's first vertex, baseVertex offsets them at draw time
+	meshes.push_back({ 0, unsigned(indices.size()), int(vertices.size()), std::sqrt(0.75f) });
+	AddBox(vertices, indices);
+	meshes.back().m_indexCount = unsigned(indices.size()) - meshes.back().m_firstIndex;
+
+	meshes.push_back({ 0, unsigned(indices.size()), int(vertices.size()), 0.5f });
+	AddSphere(vertices, indices, 16, 8);
+	meshes.back().m_indexCount = unsigned(indices.size()) - meshes.back().m_firstIndex;
+
+	m_MeshCount = int(meshes.size());
+	for (const CullMesh& mesh : meshes)
+		m_MeshRadii.push_back(mesh.m_radius);
+
+	glCreateBuffers(1, &m_VertexBuffer);
+	glNamedBufferStorage(m_VertexBuffer, vertices.size() * sizeof(glm::vec3), vertices.data(), 0);
+	GpuMemoryTracker::TrackBuffer(m_VertexBuffer, vertices.size() * sizeof(glm::vec3), GpuMemoryCategory::VertexBuffer, "GpuCulling vertices", "vec3");
+
+	glCreateBuffers(1, &m_IndexBuffer);
+	glNamedBufferStorage(m_IndexBuffer, indices.size() * sizeof(unsigned int), indices.data(), 0);
+	GpuMemoryTracker::TrackBuffer(m_IndexBuffer, indices.size() * sizeof(unsigned int), GpuMemoryCategory::IndexBuffer, "GpuCulling indices", "uint");
+
+	glCreateBuffers(1, &m_MeshBuffer);
+	glNamedBufferStorage(m_MeshBuffer, meshes.size() * sizeof(CullMesh), meshes.data(), 0);
+	GpuMemoryTracker::TrackBuffer(m_MeshBuffer, meshes.size() * sizeof(CullMesh), GpuMemoryCategory::StorageBuffer, "GpuCulling meshes", "CullMesh");
+
+	// 0, 1, 2... read with divisor 1, so each draw's first instance reads its baseInstance
+	std::vector<unsigned int> sequence(MAX_OBJECTS);
+	for (int i = 0; i < MAX_OBJECTS; i++)
+		sequence[i] = i;
+	glCreateBuffers(1, &m_InstanceIndexBuffer);
+	glNamedBufferStorage(m_InstanceIndexBuffer, sequence.size() * sizeof(unsigned int), sequence.data(), 0);
+	GpuMemoryTracker::TrackBuffer(m_InstanceIndexBuffer, sequence.size() * sizeof(unsigned int), GpuMemoryCategory::VertexBuffer, "GpuCulling instance indices", "uint");
+
+	glCreateVertexArrays(1, &m_VertexArray);
+	glVertexArrayVertexBuffer(m_VertexArray, 0, m_VertexBuffer, 0, sizeof(glm::vec3));
+	glEnableVertexArrayAttrib(m_VertexArray, 0);
+	glVertexArrayAttribFormat(m_VertexArray, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(m_VertexArray, 0, 0);
+
+	glVertexArrayVertexBuffer(m_VertexArray, 1, m_InstanceIndexBuffer, 0, sizeof(unsigned int));
+	glVertexArrayBindingDivisor(m_VertexArray, 1, 1);
+	glEnableVertexArrayAttrib(m_VertexArray, 1);
+	glVertexArrayAttribIFormat(m_VertexArray, 1, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(m_VertexArray, 1, 1);
+
+	glVertexArrayElementBuffer(m_VertexArray, m_IndexBuffer);
+}
+
+void GpuCulling::CreateObjects(int count)
+{
+	count = std::min(std::max(count, 0), MAX_OBJECTS);
+	m_ObjectCount = count;
+
+	std::vector<InstanceData> instances(count);
+	std::vector<CullObject> objects(count);
+
+	// A square field around the scene, roughly the same density for any count
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float halfSide = 1.5f * std::sqrt(float(count)) * 0.5f + 5.0f;
+	for (int i = 0; i < count; i++)
+	{
+		int mesh = i % m_MeshCount;
+		glm::vec3 position((unit(random) * 2.0f - 1.0f) * halfSide, -2.0f + unit(random) * 0.5f, -3.0f + (unit(random) * 2.0f - 1.0f) * halfSide);
+		float scale = 0.3f + 0.6f * unit(random);
+		float yaw = 6.2832f * unit(random);
+		glm::mat4 model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), position), yaw, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(scale));
+
+		// Uniform scale, the normal matrix is the rotation
+		glm::mat3 rotation = glm::mat3(model) / scale;
+		instances[i].m_model = model;
+		instances[i].m_normalMatrix = glm::mat3x4(glm::vec4(rotation[0], 0.0f), glm::vec4(rotation[1], 0.0f), glm::vec4(rotation[2], 0.0f));
+		instances[i].m_color = glm::vec4(0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random), 1.0f);
+
+		float radius = m_MeshRadii[mesh] * scale;
+		objects[i].m_sphere = glm::vec4(position, radius);
+		objects[i].m_mesh = glm::uvec4(mesh, 0, 0, 0);
+	}
+
+	if (count > 0)
+	{
+		glNamedBufferSubData(m_InstanceBuffer, 0, count * sizeof(InstanceData), instances.data());
+		glNamedBufferSubData(m_CullObjectBuffer, 0, count * sizeof(CullObject), objects.data());
+	}
+}
+
+bool GpuCulling::IsCompacting() const
+{
+	return GLExtensions::HasIndirectDrawCount();
+}
+
+void GpuCulling::ResizePyramid(int width, int height)
+{
+	if (width == m_PyramidWidth && height == m_PyramidHeight)
+		return;
+
+	for (unsigned int texture : { m_DepthCopy, m_Pyramid })
+	{
+		if (texture)
+		{
+			glDeleteTextures(1, &texture);
+			GpuMemoryTracker::UntrackTexture(texture);
+		}
+	}
+
+	m_PyramidWidth = width;
+	m_PyramidHeight = height;
+	m_PyramidLevels = 1 + int(std::floor(std::log2(float(std::max(width, height)))));
+	m_PyramidValid = false;
+
+	// Blitting depth needs the same format as the default framebuffer's
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_DepthCopy);
+	glTextureStorage2D(m_DepthCopy, 1, GL_DEPTH24_STENCIL8, width, height);
+	GpuMemoryTracker::TrackTexture(m_DepthCopy, size_t(width) * height * 4, GpuMemoryCategory::Attachment, "GpuCulling depth copy", "D24S8");
+	glNamedFramebufferTexture(m_DepthCopyFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_DepthCopy, 0);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_Pyramid);
+	glTextureStorage2D(m_Pyramid, m_PyramidLevels, GL_R32F, width, height);
+	glTextureParameteri(m_Pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(m_Pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GpuMemoryTracker::TrackTexture(m_Pyramid, size_t(width) * height * 4 * 4 / 3, GpuMemoryCategory::Attachment, "GpuCulling depth pyramid", "R32F");
+}
+
+void GpuCulling::UpdateDepthPyramid(unsigned int framebuffer, int width, int height, const glm::mat4& viewProjection)
+{
+	if (!m_Occlusion || !m_PyramidShader.IsReady() || width <= 0 || height <= 0)
+	{
+		m_PyramidValid = false;
+		return;
+	}
+	ResizePyramid(width, height);
+
+	m_PyramidTimer.Begin();
+	glBlitNamedFramebuffer(framebuffer, m_DepthCopyFramebuffer, 0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	// Level 0 is the depth itself, every other level the max of the 2x2 (3 wide at odd edges)
+	// texels below it, so a texel holds the farthest depth of the screen area it covers
+	m_PyramidShader.Use();
+	GLState::BindTexture(0, GL_TEXTURE_2D, m_DepthCopy);
+	m_PyramidShader.SetInt("sourceDepth", 0);
+	for (int level = 0; level < m_PyramidLevels; level++)
+	{
+		int levelWidth = std::max(1, width >> level);
+		int levelHeight = std::max(1, height >> level);
+		m_PyramidShader.SetInt("level", level);
+		if (level > 0)
+			glBindImageTexture(0, m_Pyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, m_Pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	m_PyramidTimer.End();
+
+	m_PyramidViewProjection = viewProjection;
+	m_PyramidValid = true;
+}
+
+void GpuCulling::Cull(const glm::mat4& projection, const glm::mat4& view)
+{
+	if (m_ObjectCount == 0 || !m_CullShader.IsReady())
+		return;
+
+	// Gribb-Hartmann: the planes are sums and differences of the rows of the view projection
+	glm::mat4 viewProjection = projection * view;
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+	glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	m_CullTimer.Begin();
+	const unsigned int zero = 0;
+	glClearNamedBufferData(m_CountBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	m_CullShader.Use();
+	m_CullShader.SetInt("objectCount", m_ObjectCount);
+	m_CullShader.SetBool("compact", IsCompacting());
+	glUniform4fv(m_CullShader.GetUniformLocation("frustumPlanes"), 6, &planes[0][0]);
+
+	bool occlusion = m_Occlusion && m_PyramidValid;
+	m_CullShader.SetBool("occlusion", occlusion);
+	if (occlusion)
+	{
+		m_CullShader.SetMat4("pyramidViewProjection", m_PyramidViewProjection);
+		m_CullShader.SetVec2("pyramidSize", glm::vec2(m_PyramidWidth, m_PyramidHeight));
+		m_CullShader.SetInt("pyramidLevels", m_PyramidLevels);
+		m_CullShader.SetInt("depthPyramid", PYRAMID_TEXTURE_UNIT);
+		GLState::BindTexture(PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, m_Pyramid);
+	}
+
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, CULL_OBJECT_BINDING, m_CullObjectBuffer);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, m_MeshBuffer);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, m_CommandBuffer);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, m_CountBuffer);
+	glDispatchCompute((m_ObjectCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	m_CullTimer.End();
+
+	// The count of READBACK_DELAY - 1 frames ago has long been written
+	int slot = m_Frame % READBACK_DELAY;
+	glCopyNamedBufferSubData(m_CountBuffer, m_CountReadback, 0, slot * sizeof(unsigned int), sizeof(unsigned int));
+	if (m_Frame >= READBACK_DELAY - 1)
+	{
+		unsigned int visible = 0;
+		glGetNamedBufferSubData(m_CountReadback, ((m_Frame + 1) % READBACK_DELAY) * sizeof(unsigned int), sizeof(unsigned int), &visible);
+		m_VisibleCount = int(visible);
+	}
+	m_Frame++;
+}
+
+void GpuCulling::Draw()
+{
+	if (m_ObjectCount == 0 || !m_CullShader.IsReady() || !m_DrawShader.IsReady())
+		return;
+
+	m_DrawTimer.Begin();
+	m_DrawShader.Use();
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, InstanceBuffer::STORAGE_BINDING, m_InstanceBuffer);
+	GLState::BindVertexArray(m_VertexArray);
+	GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+	if (IsCompacting())
+	{
+		GLState::BindBuffer(GL_PARAMETER_BUFFER_ARB, m_CountBuffer);
+		GLExtensions::MultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, m_ObjectCount, 0);
+	}
+	else
+	{
+		// llvmpipe caps plain multi draws at the count in a bound parameter buffer too
+		GLState::BindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, m_ObjectCount, 0);
+	}
+	m_DrawTimer.End();
+}
+
+void GpuCulling::ReloadShaders()
+{
+	m_CullShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+	m_PyramidShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+	m_DrawShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+}
+
+void GpuCulling::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	ImGui::Text("%d objects, %d visible", m_ObjectCount, m_VisibleCount);
+	ImGui::Checkbox("Occlusion (last frame's depth)", &m_Occlusion);
+	ImGui::Text("Draw count: %s", IsCompacting() ? "compacted, glMultiDrawElementsIndirectCountARB" : "one command per object");
+	ImGui::Text("GPU: cull %.3f ms, draw %.3f ms, depth pyramid %.3f ms", m_CullTimer.GetMilliseconds(), m_DrawTimer.GetMilliseconds(), m_PyramidTimer.GetMilliseconds());
+	ImGui::End();
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "GpuTimer.h"
+#include "Shader.h"
+
+// A field of props whose visibility is decided entirely on the GPU, so the CPU cost of culling and
+// drawing them is the same for a hundred objects or MAX_OBJECTS:
+// - every object's transform (include/instances.glsl) and world bounding sphere, and every mesh's
+//   index range, live in SSBOs written once
+// - a compute pass (gpu_cull.comp) tests each sphere against the frustum and against a max-depth
+//   pyramid built from the previous frame's depth buffer, and appends a DrawElementsIndirectCommand
+//   for every survivor
+// - one glMultiDrawElementsIndirectCountARB draws them, reading the draw count the compute pass
+//   wrote. Without GL_ARB_indirect_parameters every object keeps its own command instead, with an
+//   instance count of 0 when culled, drawn with a plain glMultiDrawElementsIndirect.
+//
+// Each command's baseInstance is its object's index. gl_InstanceID does not include baseInstance
+// (gl_BaseInstance needs GL 4.6 or ARB_shader_draw_parameters), but instanced vertex attributes do,
+// so the vertex shader gets the index from an attribute with divisor 1 over the sequence 0, 1, 2...
+//
+// Occlusion uses last frame's depth and camera, so an object that comes into view from behind an
+// occluder shows up one frame late.
+class GpuCulling
+{
+public:
+	static const int MAX_OBJECTS = 65536;
+	static const int GROUP_SIZE = 64;
+	// Texture unit gpu_cull.comp reads the depth pyramid from
+	static const unsigned int PYRAMID_TEXTURE_UNIT = 11;
+
+	GpuCulling();
+	~GpuCulling();
+
+	GpuCulling(const GpuCulling&) = delete;
+	GpuCulling& operator=(const GpuCulling&) = delete;
+
+	// Scatters count objects around the scene, the same ones for the same count
+	void CreateObjects(int count);
+	// Writes this frame's draw commands
+	void Cull(const glm::mat4& projection, const glm::mat4& view);
+	// Draws what Cull() kept, the Matrices block has to be bound
+	void Draw();
+	// Builds the depth pyramid for next frame's occlusion test from the depth of framebuffer
+	// (0 for the default one), rendered with viewProjection
+	void UpdateDepthPyramid(unsigned int framebuffer, int width, int height, const glm::mat4& viewProjection);
+
+	void ReloadShaders();
+	void DrawImGui(const char* title);
+
+	int GetObjectCount() const { return m_ObjectCount; }
+	// From a few frames ago, the count is read back without waiting for the GPU
+	int GetVisibleCount() const { return m_VisibleCount; }
+	bool IsCompacting() const;
+	void SetOcclusion(bool enabled) { m_Occlusion = enabled; }
+
+private:
+	void CreateMeshes();
+	void ResizePyramid(int width, int height);
+
+private:
+	// Every mesh in one vertex and one index buffer
+	unsigned int m_VertexArray;
+	unsigned int m_VertexBuffer;
+	unsigned int m_IndexBuffer;
+	unsigned int m_InstanceIndexBuffer;
+	unsigned int m_MeshBuffer;
+	int m_MeshCount;
+	std::vector<float> m_MeshRadii;
+
+	unsigned int m_InstanceBuffer;
+	unsigned int m_CullObjectBuffer;
+	unsigned int m_CommandBuffer;
+	unsigned int m_CountBuffer;
+	unsigned int m_CountReadback;
+	int m_ObjectCount;
+	int m_Frame;
+	int m_VisibleCount;
+
+	// Depth of the last frame, copied out of its framebuffer, and its max reduction
+	unsigned int m_DepthCopy;
+	unsigned int m_DepthCopyFramebuffer;
+	unsigned int m_Pyramid;
+	int m_PyramidWidth;
+	int m_PyramidHeight;
+	int m_PyramidLevels;
+	glm::mat4 m_PyramidViewProjection;
+	bool m_PyramidValid;
+	bool m_Occlusion;
+
+	Shader m_CullShader;
+	Shader m_PyramidShader;
+	Shader m_DrawShader;
+	GpuTimer m_CullTimer;
+	GpuTimer m_DrawTimer;
+	GpuTimer m_PyramidTimer;
+};
@@ -0,0 +1,232 @@
+#include "GpuMemoryTracker.h"
+
+#include "deps/imgui/imgui.h"
+#include "helpers/Logger.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+std::unordered_map<uint64_t, GpuMemoryTracker::Allocation> GpuMemoryTracker::m_Allocations;
+size_t GpuMemoryTracker::m_CategoryBytes[size_t(GpuMemoryCategory::Count)] = {};
+int GpuMemoryTracker::m_TopCount = 10;
+
+namespace
+{
+	std::string EscapeJson(const std::string& string)
+	{
+		std::string escaped;
+		for (char c : string)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	std::string FormatBytes(size_t bytes)
+	{
+		std::stringstream ss;
+		ss.precision(2);
+		ss << std::fixed;
+		if (bytes >= 1024 * 1024)
+			ss << bytes / (1024.0 * 1024.0) << " MB";
+		else if (bytes >= 1024)
+			ss << bytes / 1024.0 << " KB";
+		else
+			ss << bytes << " B";
+		return ss.str();
+	}
+}
+
+void GpuMemoryTracker::TrackBuffer(unsigned int id, size_t bytes, GpuMemoryCategory category, const std::string& owner, const char* format)
+{
+	Track(MakeKey(ObjectType::Buffer, id), { category, bytes, format, owner });
+}
+
+void GpuMemoryTracker::TrackTexture(unsigned int id, size_t bytes, GpuMemoryCategory category, const std::string& owner, const char* format)
+{
+	Track(MakeKey(ObjectType::Texture, id), { category, bytes, format, owner });
+}
+
+void GpuMemoryTracker::TrackRenderbuffer(unsigned int id, size_t bytes, const std::string& owner, const char* format)
+{
+	Track(MakeKey(ObjectType::Renderbuffer, id), { GpuMemoryCategory::Attachment, bytes, format, owner });
+}
+
+void GpuMemoryTracker::UntrackBuffer(unsigned int id)
+{
+	Untrack(MakeKey(ObjectType::Buffer, id));
+}
+
+void GpuMemoryTracker::UntrackTexture(unsigned int id)
+{
+	Untrack(MakeKey(ObjectType::Texture, id));
+}
+
+void GpuMemoryTracker::UntrackRenderbuffer(unsigned int id)
+{
+	Untrack(MakeKey(ObjectType::Renderbuffer, id));
+}
+
+void GpuMemoryTracker::TrackImGui(const ImDrawData* drawData)
+{
+	if (!drawData)
+		return;
+
+	Track(MakeKey(ObjectType::ImGui, 0), { GpuMemoryCategory::ImGui, drawData->TotalVtxCount * sizeof(ImDrawVert), "ImDrawVert", "ImGui vertex buffer" });
+	Track(MakeKey(ObjectType::ImGui, 1), { GpuMemoryCategory::ImGui, drawData->TotalIdxCount * sizeof(ImDrawIdx), "ImDrawIdx", "ImGui index buffer" });
+
+	const ImFontAtlas* fonts = ImGui::GetIO().Fonts;
+	Track(MakeKey(ObjectType::ImGui, 2), { GpuMemoryCategory::ImGui, size_t(fonts->TexWidth) * fonts->TexHeight * 4, "GL_RGBA8", "ImGui font atlas" });
+}
+
+size_t GpuMemoryTracker::TextureBytes(int width, int height, int layers, int bytesPerTexel, int levels)
+{
+	size_t bytes = 0;
+	for (int level = 0; level < levels; level++)
+	{
+		bytes += size_t(std::max(width >> level, 1)) * std::max(height >> level, 1) * layers * bytesPerTexel;
+	}
+	return bytes;
+}
+
+int GpuMemoryTracker::MipLevels(int width, int height)
+{
+	int levels = 1;
+	for (int size = std::max(width, height); size > 1; size /= 2)
+		levels++;
+	return levels;
+}
+
+size_t GpuMemoryTracker::GetTotalBytes()
+{
+	size_t total = 0;
+	for (size_t bytes : m_CategoryBytes)
+		total += bytes;
+	return total;
+}
+
+size_t GpuMemoryTracker::GetCategoryBytes(GpuMemoryCategory category)
+{
+	return m_CategoryBytes[size_t(category)];
+}
+
+const char* GpuMemoryTracker::GetCategoryName(GpuMemoryCategory category)
+{
+	switch (category)
+	{
+	case GpuMemoryCategory::VertexBuffer: return "Vertex buffers";
+	case GpuMemoryCategory::IndexBuffer: return "Index buffers";
+	case GpuMemoryCategory::UniformBuffer: return "Uniform buffers";
+	case GpuMemoryCategory::StorageBuffer: return "Storage buffers";
+	case GpuMemoryCategory::Texture: return "Textures";
+	case GpuMemoryCategory::Cubemap: return "Cubemaps";
+	case GpuMemoryCategory::Attachment: return "Framebuffer attachments";
+	case GpuMemoryCategory::ImGui: return "ImGui";
+	default: return "Unknown";
+	}
+}
+
+void GpuMemoryTracker::DrawImGui()
+{
+	ImGui::Begin("GPU Memory");
+
+	ImGui::Text("Total: %s in %d objects", FormatBytes(GetTotalBytes()).c_str(), int(m_Allocations.size()));
+	ImGui::Separator();
+
+	ImGui::Columns(2, "categories");
+	for (size_t i = 0; i < size_t(GpuMemoryCategory::Count); i++)
+	{
+		ImGui::Text("%s", GetCategoryName(GpuMemoryCategory(i)));
+		ImGui::NextColumn();
+		ImGui::Text("%s", FormatBytes(m_CategoryBytes[i]).c_str());
+		ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::Separator();
+
+	ImGui::SliderInt("Top consumers", &m_TopCount, 1, 50);
+
+	std::vector<const Allocation*> sorted;
+	sorted.reserve(m_Allocations.size());
+	for (const auto& allocation : m_Allocations)
+		sorted.push_back(&allocation.second);
+
+	size_t count = std::min(sorted.size(), size_t(m_TopCount));
+	std::partial_sort(sorted.begin(), sorted.begin() + count, sorted.end(), [](const Allocation* a, const Allocation* b)
+	{
+		return a->m_bytes > b->m_bytes;
+	});
+
+	ImGui::Columns(3, "consumers");
+	for (size_t i = 0; i < count; i++)
+	{
+		ImGui::Text("%s", sorted[i]->m_owner.c_str());
+		ImGui::NextColumn();
+		ImGui::Text("%s", sorted[i]->m_format.c_str());
+		ImGui::NextColumn();
+		ImGui::Text("%s", FormatBytes(sorted[i]->m_bytes).c_str());
+		ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+
+	if (ImGui::Button("Dump to gpu_memory.json"))
+	{
+		DumpJson("gpu_memory.json");
+	}
+
+	ImGui::End();
+}
+
+bool GpuMemoryTracker::DumpJson(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		Logger::LogError("GpuMemoryTracker: could not write " + path);
+		return false;
+	}
+
+	file << "{\n";
+	file << "  \"totalBytes\": " << GetTotalBytes() << ",\n";
+	file << "  \"categories\": {\n";
+	for (size_t i = 0; i < size_t(GpuMemoryCategory::Count); i++)
+	{
+		file << "    \"" << GetCategoryName(GpuMemoryCategory(i)) << "\": " << m_CategoryBytes[i];
+		file << (i + 1 < size_t(GpuMemoryCategory::Count) ? ",\n" : "\n");
+	}
+	file << "  },\n";
+	file << "  \"objects\": [\n";
+	size_t index = 0;
+	for (const auto& allocation : m_Allocations)
+	{
+		const Allocation& a = allocation.second;
+		file << "    { \"category\": \"" << GetCategoryName(a.m_category) << "\", \"bytes\": " << a.m_bytes
+			<< ", \"format\": \"" << EscapeJson(a.m_format) << "\", \"owner\": \"" << EscapeJson(a.m_owner) << "\" }";
+		file << (++index < m_Allocations.size() ? ",\n" : "\n");
+	}
+	file << "  ]\n";
+	file << "}\n";
+
+	Logger::Log("GpuMemoryTracker: wrote " + path);
+	return true;
+}
+
+void GpuMemoryTracker::Track(uint64_t key, const Allocation& allocation)
+{
+	Untrack(key);
+	m_Allocations[key] = allocation;
+	m_CategoryBytes[size_t(allocation.m_category)] += allocation.m_bytes;
+}
+
+void GpuMemoryTracker::Untrack(uint64_t key)
+{
+	auto it = m_Allocations.find(key);
+	if (it == m_Allocations.end())
+		return;
+
+	m_CategoryBytes[size_t(it->second.m_category)] -= it->second.m_bytes;
+	m_Allocations.erase(it);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+struct ImDrawData;
+
+enum class GpuMemoryCategory
+{
+	VertexBuffer,
+	IndexBuffer,
+	UniformBuffer,
+	StorageBuffer,
+	Texture,
+	Cubemap,
+	Attachment,
+	ImGui,
+	Count
+};
+
+// Book-keeping of every GL buffer, texture and framebuffer attachment we create, so we can
+// answer "how much VRAM is the scene using". Sizes are what we asked the driver for; padding
+// and driver-internal copies are not visible from the API.
+class GpuMemoryTracker
+{
+public:
+	static void TrackBuffer(unsigned int id, size_t bytes, GpuMemoryCategory category, const std::string& owner, const char* format = "");
+	static void TrackTexture(unsigned int id, size_t bytes, GpuMemoryCategory category, const std::string& owner, const char* format);
+	static void TrackRenderbuffer(unsigned int id, size_t bytes, const std::string& owner, const char* format);
+	static void UntrackBuffer(unsigned int id);
+	static void UntrackTexture(unsigned int id);
+	static void UntrackRenderbuffer(unsigned int id);
+
+	// ImGui streams its vertex/index buffers every frame, so those are sampled from the draw data
+	static void TrackImGui(const ImDrawData* drawData);
+
+	// Size of a (possibly layered) texture including its mip chain
+	static size_t TextureBytes(int width, int height, int layers, int bytesPerTexel, int levels);
+	static int MipLevels(int width, int height);
+
+	static size_t GetTotalBytes();
+	static size_t GetCategoryBytes(GpuMemoryCategory category);
+	static const char* GetCategoryName(GpuMemoryCategory category);
+
+	static void DrawImGui();
+	static bool DumpJson(const std::string& path);
+
+private:
+	enum class ObjectType : uint32_t
+	{
+		Buffer,
+		Texture,
+		Renderbuffer,
+		ImGui
+	};
+
+	struct Allocation
+	{
+		GpuMemoryCategory m_category;
+		size_t m_bytes;
+		std::string m_format;
+		std::string m_owner;
+	};
+
+	static uint64_t MakeKey(ObjectType type, unsigned int id) { return (uint64_t(type) << 32) | id; }
+	static void Track(uint64_t key, const Allocation& allocation);
+	static void Untrack(uint64_t key);
+
+private:
+	static std::unordered_map<uint64_t, Allocation> m_Allocations;
+	static size_t m_CategoryBytes[size_t(GpuMemoryCategory::Count)];
+	static int m_TopCount;
+};
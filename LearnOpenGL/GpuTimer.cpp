@@ -0,0 +1,72 @@
+#include "GpuTimer.h"
+
+#include <glad/glad.h>
+
+GpuTimer::GpuTimer()
+	: m_Next(0)
+	, m_Running(false)
+	, m_Samples(0)
+	, m_Milliseconds(0.0f)
+	, m_LastMilliseconds(0.0f)
+{
+	glGenQueries(QUERY_COUNT, m_Queries);
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		m_InFlight[i] = false;
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(QUERY_COUNT, m_Queries);
+}
+
+void GpuTimer::Begin()
+{
+	CollectResults();
+
+	// Every query is still waiting on the GPU, skip this sample rather than stall
+	if (m_InFlight[m_Next])
+		return;
+
+	glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Next]);
+	m_Running = true;
+}
+
+void GpuTimer::End()
+{
+	if (!m_Running)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_InFlight[m_Next] = true;
+	m_Next = (m_Next + 1) % QUERY_COUNT;
+	m_Running = false;
+}
+
+void GpuTimer::CollectResults()
+{
+	// Oldest first, so results come back in submission order
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		int index = (m_Next + i) % QUERY_COUNT;
+		if (!m_InFlight[index])
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_Queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(m_Queries[index], GL_QUERY_RESULT, &nanoseconds);
+		m_InFlight[index] = false;
+
+		// The first sample includes driver warm-up (shader JIT, and garbage on some drivers), drop it
+		if (m_Samples++ == 0)
+			continue;
+
+		m_LastMilliseconds = float(nanoseconds) / 1000000.0f;
+		m_Milliseconds = m_Milliseconds == 0.0f ? m_LastMilliseconds : m_Milliseconds * 0.9f + m_LastMilliseconds * 0.1f;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// Measures GPU time between Begin() and End() with GL_TIME_ELAPSED queries.
+// Results are read a few frames later from a small ring of queries, so the CPU never waits on the GPU.
+// Only one timer can be running at a time (GL does not nest GL_TIME_ELAPSED queries).
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	void Begin();
+	void End();
+
+	// Smoothed over the last few results, 0 until the first query has come back
+	float GetMilliseconds() const { return m_Milliseconds; }
+	float GetLastMilliseconds() const { return m_LastMilliseconds; }
+
+private:
+	void CollectResults();
+
+private:
+	static const int QUERY_COUNT = 4;
+
+	unsigned int m_Queries[QUERY_COUNT];
+	bool m_InFlight[QUERY_COUNT];
+	int m_Next;
+	bool m_Running;
+	int m_Samples;
+
+	float m_Milliseconds;
+	float m_LastMilliseconds;
+};
@@ -0,0 +1,564 @@
+#include "ImageBasedLighting.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+#include <xmmintrin.h>
+
+#include "deps/imgui/imgui.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "Cubemap.h"
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "SamplerCache.h"
+#include "helpers/Logger.h"
+#include "helpers/ThreadPool.h"
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x304C4249; // "IBL0"
+	const uint32_t CACHE_VERSION = 1;
+	// The irradiance is smooth enough that a small mip of the skybox projects to the same coefficients
+	const int IRRADIANCE_SOURCE_SIZE = 64;
+
+	struct CacheHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_version;
+		uint64_t m_sourceHash;
+		uint32_t m_size;
+		uint32_t m_levels;
+		uint32_t m_sampleCount;
+	};
+
+	// Cube face f covers the directions major + u * right + v * down for u, v in [-1, 1], with u
+	// along a row and v down the rows (the GL cube map face layout)
+	struct FaceBasis
+	{
+		glm::vec3 m_major;
+		glm::vec3 m_right;
+		glm::vec3 m_down;
+	};
+
+	const FaceBasis FACES[6] = {
+		{ glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f) },	// +X
+		{ glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f) },	// -X
+		{ glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) },		// +Y
+		{ glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },	// -Y
+		{ glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) },		// +Z
+		{ glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) },	// -Z
+	};
+
+	size_t PackedTexelCount(int size, int levels)
+	{
+		size_t total = 0;
+		for (int level = 0; level < levels; level++)
+		{
+			size_t levelSize = size_t(std::max(size >> level, 1));
+			total += levelSize * levelSize * 6;
+		}
+		return total;
+	}
+
+	float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Bilinear lookup inside the face the direction points at. Filtering stops at the face edges,
+	// which the prefiltering's many samples blur away.
+	glm::vec3 SampleCube(const std::vector<float>& texels, int size, const glm::vec3& direction)
+	{
+		glm::vec3 absolute = glm::abs(direction);
+		int face;
+		float major, u, v;
+		if (absolute.x >= absolute.y && absolute.x >= absolute.z)
+		{
+			face = direction.x > 0.0f ? 0 : 1;
+			major = absolute.x;
+			u = direction.x > 0.0f ? -direction.z : direction.z;
+			v = -direction.y;
+		}
+		else if (absolute.y >= absolute.z)
+		{
+			face = direction.y > 0.0f ? 2 : 3;
+			major = absolute.y;
+			u = direction.x;
+			v = direction.y > 0.0f ? direction.z : -direction.z;
+		}
+		else
+		{
+			face = direction.z > 0.0f ? 4 : 5;
+			major = absolute.z;
+			u = direction.z > 0.0f ? direction.x : -direction.x;
+			v = -direction.y;
+		}
+
+		float x = std::clamp((u / major * 0.5f + 0.5f) * float(size) - 0.5f, 0.0f, float(size - 1));
+		float y = std::clamp((v / major * 0.5f + 0.5f) * float(size) - 0.5f, 0.0f, float(size - 1));
+		int x0 = int(x);
+		int y0 = int(y);
+		int x1 = std::min(x0 + 1, size - 1);
+		int y1 = std::min(y0 + 1, size - 1);
+		float fx = x - float(x0);
+		float fy = y - float(y0);
+
+		const float* faceTexels = texels.data() + size_t(face) * size * size * 3;
+		auto texel = [&](int tx, int ty)
+		{
+			const float* t = faceTexels + (size_t(ty) * size + tx) * 3;
+			return glm::vec3(t[0], t[1], t[2]);
+		};
+		return glm::mix(glm::mix(texel(x0, y0), texel(x1, y0), fx), glm::mix(texel(x0, y1), texel(x1, y1), fx), fy);
+	}
+
+	float RadicalInverse(uint32_t bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return float(bits) * 2.3283064365386963e-10f;
+	}
+
+	// GGX samples of one roughness around +Z in structure-of-arrays form, padded to a multiple of
+	// four with zero weights. N = V = R, so every sample's weight and source mip are known up front.
+	struct SampleSet
+	{
+		std::vector<float> m_x;
+		std::vector<float> m_y;
+		std::vector<float> m_z;
+		std::vector<float> m_weight;
+		std::vector<int> m_sourceLevel;
+
+		void Add(const glm::vec3& direction, float weight, int sourceLevel)
+		{
+			m_x.push_back(direction.x);
+			m_y.push_back(direction.y);
+			m_z.push_back(direction.z);
+			m_weight.push_back(weight);
+			m_sourceLevel.push_back(sourceLevel);
+		}
+	};
+
+	SampleSet MakeSampleSet(float roughness, int sourceSize, int sourceLevels, int directLevel)
+	{
+		SampleSet samples;
+		if (roughness == 0.0f)
+		{
+			// A mirror, the skybox mip of the same size as the output is the answer
+			samples.Add(glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, directLevel);
+		}
+		else
+		{
+			const float alpha = roughness * roughness;
+			const float alphaSq = alpha * alpha;
+			const float texelSolidAngle = 4.0f * glm::pi<float>() / (6.0f * float(sourceSize) * float(sourceSize));
+			for (int i = 0; i < ImageBasedLighting::SAMPLE_COUNT; i++)
+			{
+				float phi = glm::two_pi<float>() * float(i) / float(ImageBasedLighting::SAMPLE_COUNT);
+				float xi = RadicalInverse(uint32_t(i));
+				float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (alphaSq - 1.0f) * xi));
+				float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+				glm::vec3 halfway(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+				glm::vec3 light = 2.0f * cosTheta * halfway - glm::vec3(0.0f, 0.0f, 1.0f);
+				if (light.z <= 0.0f)
+					continue;
+
+				// The sample covers 1 / (count * pdf) steradians, read from the mip whose texels are that big
+				float denominator = (alphaSq - 1.0f) * cosTheta * cosTheta + 1.0f;
+				float distribution = alphaSq / (glm::pi<float>() * denominator * denominator);
+				float sampleSolidAngle = 1.0f / (float(ImageBasedLighting::SAMPLE_COUNT) * distribution * 0.25f);
+				float level = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+				samples.Add(light, light.z, std::clamp(int(level + 0.5f), 0, sourceLevels - 1));
+			}
+		}
+
+		while (samples.m_x.size() % 4 != 0)
+			samples.Add(glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 0);
+		return samples;
+	}
+}
+
+ImageBasedLighting::ImageBasedLighting(const Cubemap& skybox, const std::string& cachePath)
+	: m_Prefiltered(0)
+	, m_Block()
+	, m_Buffer("Environment")
+	, m_Baked(false)
+	, m_LoadMilliseconds(0.0f)
+	, m_IrradianceMilliseconds(0.0f)
+	, m_PrefilterMilliseconds(0.0f)
+	, m_ThreadCount(0)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::stringstream ss;
+	if (LoadCache(cachePath, skybox.GetSourceHash()))
+	{
+		m_LoadMilliseconds = MillisecondsSince(start);
+		ss << "ImageBasedLighting: warm load from " << cachePath << " took " << m_LoadMilliseconds << " ms";
+	}
+	else if (Bake(skybox))
+	{
+		SaveCache(cachePath, skybox.GetSourceHash());
+		m_LoadMilliseconds = MillisecondsSince(start);
+		ss << "ImageBasedLighting: baked in " << m_LoadMilliseconds << " ms on " << m_ThreadCount << " threads (irradiance "
+			<< m_IrradianceMilliseconds << " ms, prefiltering " << m_PrefilterMilliseconds << " ms)";
+	}
+	else
+	{
+		// No skybox, no ambient
+		m_Packed.assign(PackedTexelCount(PREFILTERED_SIZE, PREFILTERED_LEVELS), 0);
+	}
+	if (!ss.str().empty())
+		Logger::LogSuccess(ss.str());
+
+	m_Block.environmentParams = glm::vec4(float(PREFILTERED_LEVELS - 1), 0.5f, 0.5f, 0.0f);
+	Upload();
+}
+
+ImageBasedLighting::~ImageBasedLighting()
+{
+	GpuMemoryTracker::UntrackTexture(m_Prefiltered);
+	glDeleteTextures(1, &m_Prefiltered);
+	GLState::Invalidate();
+}
+
+bool ImageBasedLighting::LoadCache(const std::string& cachePath, uint64_t key)
+{
+	std::ifstream file(cachePath, std::ios::binary);
+	if (!file)
+		return false;
+
+	CacheHeader header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.m_magic != CACHE_MAGIC || header.m_version != CACHE_VERSION || header.m_sourceHash != key
+		|| header.m_size != PREFILTERED_SIZE || header.m_levels != PREFILTERED_LEVELS || header.m_sampleCount != SAMPLE_COUNT)
+	{
+		Logger::LogWarning("ImageBasedLighting: cache is stale, rebaking " + cachePath);
+		return false;
+	}
+
+	file.read(reinterpret_cast<char*>(m_Block.irradianceSH), sizeof(m_Block.irradianceSH));
+	m_Packed.resize(PackedTexelCount(PREFILTERED_SIZE, PREFILTERED_LEVELS));
+	file.read(reinterpret_cast<char*>(m_Packed.data()), m_Packed.size() * sizeof(uint32_t));
+	if (!file)
+	{
+		Logger::LogWarning("ImageBasedLighting: cache is truncated, rebaking " + cachePath);
+		return false;
+	}
+	return true;
+}
+
+void ImageBasedLighting::SaveCache(const std::string& cachePath, uint64_t key) const
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+
+	std::ofstream file(cachePath, std::ios::binary);
+	if (!file)
+	{
+		Logger::LogWarning("ImageBasedLighting: could not write cache " + cachePath);
+		return;
+	}
+
+	CacheHeader header{ CACHE_MAGIC, CACHE_VERSION, key, uint32_t(PREFILTERED_SIZE), uint32_t(PREFILTERED_LEVELS), uint32_t(SAMPLE_COUNT) };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_Block.irradianceSH), sizeof(m_Block.irradianceSH));
+	file.write(reinterpret_cast<const char*>(m_Packed.data()), m_Packed.size() * sizeof(uint32_t));
+}
+
+bool ImageBasedLighting::Bake(const Cubemap& skybox)
+{
+	if (skybox.GetLevels() == 0)
+	{
+		Logger::LogError("ImageBasedLighting: the skybox failed to load, nothing to bake");
+		return false;
+	}
+	m_Baked = true;
+
+	// Read the skybox back from twice the output size down, the finer levels are never sampled
+	int firstLevel = 0;
+	while (firstLevel + 1 < skybox.GetLevels() && (skybox.GetSize() >> firstLevel) > 2 * PREFILTERED_SIZE)
+		firstLevel++;
+
+	std::vector<CubeLevel> sources;
+	for (int level = firstLevel; level < skybox.GetLevels(); level++)
+	{
+		CubeLevel source;
+		source.m_size = std::max(skybox.GetSize() >> level, 1);
+		source.m_texels.resize(size_t(source.m_size) * source.m_size * 6 * 3);
+		glGetTextureImage(skybox.GetId(), level, GL_RGB, GL_FLOAT, GLsizei(source.m_texels.size() * sizeof(float)), source.m_texels.data());
+		sources.push_back(std::move(source));
+	}
+
+	ThreadPool pool;
+	m_ThreadCount = pool.GetThreadCount() + 1;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	const CubeLevel* irradianceSource = &sources.back();
+	for (const CubeLevel& source : sources)
+	{
+		if (source.m_size <= IRRADIANCE_SOURCE_SIZE)
+		{
+			irradianceSource = &source;
+			break;
+		}
+	}
+	ProjectIrradiance(*irradianceSource, pool);
+	m_IrradianceMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	Prefilter(sources, pool);
+	m_PrefilterMilliseconds = MillisecondsSince(start);
+	return true;
+}
+
+void ImageBasedLighting::ProjectIrradiance(const CubeLevel& source, ThreadPool& pool)
+{
+	// 9 coefficients * 3 channels and the total solid angle, summed per row and reduced at the end
+	const int size = source.m_size;
+	const int rowCount = 6 * size;
+	std::vector<float> rowSums(size_t(rowCount) * 28, 0.0f);
+
+	pool.ParallelFor(rowCount, [&](int row)
+	{
+		const FaceBasis& basis = FACES[row / size];
+		const int y = row % size;
+		const float v = (float(y) + 0.5f) * 2.0f / float(size) - 1.0f;
+		const float* texels = source.m_texels.data() + size_t(row) * size * 3;
+
+		// Direction of each texel center: major + u * right + v * down, four texels per register
+		const __m128 baseX = _mm_set1_ps(basis.m_major.x + basis.m_down.x * v);
+		const __m128 baseY = _mm_set1_ps(basis.m_major.y + basis.m_down.y * v);
+		const __m128 baseZ = _mm_set1_ps(basis.m_major.z + basis.m_down.z * v);
+		const __m128 rightX = _mm_set1_ps(basis.m_right.x);
+		const __m128 rightY = _mm_set1_ps(basis.m_right.y);
+		const __m128 rightZ = _mm_set1_ps(basis.m_right.z);
+		const __m128 texelArea = _mm_set1_ps(4.0f / (float(size) * float(size)));
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 three = _mm_set1_ps(3.0f);
+
+		__m128 sums[28];
+		for (__m128& sum : sums)
+			sum = _mm_setzero_ps();
+
+		for (int x = 0; x < size; x += 4)
+		{
+			float u[4];
+			float colors[3][4];
+			float valid[4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				int column = std::min(x + lane, size - 1);
+				u[lane] = (float(column) + 0.5f) * 2.0f / float(size) - 1.0f;
+				valid[lane] = x + lane < size ? 1.0f : 0.0f;
+				for (int channel = 0; channel < 3; channel++)
+					colors[channel][lane] = texels[column * 3 + channel];
+			}
+
+			__m128 u4 = _mm_loadu_ps(u);
+			__m128 dx = _mm_add_ps(baseX, _mm_mul_ps(rightX, u4));
+			__m128 dy = _mm_add_ps(baseY, _mm_mul_ps(rightY, u4));
+			__m128 dz = _mm_add_ps(baseZ, _mm_mul_ps(rightZ, u4));
+			__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+			__m128 nx = _mm_mul_ps(dx, inverseLength);
+			__m128 ny = _mm_mul_ps(dy, inverseLength);
+			__m128 nz = _mm_mul_ps(dz, inverseLength);
+
+			// Solid angle of the texel, its area on the unit cube projected onto the sphere
+			__m128 weight = _mm_mul_ps(_mm_mul_ps(texelArea, _mm_loadu_ps(valid)), _mm_mul_ps(inverseLength, _mm_mul_ps(inverseLength, inverseLength)));
+
+			__m128 basisValues[9] = {
+				_mm_set1_ps(0.282095f),
+				_mm_mul_ps(_mm_set1_ps(0.488603f), ny),
+				_mm_mul_ps(_mm_set1_ps(0.488603f), nz),
+				_mm_mul_ps(_mm_set1_ps(0.488603f), nx),
+				_mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(nx, ny)),
+				_mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(ny, nz)),
+				_mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(nz, nz)), one)),
+				_mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(nx, nz)),
+				_mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny))),
+			};
+
+			for (int channel = 0; channel < 3; channel++)
+			{
+				__m128 weighted = _mm_mul_ps(weight, _mm_loadu_ps(colors[channel]));
+				for (int k = 0; k < 9; k++)
+					sums[k * 3 + channel] = _mm_add_ps(sums[k * 3 + channel], _mm_mul_ps(basisValues[k], weighted));
+			}
+			sums[27] = _mm_add_ps(sums[27], weight);
+		}
+
+		float* rowSum = rowSums.data() + size_t(row) * 28;
+		for (int i = 0; i < 28; i++)
+		{
+			float lanes[4];
+			_mm_storeu_ps(lanes, sums[i]);
+			rowSum[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		}
+	});
+
+	float totals[28] = {};
+	for (int row = 0; row < rowCount; row++)
+	{
+		for (int i = 0; i < 28; i++)
+			totals[i] += rowSums[size_t(row) * 28 + i];
+	}
+
+	// The texel solid angles are approximate, normalize them to the whole sphere. Then convolve with
+	// the clamped cosine (A_l / pi = 1, 2/3, 1/4 per band) and fold in the basis constants, so the
+	// shader only evaluates the polynomials.
+	const float normalization = 4.0f * glm::pi<float>() / totals[27];
+	const float factors[9] = {
+		0.282095f,
+		0.488603f * 2.0f / 3.0f, 0.488603f * 2.0f / 3.0f, 0.488603f * 2.0f / 3.0f,
+		1.092548f * 0.25f, 1.092548f * 0.25f, 0.315392f * 0.25f, 1.092548f * 0.25f, 0.546274f * 0.25f,
+	};
+	for (int k = 0; k < 9; k++)
+	{
+		glm::vec3 coefficient(totals[k * 3], totals[k * 3 + 1], totals[k * 3 + 2]);
+		m_Block.irradianceSH[k] = glm::vec4(coefficient * normalization * factors[k], 0.0f);
+	}
+}
+
+void ImageBasedLighting::Prefilter(const std::vector<CubeLevel>& sources, ThreadPool& pool)
+{
+	m_Packed.resize(PackedTexelCount(PREFILTERED_SIZE, PREFILTERED_LEVELS));
+
+	// The mirror level copies the source of the same size, or the closest larger one
+	int directLevel = 0;
+	while (directLevel + 1 < int(sources.size()) && sources[directLevel + 1].m_size >= PREFILTERED_SIZE)
+		directLevel++;
+
+	size_t levelOffset = 0;
+	for (int level = 0; level < PREFILTERED_LEVELS; level++)
+	{
+		const int size = std::max(PREFILTERED_SIZE >> level, 1);
+		const float roughness = float(level) / float(PREFILTERED_LEVELS - 1);
+		const SampleSet samples = MakeSampleSet(roughness, sources.front().m_size, int(sources.size()), directLevel);
+		const size_t sampleCount = samples.m_x.size();
+		uint32_t* packed = m_Packed.data() + levelOffset;
+
+		pool.ParallelFor(6 * size, [&](int row)
+		{
+			const FaceBasis& basis = FACES[row / size];
+			const int y = row % size;
+			const float v = (float(y) + 0.5f) * 2.0f / float(size) - 1.0f;
+
+			for (int x = 0; x < size; x++)
+			{
+				const float u = (float(x) + 0.5f) * 2.0f / float(size) - 1.0f;
+				const glm::vec3 normal = glm::normalize(basis.m_major + basis.m_right * u + basis.m_down * v);
+				const glm::vec3 up = std::abs(normal.y) < 0.999f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+				const glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+				const glm::vec3 bitangent = glm::cross(normal, tangent);
+
+				// Samples from tangent space to world space, four per step
+				glm::vec3 color(0.0f);
+				float totalWeight = 0.0f;
+				for (size_t i = 0; i < sampleCount; i += 4)
+				{
+					__m128 sx = _mm_loadu_ps(&samples.m_x[i]);
+					__m128 sy = _mm_loadu_ps(&samples.m_y[i]);
+					__m128 sz = _mm_loadu_ps(&samples.m_z[i]);
+					float directions[3][4];
+					for (int axis = 0; axis < 3; axis++)
+					{
+						__m128 world = _mm_mul_ps(_mm_set1_ps(tangent[axis]), sx);
+						world = _mm_add_ps(world, _mm_mul_ps(_mm_set1_ps(bitangent[axis]), sy));
+						world = _mm_add_ps(world, _mm_mul_ps(_mm_set1_ps(normal[axis]), sz));
+						_mm_storeu_ps(directions[axis], world);
+					}
+
+					for (size_t lane = 0; lane < 4; lane++)
+					{
+						float weight = samples.m_weight[i + lane];
+						if (weight == 0.0f)
+							continue;
+						const CubeLevel& source = sources[samples.m_sourceLevel[i + lane]];
+						glm::vec3 direction(directions[0][lane], directions[1][lane], directions[2][lane]);
+						color += SampleCube(source.m_texels, source.m_size, direction) * weight;
+						totalWeight += weight;
+					}
+				}
+
+				packed[size_t(row) * size + x] = glm::packF2x11_1x10(color / totalWeight);
+			}
+		});
+
+		levelOffset += size_t(size) * size * 6;
+	}
+}
+
+void ImageBasedLighting::Upload()
+{
+	glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &m_Prefiltered);
+	glTextureStorage2D(m_Prefiltered, PREFILTERED_LEVELS, GL_R11F_G11F_B10F, PREFILTERED_SIZE, PREFILTERED_SIZE);
+	GpuMemoryTracker::TrackTexture(m_Prefiltered, m_Packed.size() * sizeof(uint32_t), GpuMemoryCategory::Cubemap, "ImageBasedLighting", "GL_R11F_G11F_B10F");
+
+	size_t offset = 0;
+	for (int level = 0; level < PREFILTERED_LEVELS; level++)
+	{
+		int size = std::max(PREFILTERED_SIZE >> level, 1);
+		glTextureSubImage3D(m_Prefiltered, level, 0, 0, 0, size, size, 6, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, m_Packed.data() + offset);
+		offset += size_t(size) * size * 6;
+	}
+
+	m_Buffer.Upload(m_Block);
+}
+
+glm::vec3 ImageBasedLighting::EvaluateIrradiance(const glm::vec3& n) const
+{
+	const glm::vec4* sh = m_Block.irradianceSH;
+	glm::vec4 result = sh[0]
+		+ sh[1] * n.y + sh[2] * n.z + sh[3] * n.x
+		+ sh[4] * (n.x * n.y) + sh[5] * (n.y * n.z)
+		+ sh[6] * (3.0f * n.z * n.z - 1.0f)
+		+ sh[7] * (n.x * n.z) + sh[8] * (n.x * n.x - n.y * n.y);
+	return glm::vec3(result);
+}
+
+void ImageBasedLighting::Bind() const
+{
+	SamplerDesc sampler;
+	sampler.m_filter = SamplerFilter::Trilinear;
+	sampler.m_wrap = SamplerWrap::ClampToEdge;
+
+	GLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_CUBE_MAP, m_Prefiltered);
+	SamplerCache::Bind(TEXTURE_UNIT, sampler);
+	m_Buffer.Bind(UNIFORM_BINDING);
+}
+
+void ImageBasedLighting::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	bool changed = ImGui::SliderFloat("Diffuse intensity", &m_Block.environmentParams.y, 0.0f, 2.0f);
+	changed |= ImGui::SliderFloat("Specular intensity", &m_Block.environmentParams.z, 0.0f, 2.0f);
+	if (changed)
+		m_Buffer.Upload(m_Block);
+
+	if (m_Baked)
+	{
+		ImGui::Text("Baked in %.1f ms on %u threads", m_LoadMilliseconds, m_ThreadCount);
+		ImGui::Text("  irradiance (SH9) %.1f ms, prefiltering %.1f ms", m_IrradianceMilliseconds, m_PrefilterMilliseconds);
+	}
+	else
+	{
+		ImGui::Text("Loaded from the cache in %.1f ms", m_LoadMilliseconds);
+	}
+	ImGui::Text("%d x %d prefiltered, %d levels, %d GGX samples per texel", PREFILTERED_SIZE, PREFILTERED_SIZE, PREFILTERED_LEVELS, SAMPLE_COUNT);
+	glm::vec3 up = EvaluateIrradiance(glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::vec3 down = EvaluateIrradiance(glm::vec3(0.0f, -1.0f, 0.0f));
+	ImGui::Text("Irradiance / pi from above %.2f %.2f %.2f, below %.2f %.2f %.2f", up.r, up.g, up.b, down.r, down.g, down.b);
+	ImGui::End();
+}
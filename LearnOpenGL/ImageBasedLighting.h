@@ -0,0 +1,77 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "UniformBlocks.h"
+
+class Cubemap;
+class ThreadPool;
+
+// Ambient light baked from the skybox at load time, so shading it costs one SH evaluation and
+// one cubemap lookup per pixel instead of a convolution:
+// - diffuse: the skybox projected onto 9 spherical harmonics coefficients, convolved with the
+//   cosine lobe (irradiance)
+// - specular: a cubemap whose mip levels are the skybox prefiltered with GGX lobes of increasing
+//   roughness, importance sampled from the skybox's own mips (filtered importance sampling)
+//
+// Both bakes run on the CPU on every core, four texels or samples per SSE instruction, from the
+// skybox read back off the GPU. The result is cached next to the cooked cubemap, keyed by the
+// skybox's sources, and only rebaked when they change.
+//
+// The lit shaders read the result through include/ibl.glsl.
+class ImageBasedLighting
+{
+public:
+	static const int PREFILTERED_SIZE = 128;
+	static const int PREFILTERED_LEVELS = 6;	// 128 down to 4, roughness 0 to 1
+	static const int SAMPLE_COUNT = 128;		// GGX samples per texel of the rough levels
+	// Texture unit and uniform block binding include/ibl.glsl expects
+	static const unsigned int TEXTURE_UNIT = 10;
+	static const unsigned int UNIFORM_BINDING = 5;
+
+	ImageBasedLighting(const Cubemap& skybox, const std::string& cachePath);
+	~ImageBasedLighting();
+
+	ImageBasedLighting(const ImageBasedLighting&) = delete;
+	ImageBasedLighting& operator=(const ImageBasedLighting&) = delete;
+
+	// Binds the prefiltered cubemap and the Environment block for the lit programs
+	void Bind() const;
+	void DrawImGui(const char* title);
+
+	const EnvironmentBlock& GetBlock() const { return m_Block; }
+	// What CalcIrradiance() in include/ibl.glsl returns for this normal
+	glm::vec3 EvaluateIrradiance(const glm::vec3& n) const;
+
+private:
+	// One mip level of a cubemap on the CPU, six faces of linear RGB
+	struct CubeLevel
+	{
+		int m_size;
+		std::vector<float> m_texels;
+	};
+
+	bool LoadCache(const std::string& cachePath, uint64_t key);
+	void SaveCache(const std::string& cachePath, uint64_t key) const;
+	bool Bake(const Cubemap& skybox);
+	void ProjectIrradiance(const CubeLevel& source, ThreadPool& pool);
+	void Prefilter(const std::vector<CubeLevel>& sources, ThreadPool& pool);
+	void Upload();
+
+private:
+	unsigned int m_Prefiltered;
+	// Every prefiltered level packed as R11G11B10F, level-major and face-minor like the cooked cubemap
+	std::vector<uint32_t> m_Packed;
+
+	EnvironmentBlock m_Block;
+	UniformBuffer<EnvironmentBlock> m_Buffer;
+
+	bool m_Baked;				// false when the cache was used
+	float m_LoadMilliseconds;
+	float m_IrradianceMilliseconds;
+	float m_PrefilterMilliseconds;
+	unsigned int m_ThreadCount;
+};
@@ -0,0 +1,171 @@
+#include "InstanceBuffer.h"
+
+#include "deps/imgui/imgui.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "TransformBatch.h"
+#include "helpers/Logger.h"
+
+namespace
+{
+	// Long enough that a wait only times out on a lost GPU
+	const GLuint64 FENCE_TIMEOUT_NANOSECONDS = 1000000000;
+}
+
+InstanceBuffer::InstanceBuffer(int capacity, const std::string& name)
+	: m_Buffer(0)
+	, m_Capacity(capacity)
+	, m_RegionSize(0)
+	, m_Mapped(nullptr)
+	, m_Region(FRAME_COUNT - 1)
+	, m_Count(0)
+	, m_Name(name)
+	, m_OverflowLogged(false)
+	, m_WaitMicroseconds(0.0f)
+	, m_WriteMicroseconds(0.0f)
+{
+	for (GLsync& fence : m_Fences)
+		fence = nullptr;
+
+	// Every region has to start at an offset glBindBufferRange accepts
+	GLint alignment = 256;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	GLsizeiptr bytes = GLsizeiptr(capacity) * sizeof(InstanceData);
+	m_RegionSize = (bytes + alignment - 1) / alignment * alignment;
+
+	// Coherent, so written instances are visible to the next draw without a flush
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &m_Buffer);
+	glNamedBufferStorage(m_Buffer, m_RegionSize * FRAME_COUNT, nullptr, flags);
+	m_Mapped = static_cast<InstanceData*>(glMapNamedBufferRange(m_Buffer, 0, m_RegionSize * FRAME_COUNT, flags));
+	if (!m_Mapped)
+	{
+		Logger::LogError("InstanceBuffer " + m_Name + ": could not map the instance buffer");
+		m_Capacity = 0;
+	}
+	GpuMemoryTracker::TrackBuffer(m_Buffer, m_RegionSize * FRAME_COUNT, GpuMemoryCategory::StorageBuffer, "InstanceBuffer " + m_Name, "Instance");
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	for (GLsync fence : m_Fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+	}
+	if (m_Mapped)
+		glUnmapNamedBuffer(m_Buffer);
+	glDeleteBuffers(1, &m_Buffer);
+	GpuMemoryTracker::UntrackBuffer(m_Buffer);
+	GLState::Invalidate();
+}
+
+void InstanceBuffer::Begin()
+{
+	m_Region = (m_Region + 1) % FRAME_COUNT;
+	m_Count = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	GLsync& fence = m_Fences[m_Region];
+	if (fence)
+	{
+		// Flush on the first try, so the fence cannot wait on commands that were never submitted
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NANOSECONDS);
+		if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+			Logger::LogWarning("InstanceBuffer " + m_Name + ": the GPU did not release a region in time");
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	m_WriteStart = std::chrono::high_resolution_clock::now();
+	m_WaitMicroseconds = std::chrono::duration<float, std::micro>(m_WriteStart - start).count();
+}
+
+int InstanceBuffer::Add(const glm::mat4& model, const glm::vec4& color)
+{
+	if (m_Count >= m_Capacity)
+	{
+		if (!m_OverflowLogged)
+		{
+			Logger::LogWarning("InstanceBuffer " + m_Name + ": more than " + std::to_string(m_Capacity) + " instances, the rest are dropped");
+			m_OverflowLogged = true;
+		}
+		return -1;
+	}
+
+	// Written once and in order, the mapping may be write-combined memory that must not be read
+	InstanceData instance = { model, glm::mat3x4(1.0f), color };
+	ComputeNormalMatrices(&instance, 1);
+	reinterpret_cast<InstanceData*>(reinterpret_cast<char*>(m_Mapped) + m_Region * m_RegionSize)[m_Count] = instance;
+	return m_Count++;
+}
+
+int InstanceBuffer::Add(const InstanceData* instances, int count)
+{
+	int fitting = std::min(count, m_Capacity - m_Count);
+	if (fitting < count && !m_OverflowLogged)
+	{
+		Logger::LogWarning("InstanceBuffer " + m_Name + ": more than " + std::to_string(m_Capacity) + " instances, the rest are dropped");
+		m_OverflowLogged = true;
+	}
+	if (fitting <= 0)
+		return -1;
+
+	int first = m_Count;
+	std::memcpy(reinterpret_cast<InstanceData*>(reinterpret_cast<char*>(m_Mapped) + m_Region * m_RegionSize) + first, instances, fitting * sizeof(InstanceData));
+	m_Count += fitting;
+	return first;
+}
+
+void InstanceBuffer::ComputeNormalMatrices(InstanceData* instances, int count)
+{
+	if (count <= 0)
+		return;
+
+	TransformBatch::ComputeNormalMatrices(&instances[0].m_model, sizeof(InstanceData), &instances[0].m_normalMatrix, sizeof(InstanceData), size_t(count));
+}
+
+void InstanceBuffer::Bind() const
+{
+	if (m_Count == 0)
+		return;
+
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING, m_Buffer, m_Region * m_RegionSize, m_Count * sizeof(InstanceData));
+}
+
+void InstanceBuffer::DrawArrays(unsigned int vertexArray, int vertexCount) const
+{
+	if (m_Count == 0)
+		return;
+
+	GLState::BindVertexArray(vertexArray);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, m_Count);
+}
+
+void InstanceBuffer::DrawElements(unsigned int vertexArray, int indexCount) const
+{
+	if (m_Count == 0)
+		return;
+
+	GLState::BindVertexArray(vertexArray);
+	glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, m_Count);
+}
+
+void InstanceBuffer::End()
+{
+	m_WriteMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - m_WriteStart).count();
+
+	if (m_Count > 0)
+		m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void InstanceBuffer::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	ImGui::Text("%d / %d instances, %d bytes each", m_Count, m_Capacity, int(sizeof(InstanceData)));
+	ImGui::Text("Fence wait %.1f us, write and draw %.1f us", m_WaitMicroseconds, m_WriteMicroseconds);
+	ImGui::End();
+}
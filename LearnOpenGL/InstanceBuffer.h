@@ -0,0 +1,75 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <string>
+
+// std430 Instance in include/instances.glsl
+struct InstanceData
+{
+	glm::mat4 m_model;
+	glm::mat3x4 m_normalMatrix;	// inverse transpose of model, columns padded to vec4
+	glm::vec4 m_color;			// material parameter, the flat color or tint of the instance
+};
+
+// Per-instance data for drawing many copies of one mesh in a single instanced draw call. The
+// instances are written straight into a persistently mapped SSBO, which the instanced shaders
+// (ubo_test_instanced.vs, lit_vertex_instanced.glsl) index with gl_InstanceID.
+//
+// The buffer holds FRAME_COUNT regions used round robin. Each frame writes the next one while
+// the GPU may still be reading the previous ones, and a fence per region makes Begin() wait only
+// when the CPU runs a full FRAME_COUNT frames ahead.
+//
+// Per frame:
+//   Begin(); Add()...; Bind(); one or more DrawArrays()/DrawElements() or Mesh::DrawInstanced(); End();
+class InstanceBuffer
+{
+public:
+	static const int FRAME_COUNT = 3;
+	// Shader storage binding include/instances.glsl expects
+	static const unsigned int STORAGE_BINDING = 4;
+
+	InstanceBuffer(int capacity, const std::string& name);
+	~InstanceBuffer();
+
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	// Moves to the next region, waiting for the GPU to finish with it if needed
+	void Begin();
+	// Returns the instance index, or -1 once the capacity is reached
+	int Add(const glm::mat4& model, const glm::vec4& color);
+	// Copies instances built elsewhere, on another thread for example. Returns the index of the
+	// first one, or -1 if none fit, and drops what does not fit.
+	int Add(const InstanceData* instances, int count);
+	// Fills in the normal matrices of instances whose model is set, four at a time with TransformBatch
+	static void ComputeNormalMatrices(InstanceData* instances, int count);
+	// Binds this frame's instances, call after the last Add()
+	void Bind() const;
+	void DrawArrays(unsigned int vertexArray, int vertexCount) const;
+	void DrawElements(unsigned int vertexArray, int indexCount) const;
+	// Fences the region after its last draw
+	void End();
+
+	void DrawImGui(const char* title);
+
+	int GetCount() const { return m_Count; }
+	int GetCapacity() const { return m_Capacity; }
+
+private:
+	unsigned int m_Buffer;
+	int m_Capacity;
+	GLsizeiptr m_RegionSize;	// capacity rounded up to the storage buffer offset alignment
+	InstanceData* m_Mapped;
+
+	GLsync m_Fences[FRAME_COUNT];
+	int m_Region;
+	int m_Count;
+
+	std::string m_Name;
+	bool m_OverflowLogged;
+	std::chrono::high_resolution_clock::time_point m_WriteStart;
+	float m_WaitMicroseconds;
+	float m_WriteMicroseconds;
+};
@@ -0,0 +1,340 @@
+#include "LightClusters.h"
+
+#include <glad/glad.h>
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+
+namespace
+{
+	// Lights are cut off once they drop below this fraction of their brightest channel
+	const float LIGHT_CUTOFF = 5.0f / 256.0f;
+
+	// std430 ClusteredLight in include/clusters.glsl
+	struct GpuPointLight
+	{
+		glm::vec4 m_positionRadius;
+		glm::vec4 m_ambientConstant;
+		glm::vec4 m_diffuseLinear;
+		glm::vec4 m_specularQuadratic;
+	};
+
+	float MaxComponent(const glm::vec3& v)
+	{
+		return std::max(v.x, std::max(v.y, v.z));
+	}
+}
+
+LightClusters::LightClusters()
+	: m_MaxLightsPerCluster(0)
+	, m_BinMilliseconds(0.0f)
+	, m_FovY(0.0f)
+	, m_Aspect(0.0f)
+	, m_Near(0.0f)
+	, m_Far(0.0f)
+	, m_ScreenWidth(0)
+	, m_ScreenHeight(0)
+	, m_Params()
+	, m_ParamsBuffer("LightClusters")
+	, m_LightBuffer(0)
+	, m_LightCapacity(0)
+	, m_RangeBuffer(0)
+	, m_IndexBuffer(0)
+	, m_IndexCapacity(0)
+{
+	// Built once, so dispatching the bin tasks every frame does not allocate
+	m_BinTask = [this](int slice) { BinSlice(slice); };
+
+	m_Slices.resize(GRID_Z);
+	m_Ranges.resize(CLUSTER_COUNT, glm::uvec2(0));
+
+	glCreateBuffers(1, &m_RangeBuffer);
+	glNamedBufferData(m_RangeBuffer, CLUSTER_COUNT * sizeof(glm::uvec2), m_Ranges.data(), GL_DYNAMIC_DRAW);
+	GpuMemoryTracker::TrackBuffer(m_RangeBuffer, CLUSTER_COUNT * sizeof(glm::uvec2), GpuMemoryCategory::StorageBuffer, "LightClusters ranges", "uvec2");
+
+	// Never leave an SSBO without storage, even with no lights
+	Reserve(m_LightBuffer, m_LightCapacity, sizeof(GpuPointLight), "LightClusters lights", "ClusteredLight");
+	Reserve(m_IndexBuffer, m_IndexCapacity, sizeof(uint32_t), "LightClusters indices", "uint");
+}
+
+LightClusters::~LightClusters()
+{
+	for (unsigned int buffer : { m_LightBuffer, m_RangeBuffer, m_IndexBuffer })
+	{
+		GpuMemoryTracker::UntrackBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+	}
+}
+
+void LightClusters::SetProjection(float fovY, float aspect, float nearPlane, float farPlane, int screenWidth, int screenHeight)
+{
+	if (fovY == m_FovY && aspect == m_Aspect && nearPlane == m_Near && farPlane == m_Far && screenWidth == m_ScreenWidth && screenHeight == m_ScreenHeight)
+		return;
+
+	m_FovY = fovY;
+	m_Aspect = aspect;
+	m_Near = nearPlane;
+	m_Far = farPlane;
+	m_ScreenWidth = std::max(screenWidth, 1);
+	m_ScreenHeight = std::max(screenHeight, 1);
+
+	// Tiles are whole pixels, so the last row and column may stick out past the screen edge
+	int tileWidth = (m_ScreenWidth + GRID_X - 1) / GRID_X;
+	int tileHeight = (m_ScreenHeight + GRID_Y - 1) / GRID_Y;
+
+	// Exponential slices: slice = log(depth) * scale + bias
+	float logRatio = std::log(m_Far / m_Near);
+	m_Params.gridSize = glm::uvec4(GRID_X, GRID_Y, GRID_Z, 0);
+	m_Params.zParams = glm::vec4(GRID_Z / logRatio, -GRID_Z * std::log(m_Near) / logRatio, m_Near, m_Far);
+	m_Params.tileSize = glm::vec4(float(tileWidth), float(tileHeight), 0.0f, 0.0f);
+	m_ParamsBuffer.Upload(m_Params);
+
+	// View-space x and y at depth d are ndc * d * (tanX, tanY)
+	float tanY = std::tan(m_FovY * 0.5f);
+	float tanX = tanY * m_Aspect;
+
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		Slice& slice = m_Slices[z];
+		slice.m_near = m_Near * std::pow(m_Far / m_Near, float(z) / GRID_Z);
+		slice.m_far = m_Near * std::pow(m_Far / m_Near, float(z + 1) / GRID_Z);
+
+		// The tile's frustum widens with depth, so take the extremes of both ends of the slice
+		for (int x = 0; x < GRID_X; x++)
+		{
+			float ndcMinX = std::min(2.0f * x * tileWidth / m_ScreenWidth - 1.0f, 1.0f);
+			float ndcMaxX = std::min(2.0f * (x + 1) * tileWidth / m_ScreenWidth - 1.0f, 1.0f);
+			slice.m_minX[x] = std::min(ndcMinX * tanX * slice.m_near, ndcMinX * tanX * slice.m_far);
+			slice.m_maxX[x] = std::max(ndcMaxX * tanX * slice.m_near, ndcMaxX * tanX * slice.m_far);
+		}
+		for (int y = 0; y < GRID_Y; y++)
+		{
+			float ndcMinY = std::min(2.0f * y * tileHeight / m_ScreenHeight - 1.0f, 1.0f);
+			float ndcMaxY = std::min(2.0f * (y + 1) * tileHeight / m_ScreenHeight - 1.0f, 1.0f);
+			slice.m_minY[y] = std::min(ndcMinY * tanY * slice.m_near, ndcMinY * tanY * slice.m_far);
+			slice.m_maxY[y] = std::max(ndcMaxY * tanY * slice.m_near, ndcMaxY * tanY * slice.m_far);
+		}
+	}
+}
+
+void LightClusters::SetLights(const std::vector<PointLight>& lights)
+{
+	m_Lights = lights;
+
+	m_Radii.resize(m_Lights.size());
+	std::vector<GpuPointLight> gpuLights(m_Lights.size());
+	for (size_t i = 0; i < m_Lights.size(); i++)
+	{
+		const PointLight& light = m_Lights[i];
+		m_Radii[i] = GetLightRadius(light);
+		gpuLights[i] = {
+			glm::vec4(light.m_position, m_Radii[i]),
+			glm::vec4(light.m_ambient, light.m_constant),
+			glm::vec4(light.m_diffuse, light.m_linear),
+			glm::vec4(light.m_specular, light.m_quadratic)
+		};
+	}
+
+	Reserve(m_LightBuffer, m_LightCapacity, gpuLights.size() * sizeof(GpuPointLight), "LightClusters lights", "ClusteredLight");
+	if (!gpuLights.empty())
+		glNamedBufferSubData(m_LightBuffer, 0, gpuLights.size() * sizeof(GpuPointLight), gpuLights.data());
+}
+
+void LightClusters::Bin(const glm::mat4& view)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_ViewX.resize(m_Lights.size());
+	m_ViewY.resize(m_Lights.size());
+	m_ViewDepth.resize(m_Lights.size());
+	for (size_t i = 0; i < m_Lights.size(); i++)
+	{
+		glm::vec4 position = view * glm::vec4(m_Lights[i].m_position, 1.0f);
+		m_ViewX[i] = position.x;
+		m_ViewY[i] = position.y;
+		m_ViewDepth[i] = -position.z;
+	}
+
+	m_Pool.ParallelFor(GRID_Z, m_BinTask);
+
+	// Stitch the per slice lists together, their offsets were relative to the slice
+	m_Indices.clear();
+	m_MaxLightsPerCluster = 0;
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		uint32_t base = static_cast<uint32_t>(m_Indices.size());
+		const Slice& slice = m_Slices[z];
+		m_Indices.insert(m_Indices.end(), slice.m_indices.begin(), slice.m_indices.end());
+
+		for (int tile = 0; tile < TILES_PER_SLICE; tile++)
+		{
+			glm::uvec2& range = m_Ranges[z * TILES_PER_SLICE + tile];
+			range.x += base;
+			m_MaxLightsPerCluster = std::max(m_MaxLightsPerCluster, static_cast<int>(range.y));
+		}
+	}
+
+	m_BinMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::Update(const glm::mat4& view)
+{
+	Bin(view);
+	Upload();
+}
+
+void LightClusters::Bind() const
+{
+	m_ParamsBuffer.Bind(1);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, m_LightBuffer);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, m_RangeBuffer);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, m_IndexBuffer);
+}
+
+float LightClusters::GetLightRadius(const PointLight& light)
+{
+	float brightness = std::max(MaxComponent(light.m_diffuse), std::max(MaxComponent(light.m_specular), MaxComponent(light.m_ambient)));
+	if (brightness <= 0.0f)
+		return 0.0f;
+
+	// Solve constant + linear * d + quadratic * d^2 = brightness / cutoff
+	float target = brightness / LIGHT_CUTOFF;
+	if (light.m_quadratic > 0.0f)
+	{
+		float discriminant = light.m_linear * light.m_linear - 4.0f * light.m_quadratic * (light.m_constant - target);
+		return (-light.m_linear + std::sqrt(std::max(discriminant, 0.0f))) / (2.0f * light.m_quadratic);
+	}
+	if (light.m_linear > 0.0f)
+		return std::max(target - light.m_constant, 0.0f) / light.m_linear;
+
+	// Never fades, reaches every cluster
+	return 1e30f;
+}
+
+void LightClusters::BinSlice(int z)
+{
+	Slice& slice = m_Slices[z];
+	slice.m_lightX.clear();
+	slice.m_lightY.clear();
+	slice.m_lightRadiusSq.clear();
+	slice.m_lightIds.clear();
+	slice.m_indices.clear();
+
+	// Depth is the same for every tile in the slice, so it is folded into the radius up front
+	for (size_t i = 0; i < m_Lights.size(); i++)
+	{
+		float depth = m_ViewDepth[i];
+		float dz = std::max(std::max(slice.m_near - depth, depth - slice.m_far), 0.0f);
+		float radiusSq = m_Radii[i] * m_Radii[i] - dz * dz;
+		if (radiusSq < 0.0f)
+			continue;
+
+		slice.m_lightX.push_back(m_ViewX[i]);
+		slice.m_lightY.push_back(m_ViewY[i]);
+		slice.m_lightRadiusSq.push_back(radiusSq);
+		slice.m_lightIds.push_back(static_cast<uint32_t>(i));
+	}
+
+	// Padding never passes the test below
+	while (slice.m_lightIds.size() % 4 != 0)
+	{
+		slice.m_lightX.push_back(0.0f);
+		slice.m_lightY.push_back(0.0f);
+		slice.m_lightRadiusSq.push_back(-1.0f);
+		slice.m_lightIds.push_back(0);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (int y = 0; y < GRID_Y; y++)
+	{
+		// Same trick for the row: fold the y distance into the radius and keep the lights that survive
+		const __m128 minY = _mm_set1_ps(slice.m_minY[y]);
+		const __m128 maxY = _mm_set1_ps(slice.m_maxY[y]);
+		slice.m_rowX.clear();
+		slice.m_rowRadiusSq.clear();
+		slice.m_rowIds.clear();
+		for (size_t i = 0; i < slice.m_lightIds.size(); i += 4)
+		{
+			__m128 lightY = _mm_loadu_ps(&slice.m_lightY[i]);
+			__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, lightY), _mm_sub_ps(lightY, maxY)), zero);
+			__m128 radiusSq = _mm_sub_ps(_mm_loadu_ps(&slice.m_lightRadiusSq[i]), _mm_mul_ps(dy, dy));
+
+			float remaining[4];
+			_mm_storeu_ps(remaining, radiusSq);
+			int mask = _mm_movemask_ps(_mm_cmpge_ps(radiusSq, zero));
+			for (int lane = 0; mask != 0; lane++, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					slice.m_rowX.push_back(slice.m_lightX[i + lane]);
+					slice.m_rowRadiusSq.push_back(remaining[lane]);
+					slice.m_rowIds.push_back(slice.m_lightIds[i + lane]);
+				}
+			}
+		}
+		while (slice.m_rowIds.size() % 4 != 0)
+		{
+			slice.m_rowX.push_back(0.0f);
+			slice.m_rowRadiusSq.push_back(-1.0f);
+			slice.m_rowIds.push_back(0);
+		}
+
+		for (int x = 0; x < GRID_X; x++)
+		{
+			const __m128 minX = _mm_set1_ps(slice.m_minX[x]);
+			const __m128 maxX = _mm_set1_ps(slice.m_maxX[x]);
+
+			uint32_t first = static_cast<uint32_t>(slice.m_indices.size());
+			for (size_t i = 0; i < slice.m_rowIds.size(); i += 4)
+			{
+				// What is left of the squared distance from each sphere centre to the froxel's box
+				__m128 lightX = _mm_loadu_ps(&slice.m_rowX[i]);
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, lightX), _mm_sub_ps(lightX, maxX)), zero);
+
+				int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(dx, dx), _mm_loadu_ps(&slice.m_rowRadiusSq[i])));
+				for (int lane = 0; mask != 0; lane++, mask >>= 1)
+				{
+					if (mask & 1)
+						slice.m_indices.push_back(slice.m_rowIds[i + lane]);
+				}
+			}
+
+			m_Ranges[z * TILES_PER_SLICE + y * GRID_X + x] = glm::uvec2(first, static_cast<uint32_t>(slice.m_indices.size()) - first);
+		}
+	}
+}
+
+void LightClusters::Upload()
+{
+	glNamedBufferSubData(m_RangeBuffer, 0, m_Ranges.size() * sizeof(glm::uvec2), m_Ranges.data());
+
+	Reserve(m_IndexBuffer, m_IndexCapacity, m_Indices.size() * sizeof(uint32_t), "LightClusters indices", "uint");
+	if (!m_Indices.empty())
+		glNamedBufferSubData(m_IndexBuffer, 0, m_Indices.size() * sizeof(uint32_t), m_Indices.data());
+}
+
+void LightClusters::Reserve(unsigned int& buffer, size_t& capacity, size_t bytes, const char* owner, const char* format)
+{
+	if (buffer != 0 && bytes <= capacity)
+		return;
+
+	// Grow geometrically so a slowly rising light count does not reallocate every frame
+	size_t newCapacity = std::max(bytes, capacity * 2);
+	if (buffer != 0)
+	{
+		GpuMemoryTracker::UntrackBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+		// Deleting unbinds it, and the new buffer may get the same name back
+		GLState::Invalidate();
+	}
+
+	glCreateBuffers(1, &buffer);
+	glNamedBufferData(buffer, newCapacity, nullptr, GL_DYNAMIC_DRAW);
+	GpuMemoryTracker::TrackBuffer(buffer, newCapacity, GpuMemoryCategory::StorageBuffer, owner, format);
+	capacity = newCapacity;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "UniformBlocks.h"
+#include "helpers/ThreadPool.h"
+
+// A point light with the same Phong terms as PointLight in lighting.glsl
+struct PointLight
+{
+	glm::vec3 m_position;
+	glm::vec3 m_ambient;
+	glm::vec3 m_diffuse;
+	glm::vec3 m_specular;
+	float m_constant;
+	float m_linear;
+	float m_quadratic;
+};
+
+// Clustered forward lighting: the view frustum is cut into a grid of froxels (screen tiles
+// times exponential depth slices) and every point light is binned into the froxels its sphere
+// of influence touches. The lit shader then only loops over the lights of its own froxel
+// (see include/clusters.glsl) instead of every light in the scene.
+//
+// Binning runs on the CPU, one depth slice per task on a ThreadPool. Lights are narrowed down per
+// slice, then per tile row, then tested four at a time against each froxel's bounding box with SSE.
+// The results go to the GPU in SSBOs:
+//   binding 1: every light, std430 ClusteredLight
+//   binding 2: per froxel (offset, count) into the index list
+//   binding 3: the light index list
+class LightClusters
+{
+public:
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int TILES_PER_SLICE = GRID_X * GRID_Y;
+	static const int CLUSTER_COUNT = TILES_PER_SLICE * GRID_Z;
+
+	LightClusters();
+	~LightClusters();
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// Rebuilds the froxel bounds, cheap to call every frame when nothing changed
+	void SetProjection(float fovY, float aspect, float nearPlane, float farPlane, int screenWidth, int screenHeight);
+	// Uploads the lights and works out their radius of influence
+	void SetLights(const std::vector<PointLight>& lights);
+	// Bins the lights for this view (CPU only)
+	void Bin(const glm::mat4& view);
+	// Bin() plus uploading the froxel light lists
+	void Update(const glm::mat4& view);
+	// Binds the ClusterParams block and the three SSBOs at the points include/clusters.glsl expects
+	void Bind() const;
+
+	size_t GetLightCount() const { return m_Lights.size(); }
+	size_t GetIndexCount() const { return m_Indices.size(); }
+	int GetMaxLightsPerCluster() const { return m_MaxLightsPerCluster; }
+	float GetBinMilliseconds() const { return m_BinMilliseconds; }
+	unsigned int GetWorkerCount() const { return m_Pool.GetThreadCount() + 1; }
+
+	// Distance at which the light falls below 5/256 of its brightest channel
+	static float GetLightRadius(const PointLight& light);
+
+private:
+	void BinSlice(int slice);
+	void Upload();
+
+	// Grows a buffer to hold at least `bytes`, keeping it tracked
+	static void Reserve(unsigned int& buffer, size_t& capacity, size_t bytes, const char* owner, const char* format);
+
+private:
+	// Per slice scratch, written by exactly one task per frame
+	struct Slice
+	{
+		float m_near;
+		float m_far;
+		// View-space bounds of each tile column and row across the slice's depth range
+		float m_minX[GRID_X];
+		float m_maxX[GRID_X];
+		float m_minY[GRID_Y];
+		float m_maxY[GRID_Y];
+
+		// Lights overlapping the slice's depth range: view-space xy and the squared radius left
+		// after the depth distance, padded to a multiple of four
+		std::vector<float> m_lightX;
+		std::vector<float> m_lightY;
+		std::vector<float> m_lightRadiusSq;
+		std::vector<uint32_t> m_lightIds;
+
+		// The same for the lights that also overlap the current tile row
+		std::vector<float> m_rowX;
+		std::vector<float> m_rowRadiusSq;
+		std::vector<uint32_t> m_rowIds;
+
+		std::vector<uint32_t> m_indices;
+	};
+
+	ThreadPool m_Pool;
+	std::function<void(int)> m_BinTask;
+
+	std::vector<PointLight> m_Lights;
+	std::vector<float> m_Radii;
+
+	// View-space lights, rebuilt by Bin()
+	std::vector<float> m_ViewX;
+	std::vector<float> m_ViewY;
+	std::vector<float> m_ViewDepth;
+
+	std::vector<Slice> m_Slices;
+	std::vector<glm::uvec2> m_Ranges;
+	std::vector<uint32_t> m_Indices;
+	int m_MaxLightsPerCluster;
+	float m_BinMilliseconds;
+
+	// Projection the slices were built for
+	float m_FovY;
+	float m_Aspect;
+	float m_Near;
+	float m_Far;
+	int m_ScreenWidth;
+	int m_ScreenHeight;
+
+	ClusterParamsBlock m_Params;
+	UniformBuffer<ClusterParamsBlock> m_ParamsBuffer;
+
+	unsigned int m_LightBuffer;
+	size_t m_LightCapacity;
+	unsigned int m_RangeBuffer;
+	unsigned int m_IndexBuffer;
+	size_t m_IndexCapacity;
+};
@@ -0,0 +1,104 @@
+#include "LightingFeatures.h"
+
+#include <algorithm>
+
+namespace
+{
+	const uint32_t POINT_LIGHT_MASK = 0x7;
+	const uint32_t DIR_LIGHT_BIT = 1 << 3;
+	const uint32_t SPOT_LIGHT_BIT = 1 << 4;
+	const uint32_t SPECULAR_MAP_BIT = 1 << 5;
+	const uint32_t CLUSTERED_BIT = 1 << 6;
+	const uint32_t DIR_SHADOWS_BIT = 1 << 7;
+	const uint32_t LOCAL_SHADOWS_BIT = 1 << 8;
+	const uint32_t IBL_BIT = 1 << 9;
+
+	// Local shadows only apply to the fixed point light array and the spotlight
+	bool HasLocalLights(uint32_t key)
+	{
+		return (key & SPOT_LIGHT_BIT) != 0 || ((key & CLUSTERED_BIT) == 0 && (key & POINT_LIGHT_MASK) != 0);
+	}
+}
+
+uint32_t LightingFeatures::GetKey() const
+{
+	uint32_t key = m_clustered ? CLUSTERED_BIT : uint32_t(std::clamp(m_pointLights, 0, MAX_POINT_LIGHTS));
+	if (m_dirLight)
+		key |= m_dirShadows ? DIR_LIGHT_BIT | DIR_SHADOWS_BIT : DIR_LIGHT_BIT;
+	if (m_spotLight)
+		key |= SPOT_LIGHT_BIT;
+	if (m_specularMap)
+		key |= SPECULAR_MAP_BIT;
+	if (m_localShadows && HasLocalLights(key))
+		key |= LOCAL_SHADOWS_BIT;
+	if (m_imageBasedLighting)
+		key |= IBL_BIT;
+	return key;
+}
+
+LightingFeatures LightingFeatures::FromKey(uint32_t key)
+{
+	LightingFeatures features;
+	features.m_pointLights = int(key & POINT_LIGHT_MASK);
+	features.m_dirLight = (key & DIR_LIGHT_BIT) != 0;
+	features.m_spotLight = (key & SPOT_LIGHT_BIT) != 0;
+	features.m_specularMap = (key & SPECULAR_MAP_BIT) != 0;
+	features.m_clustered = (key & CLUSTERED_BIT) != 0;
+	features.m_dirShadows = (key & DIR_SHADOWS_BIT) != 0;
+	features.m_localShadows = (key & LOCAL_SHADOWS_BIT) != 0;
+	features.m_imageBasedLighting = (key & IBL_BIT) != 0;
+	return features;
+}
+
+std::vector<std::string> LightingFeatures::GetDefines(uint32_t key)
+{
+	LightingFeatures features = FromKey(key);
+
+	std::vector<std::string> defines;
+	defines.push_back("NR_POINT_LIGHTS " + std::to_string(features.m_pointLights));
+	if (features.m_dirLight)
+		defines.push_back("HAS_DIR_LIGHT");
+	if (features.m_dirShadows)
+		defines.push_back("HAS_DIR_SHADOWS");
+	if (features.m_localShadows)
+		defines.push_back("HAS_LOCAL_SHADOWS");
+	if (features.m_spotLight)
+		defines.push_back("HAS_SPOT_LIGHT");
+	if (features.m_specularMap)
+		defines.push_back("HAS_SPECULAR_MAP");
+	if (features.m_clustered)
+		defines.push_back("HAS_CLUSTERED_LIGHTS");
+	if (features.m_imageBasedLighting)
+		defines.push_back("HAS_IBL");
+	return defines;
+}
+
+std::vector<uint32_t> LightingFeatures::GetAllKeys(bool imageBasedLighting)
+{
+	// Every combination of the light bits, plus the shadowed twins of each one whose lights can cast
+	const uint32_t ibl = imageBasedLighting ? IBL_BIT : 0u;
+	std::vector<uint32_t> lightKeys;
+	for (int pointLights = 0; pointLights <= MAX_POINT_LIGHTS; pointLights++)
+	{
+		lightKeys.push_back(uint32_t(pointLights));
+	}
+	lightKeys.push_back(CLUSTERED_BIT);
+
+	std::vector<uint32_t> keys;
+	for (uint32_t lights : lightKeys)
+	{
+		for (uint32_t flags = 0; flags < 8; flags++)
+		{
+			uint32_t key = lights | (flags << 3);
+			for (uint32_t dirShadows : { 0u, DIR_SHADOWS_BIT })
+			{
+				if (dirShadows && !(key & DIR_LIGHT_BIT))
+					continue;
+				keys.push_back(key | dirShadows | ibl);
+				if (HasLocalLights(key))
+					keys.push_back(key | dirShadows | LOCAL_SHADOWS_BIT | ibl);
+			}
+		}
+	}
+	return keys;
+}
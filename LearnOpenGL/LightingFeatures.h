@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The parts of lit_fragment.glsl that are compiled in or out. Packed into a permutation key:
+// bits 0-2 point light count, bit 3 directional light, bit 4 spotlight, bit 5 specular map,
+// bit 6 clustered point lights (which replace the fixed point light array, so its count is 0),
+// bit 7 cascaded shadows of the directional light (only set together with bit 3),
+// bit 8 atlas shadows of the point lights and the spotlight (only set when one of them is drawn),
+// bit 9 image based ambient light from the skybox.
+struct LightingFeatures
+{
+	static const int MAX_POINT_LIGHTS = 4;
+
+	int m_pointLights = MAX_POINT_LIGHTS;
+	bool m_dirLight = true;
+	bool m_spotLight = false;
+	bool m_specularMap = true;
+	bool m_clustered = false;
+	bool m_dirShadows = true;
+	bool m_localShadows = true;
+	bool m_imageBasedLighting = false;
+
+	uint32_t GetKey() const;
+	static LightingFeatures FromKey(uint32_t key);
+
+	// Defines passed to Shader for the permutation with this key
+	static std::vector<std::string> GetDefines(uint32_t key);
+	// Every valid key with or without the image based ambient, for compiling permutations up front
+	static std::vector<uint32_t> GetAllKeys(bool imageBasedLighting);
+};
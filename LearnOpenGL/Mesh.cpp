@@ -1,31 +1,62 @@
 ﻿#include "Mesh.h"
 
+#include "AssetCache.h"
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "SamplerCache.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "helpers/Hash.h"
 #include <glad/glad.h>
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned> indices, std::vector<Texture> textures)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned> indices, std::vector<Texture> textures, const std::string& name)
+	: m_Name(name)
+	, m_HasSpecularMap(false)
 {
 	m_Vertices = vertices;
 	m_Indices = indices;
 	m_Textures = textures;
 
+	for (const Texture& texture : m_Textures)
+	{
+		// Packed textures are keyed "diffuse|specular", with an empty specular part when there is none
+		if (texture.m_type == "texture_specular")
+			m_HasSpecularMap = true;
+		else if (texture.m_type == "texture_diffuse_specular" && texture.m_path.find('|') + 1 < texture.m_path.size())
+			m_HasSpecularMap = true;
+	}
+
+	SetupSamplerNames();
 	SetupMesh();
 }
 
 void Mesh::SetupMesh()
 {
+	// Meshes with identical vertex and index data (e.g. mirrored parts) share their buffers
+	size_t vertexBytes = m_Vertices.size() * sizeof(Vertex);
+	size_t indexBytes = m_Indices.size() * sizeof(unsigned int);
+	uint64_t hash = HashBytes(m_Indices.data(), indexBytes, HashBytes(m_Vertices.data(), vertexBytes));
+
+	AssetCache::MeshBuffers buffers;
+	if (AssetCache::FindMesh(hash, vertexBytes + indexBytes, buffers))
+	{
+		VAO = buffers.m_VAO;
+		VBO = buffers.m_VBO;
+		EBO = buffers.m_EBO;
+		return;
+	}
+
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
 	glGenBuffers(1, &EBO);
 
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
 
-	glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), &m_Vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, &m_Vertices[0], GL_STATIC_DRAW);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), &m_Indices[0], GL_STATIC_DRAW);
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, &m_Indices[0], GL_STATIC_DRAW);
 
 	// vertex positions
 	glEnableVertexAttribArray(0);
@@ -37,31 +68,53 @@ void Mesh::SetupMesh()
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_texCoords));
 
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
+
+	GpuMemoryTracker::TrackBuffer(VBO, vertexBytes, GpuMemoryCategory::VertexBuffer, m_Name, "Mesh::Vertex");
+	GpuMemoryTracker::TrackBuffer(EBO, indexBytes, GpuMemoryCategory::IndexBuffer, m_Name, "GL_UNSIGNED_INT");
+
+	AssetCache::AddMesh(hash, { VAO, VBO, EBO }, vertexBytes + indexBytes);
 }
 
-void Mesh::Draw(Shader shader)
+void Mesh::SetupSamplerNames()
 {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
-	for (unsigned int i = 0; i < m_Textures.size(); i++)
+	for (const Texture& texture : m_Textures)
 	{
-		glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
 		// retrieve texture number
 		std::string number;
-		std::string name = m_Textures[i].m_type;
-		if (name == "texture_diffuse")
+		std::string name = texture.m_type;
+		if (name == "texture_diffuse_specular")
+			name = "diffuseSpecular"; // packed RGB diffuse + A specular, see PackedTextureFromFiles
+		else if (name == "texture_diffuse")
 			number = std::to_string(diffuseNr++);
 		else if (name == "texture_specular")
 			number = std::to_string(specularNr++);
 
-		shader.SetFloat(("material." + name + number).c_str(), i);
-		glBindTexture(GL_TEXTURE_2D, m_Textures[i].m_id);
+		m_SamplerNames.push_back("material." + name + number);
 	}
-	glActiveTexture(GL_TEXTURE0);
+}
 
-	// draw mesh
-	glBindVertexArray(VAO);
+void Mesh::Draw(const Shader& shader)
+{
+	// the bindings are left in place for the next draw to reuse
+	BindMaterial(shader);
+	DrawDepth();
+}
+
+void Mesh::BindMaterial(const Shader& shader) const
+{
+	for (unsigned int i = 0; i < m_Textures.size(); i++)
+	{
+		shader.SetInt(m_SamplerNames[i], i);
+		GLState::BindTexture(i, GL_TEXTURE_2D, m_Textures[i].m_id);
+		SamplerCache::Bind(i, SamplerDesc());
+	}
+}
+
+void Mesh::DrawDepth() const
+{
+	GLState::BindVertexArray(VAO);
 	glDrawElements(GL_TRIANGLES, m_Indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 }
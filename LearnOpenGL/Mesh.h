@@ -25,18 +25,35 @@ public:
 	};
 	
 public:
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, const std::string& name = "Mesh");
 
-	void Draw(Shader shader);
+	void Draw(const Shader& shader);
+	// Geometry only, for depth passes that do not read the material
+	void DrawDepth() const;
+	// Points the shader's material samplers at this mesh's textures and binds them
+	void BindMaterial(const Shader& shader) const;
+
+	// Meshes sharing their first texture share a material, for sorting draws
+	unsigned int GetMaterialId() const { return m_Textures.empty() ? 0 : m_Textures[0].m_id; }
+	unsigned int GetVertexArray() const { return VAO; }
+	int GetIndexCount() const { return int(m_Indices.size()); }
+
+	// Meshes without one get the cheaper no-specular lighting permutation
+	bool HasSpecularMap() const { return m_HasSpecularMap; }
 
 private:
 	void SetupMesh();
+	void SetupSamplerNames();
 	
 private:
 	// Mesh data
 	std::vector<Vertex> m_Vertices;
 	std::vector<unsigned int> m_Indices;
 	std::vector<Texture> m_Textures;
+	// "material.<name>" for every texture, built once so drawing does not allocate
+	std::vector<std::string> m_SamplerNames;
+	std::string m_Name;
+	bool m_HasSpecularMap;
 
 	// Render data
 	unsigned int VAO, VBO, EBO;
@@ -3,46 +3,74 @@
 #include <glad/glad.h>
 #include "stb_image.h"
 
+#include "AssetCache.h"
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "InstanceBuffer.h"
+#include "RenderQueue.h"
 #include "Shader.h"
+#include "ShaderPermutations.h"
+#include "helpers/Hash.h"
 #include "helpers/Logger.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
-unsigned int TextureFromFile(const std::string& path, const std::string& directory, bool gamma)
-{
-	std::string filename = directory + '/' + path;
+#include <algorithm>
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+namespace
+{
+	unsigned int UploadTexture(const unsigned char* data, int width, int height, int nrComponents, const std::string& owner)
 	{
+		// Identical pixels exported under a different name share the already uploaded texture
+		unsigned int textureID = 0;
+		size_t size = size_t(width) * height * nrComponents;
+		uint64_t hash = HashBytes(data, size, (uint64_t(width) << 32) | (uint64_t(height) << 8) | nrComponents);
+		if (AssetCache::FindTexture(hash, size, textureID))
+			return textureID;
+
 		GLenum format;
+		const char* formatName;
 		if (nrComponents == 1)
 		{
 			format = GL_RED;
+			formatName = "GL_R8";
 		}
 		else if (nrComponents == 3)
 		{
 			format = GL_RGB;
+			formatName = "GL_RGB8";
 		}
-		else if (nrComponents == 4)
+		else
 		{
 			format = GL_RGBA;
+			formatName = "GL_RGBA8";
 		}
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		glGenTextures(1, &textureID);
+		GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		size_t gpuBytes = GpuMemoryTracker::TextureBytes(width, height, 1, nrComponents, GpuMemoryTracker::MipLevels(width, height));
+		GpuMemoryTracker::TrackTexture(textureID, gpuBytes, GpuMemoryCategory::Texture, owner, formatName);
 
+		AssetCache::AddTexture(hash, textureID, size);
+		return textureID;
+	}
+}
+
+unsigned int TextureFromFile(const std::string& path, const std::string& directory, bool gamma)
+{
+	std::string filename = directory + '/' + path;
+
+	unsigned int textureID = 0;
+
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+	if (data)
+	{
+		textureID = UploadTexture(data, width, height, nrComponents, filename);
 	}
 	else
 	{
@@ -55,12 +83,64 @@ unsigned int TextureFromFile(const std::string& path, const std::string& directo
 	return textureID;
 }
 
+unsigned int PackedTextureFromFiles(const std::string& diffusePath, const std::string& specularPath, const std::string& directory)
+{
+	std::string diffuseFile = directory + '/' + diffusePath;
+
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(diffuseFile.c_str(), &width, &height, &nrComponents, 4);
+	if (!data)
+	{
+		std::stringstream ss;
+		ss << "Texture failed to load at path: " << diffusePath;
+		Logger::LogError(ss.str());
+		return 0;
+	}
+
+	// The specular map is only used as a mask, so its intensity is all we keep
+	int specWidth = 0, specHeight = 0;
+	unsigned char* specular = nullptr;
+	if (!specularPath.empty())
+	{
+		std::string specularFile = directory + '/' + specularPath;
+		specular = stbi_load(specularFile.c_str(), &specWidth, &specHeight, &nrComponents, 1);
+		if (!specular)
+		{
+			std::stringstream ss;
+			ss << "Texture failed to load at path: " << specularPath;
+			Logger::LogError(ss.str());
+		}
+	}
+
+	// RGB = diffuse, A = specular intensity (nearest-resampled if the sizes differ)
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char mask = 0;
+			if (specular)
+			{
+				int sx = x * specWidth / width;
+				int sy = y * specHeight / height;
+				mask = specular[sy * specWidth + sx];
+			}
+			data[(size_t(y) * width + x) * 4 + 3] = mask;
+		}
+	}
+
+	unsigned int textureID = UploadTexture(data, width, height, 4, diffuseFile + " + " + specularPath);
+
+	stbi_image_free(specular);
+	stbi_image_free(data);
+	return textureID;
+}
+
 Model::Model(const std::string& path)
 {
 	LoadModel(path);
 }
 
-void Model::Draw(Shader shader)
+void Model::Draw(const Shader& shader)
 {
 	for (Mesh& mesh : m_Meshes)
 	{
@@ -68,6 +148,47 @@ void Model::Draw(Shader shader)
 	}
 }
 
+void Model::DrawDepth()
+{
+	for (Mesh& mesh : m_Meshes)
+	{
+		mesh.DrawDepth();
+	}
+}
+
+void Model::Submit(RenderQueue& queue, ShaderPermutations& permutations, LightingFeatures features, const ObjectTransform& transform, const std::function<void(const Shader&)>& setupShader)
+{
+	for (const Mesh& mesh : m_Meshes)
+	{
+		features.m_specularMap = mesh.HasSpecularMap();
+		uint32_t key = features.GetKey();
+
+		// Still compiling, the mesh pops in once it is ready
+		Shader& shader = permutations.Get(key);
+		if (!shader.IsReady())
+			continue;
+
+		RenderItem item = { &shader, &mesh, 0, 0, &transform, &permutations.GetTimer(key), &setupShader };
+		queue.Submit(RenderPass::Opaque, item);
+	}
+}
+
+void Model::DrawInstanced(const InstanceBuffer& instances, ShaderPermutations& permutations, LightingFeatures features, const std::function<void(const Shader&)>& setupShader)
+{
+	for (const Mesh& mesh : m_Meshes)
+	{
+		features.m_specularMap = mesh.HasSpecularMap();
+		Shader& shader = permutations.Get(features.GetKey());
+		if (!shader.IsReady())
+			continue;
+
+		shader.Use();
+		setupShader(shader);
+		mesh.BindMaterial(shader);
+		instances.DrawElements(mesh.GetVertexArray(), mesh.GetIndexCount());
+	}
+}
+
 void Model::LoadModel(const std::string path)
 {
 	Assimp::Importer importer;
@@ -85,6 +206,8 @@ void Model::LoadModel(const std::string path)
 	m_Directory = path.substr(0, path.find_last_of('/'));
 
 	ProcessNode(pScene->mRootNode, pScene);
+
+	AssetCache::LogStats();
 }
 
 void Model::ProcessNode(aiNode* pNode, const aiScene* pScene)
@@ -160,47 +283,45 @@ Mesh Model::ProcessMesh(aiMesh* pMesh, const aiScene* pScene)
 	{
 		aiMaterial* pMaterial = pScene->mMaterials[pMesh->mMaterialIndex];
 
-		std::vector<Mesh::Texture> diffuseMaps = LoadMaterialTextures(pMaterial, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-		std::vector<Mesh::Texture> specularMaps = LoadMaterialTextures(pMaterial, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		// Diffuse and specular are packed into a single RGBA texture at import time
+		Mesh::Texture packed;
+		if (LoadPackedMaterial(pMaterial, packed))
+		{
+			textures.push_back(packed);
+		}
 	}
 
-	return Mesh(vertices, indices, textures);
+	return Mesh(vertices, indices, textures, m_Directory + '/' + pMesh->mName.C_Str());
 }
 
-std::vector<Mesh::Texture> Model::LoadMaterialTextures(aiMaterial* pMaterial, aiTextureType type, const std::string& typeName)
+bool Model::LoadPackedMaterial(aiMaterial* pMaterial, Mesh::Texture& texture)
 {
-	std::vector<Mesh::Texture> textures;
-	for (unsigned int i = 0; i < pMaterial->GetTextureCount(type); i++)
+	if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) == 0)
+		return false;
+
+	aiString diffusePath;
+	pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &diffusePath);
+
+	aiString specularPath;
+	if (pMaterial->GetTextureCount(aiTextureType_SPECULAR) > 0)
 	{
-		aiString string;
-		pMaterial->GetTexture(type, i, &string);
+		pMaterial->GetTexture(aiTextureType_SPECULAR, 0, &specularPath);
+	}
 
-		Logger::Log("Textures:");
-		Logger::Log(string.C_Str());
-		
-		bool skip = false;
-		for (unsigned int j = 0; j < m_TexturesLoaded.size(); j++)
-		{
-			if (std::strcmp(m_TexturesLoaded[j].m_path.data(), string.C_Str()) == 0)
-			{
-				textures.push_back(m_TexturesLoaded[j]);
-				skip = true;
-				break;
-			}
-		}
-		if (!skip)
+	std::string path = std::string(diffusePath.C_Str()) + '|' + specularPath.C_Str();
+	for (const Mesh::Texture& loaded : m_TexturesLoaded)
+	{
+		if (loaded.m_path == path)
 		{
-			// if texture hasn't been loaded already, load it.
-			Mesh::Texture texture;
-			texture.m_id = TextureFromFile(string.C_Str(), m_Directory);
-			texture.m_type = typeName;
-			texture.m_path = string.C_Str();
-			textures.push_back(texture);
+			texture = loaded;
+			return true;
 		}
 	}
 
-	return textures;
+	texture.m_id = PackedTextureFromFiles(diffusePath.C_Str(), specularPath.C_Str(), m_Directory);
+	texture.m_type = "texture_diffuse_specular";
+	texture.m_path = path;
+	m_TexturesLoaded.push_back(texture);
+
+	return texture.m_id != 0;
 }
@@ -1,24 +1,42 @@
 ﻿#pragma once
 
+#include <functional>
 #include <vector>
 #include <assimp/scene.h>
 
+#include "LightingFeatures.h"
 #include "Mesh.h"
 
+class InstanceBuffer;
+class RenderQueue;
+class ShaderPermutations;
+struct ObjectTransform;
+
 unsigned int TextureFromFile(const std::string& path, const std::string& directory, bool gamma = false);
+// Loads the diffuse map as RGB and stores the specular map's intensity in alpha.
+unsigned int PackedTextureFromFiles(const std::string& diffusePath, const std::string& specularPath, const std::string& directory);
 
 class Model
 {
 public:
 	Model(const std::string& path);
 
-	void Draw(Shader shader);
+	void Draw(const Shader& shader);
+	// Every mesh without binding its textures, for shadow and other depth only passes
+	void DrawDepth();
+	// Queues every mesh with the smallest lit permutation for it, the queue groups them so each
+	// variant is bound (and timed) once. Meshes whose variant is still compiling are skipped.
+	// setupShader is called by the queue after binding each variant.
+	void Submit(RenderQueue& queue, ShaderPermutations& permutations, LightingFeatures features, const ObjectTransform& transform, const std::function<void(const Shader&)>& setupShader);
+	// One instanced draw per mesh for every instance bound from instances, with permutations of an
+	// instanced vertex shader. setupShader is called after binding each mesh's variant.
+	void DrawInstanced(const InstanceBuffer& instances, ShaderPermutations& permutations, LightingFeatures features, const std::function<void(const Shader&)>& setupShader);
 
 private:
 	void LoadModel(const std::string path);
 	void ProcessNode(aiNode* pNode, const aiScene* pScene);
 	Mesh ProcessMesh(aiMesh* pMesh, const aiScene* pScene);
-	std::vector<Mesh::Texture> LoadMaterialTextures(aiMaterial* pMaterial, aiTextureType type, const std::string& typeName);
+	bool LoadPackedMaterial(aiMaterial* pMaterial, Mesh::Texture& texture);
 	
 private:
 	std::vector<Mesh> m_Meshes;
@@ -0,0 +1,228 @@
+#include "RenderQueue.h"
+
+#include <glad/glad.h>
+
+#include "deps/imgui/imgui.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "GLState.h"
+#include "GpuTimer.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "TransformBatch.h"
+#include "UniformBlocks.h"
+#include "UniformRing.h"
+
+namespace
+{
+	const int DEPTH_BITS = 24;
+	const int VERTEX_ARRAY_BITS = 12;
+	const int MATERIAL_BITS = 12;
+	const int PROGRAM_BITS = 11;
+
+	const int VERTEX_ARRAY_SHIFT = DEPTH_BITS;
+	const int MATERIAL_SHIFT = VERTEX_ARRAY_SHIFT + VERTEX_ARRAY_BITS;
+	const int PROGRAM_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+	const int PASS_SHIFT = PROGRAM_SHIFT + PROGRAM_BITS;
+	// The state fields of a transparent draw, moved down to make room for its depth after the pass
+	const int TRANSPARENT_DEPTH_SHIFT = PASS_SHIFT - DEPTH_BITS;
+
+	// Positive floats order like their bit patterns, the top 24 bits keep the exponent and 15 bits of mantissa
+	uint64_t QuantizeDepth(float depth)
+	{
+		depth = depth > 0.0f ? depth : 0.0f;
+		uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		return bits >> (32 - DEPTH_BITS);
+	}
+}
+
+RenderQueue::RenderQueue(UniformRing& uniforms)
+	: m_Uniforms(uniforms)
+	, m_View(1.0f)
+	, m_Draws(0)
+	, m_SkippedDraws(0)
+	, m_ProgramBinds(0)
+	, m_MaterialBinds(0)
+	, m_VertexArrayBinds(0)
+	, m_SortPasses(0)
+	, m_SortMicroseconds(0.0f)
+{
+}
+
+void RenderQueue::Begin(const glm::mat4& view)
+{
+	m_View = view;
+	m_Items.clear();
+	m_Entries.clear();
+	m_Programs.clear();
+	m_Materials.clear();
+	m_VertexArrays.clear();
+}
+
+uint32_t RenderQueue::DenseIndex(std::vector<uint32_t>& table, uint32_t value, uint32_t limit)
+{
+	// A handful of entries per frame, a linear scan beats hashing
+	for (size_t i = 0; i < table.size(); i++)
+	{
+		if (table[i] == value)
+			return uint32_t(i);
+	}
+	// Out of bits: share the last index, which only costs some sorting quality
+	if (table.size() >= limit)
+		return limit - 1;
+	table.push_back(value);
+	return uint32_t(table.size() - 1);
+}
+
+void RenderQueue::Submit(RenderPass pass, const RenderItem& item)
+{
+	uint64_t program = DenseIndex(m_Programs, item.m_shader->GetId(), 1u << PROGRAM_BITS);
+	uint64_t material = DenseIndex(m_Materials, item.m_mesh ? item.m_mesh->GetMaterialId() : 0, 1u << MATERIAL_BITS);
+	uint64_t vertexArray = DenseIndex(m_VertexArrays, item.m_mesh ? item.m_mesh->GetVertexArray() : item.m_vertexArray, 1u << VERTEX_ARRAY_BITS);
+
+	float viewDepth = 0.0f;
+	if (item.m_transform)
+		viewDepth = -(m_View * item.m_transform->m_model[3]).z;
+	uint64_t depth = QuantizeDepth(viewDepth);
+
+	uint64_t key = uint64_t(pass) << PASS_SHIFT;
+	uint64_t state = (program << PROGRAM_SHIFT) | (material << MATERIAL_SHIFT) | (vertexArray << VERTEX_ARRAY_SHIFT);
+	if (pass == RenderPass::Transparent)
+		key |= ((~depth & ((1ull << DEPTH_BITS) - 1)) << TRANSPARENT_DEPTH_SHIFT) | (state >> DEPTH_BITS);
+	else
+		key |= state | depth;
+
+	m_Entries.push_back({ key, uint32_t(m_Items.size()) });
+	m_Items.push_back(item);
+}
+
+void RenderQueue::RadixSort()
+{
+	m_SortPasses = 0;
+	const size_t count = m_Entries.size();
+	if (count < 2)
+		return;
+	m_Scratch.resize(count);
+
+	SortEntry* source = m_Entries.data();
+	SortEntry* destination = m_Scratch.data();
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		uint32_t histogram[256] = {};
+		for (size_t i = 0; i < count; i++)
+			histogram[(source[i].m_key >> shift) & 0xFF]++;
+
+		// Every key has the same digit here, the order would not change
+		if (histogram[(source[0].m_key >> shift) & 0xFF] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t& bucket : histogram)
+		{
+			uint32_t bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+		for (size_t i = 0; i < count; i++)
+			destination[histogram[(source[i].m_key >> shift) & 0xFF]++] = source[i];
+
+		std::swap(source, destination);
+		m_SortPasses++;
+	}
+
+	// An odd number of passes leaves the result in the scratch buffer
+	if (source != m_Entries.data())
+		m_Entries.swap(m_Scratch);
+}
+
+void RenderQueue::Execute()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	RadixSort();
+	m_SortMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+	m_Draws = 0;
+	m_SkippedDraws = 0;
+	m_ProgramBinds = 0;
+	m_MaterialBinds = 0;
+	m_VertexArrayBinds = 0;
+
+	Shader* program = nullptr;
+	GpuTimer* timer = nullptr;
+	unsigned int material = 0;
+	unsigned int vertexArray = 0;
+	for (const SortEntry& entry : m_Entries)
+	{
+		const RenderItem& item = m_Items[entry.m_item];
+
+		if (item.m_shader != program)
+		{
+			if (item.m_timer != timer)
+			{
+				if (timer)
+					timer->End();
+				timer = item.m_timer;
+				if (timer)
+					timer->Begin();
+			}
+
+			program = item.m_shader;
+			program->Use();
+			if (item.m_setupProgram)
+				(*item.m_setupProgram)(*program);
+			// Sampler uniforms belong to the program, the material has to be set again
+			material = 0;
+			m_ProgramBinds++;
+		}
+
+		if (item.m_mesh && item.m_mesh->GetMaterialId() != material)
+		{
+			item.m_mesh->BindMaterial(*program);
+			material = item.m_mesh->GetMaterialId();
+			m_MaterialBinds++;
+		}
+
+		if (item.m_transform)
+		{
+			const ObjectTransform& transform = *item.m_transform;
+			ObjectBlock object = { transform.m_model, transform.m_modelViewProjection, transform.m_normalMatrix };
+			GLintptr offset = m_Uniforms.Push(object);
+			// The ring is full this frame (it logs that and grows), the bound block is another draw's
+			if (offset < 0)
+			{
+				m_SkippedDraws++;
+				continue;
+			}
+			m_Uniforms.Bind<ObjectBlock>(OBJECT_BLOCK_BINDING, offset);
+		}
+
+		unsigned int itemVertexArray = item.m_mesh ? item.m_mesh->GetVertexArray() : item.m_vertexArray;
+		if (itemVertexArray != vertexArray)
+		{
+			vertexArray = itemVertexArray;
+			GLState::BindVertexArray(vertexArray);
+			m_VertexArrayBinds++;
+		}
+
+		if (item.m_mesh)
+			glDrawElements(GL_TRIANGLES, GLsizei(item.m_mesh->GetIndexCount()), GL_UNSIGNED_INT, 0);
+		else
+			glDrawArrays(GL_TRIANGLES, 0, item.m_vertexCount);
+		m_Draws++;
+	}
+
+	if (timer)
+		timer->End();
+}
+
+void RenderQueue::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	ImGui::Text("Last batch: %d draws, %d skipped for want of uniform space", m_Draws, m_SkippedDraws);
+	ImGui::Text("  %d programs, %d materials, %d vertex arrays bound", m_ProgramBinds, m_MaterialBinds, m_VertexArrayBinds);
+	ImGui::Text("  radix sort %.1f us, %d of 8 passes", m_SortMicroseconds, m_SortPasses);
+	ImGui::End();
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class GpuTimer;
+class Mesh;
+class Shader;
+class UniformRing;
+struct ObjectTransform;
+
+enum class RenderPass : uint32_t
+{
+	Opaque,			// state sorted, then front to back
+	Transparent		// back to front, then state sorted
+};
+
+// One draw handed to the RenderQueue. Either a Mesh (its material and indices) or a plain
+// glDrawArrays of vertexCount triangles from vertexArray.
+struct RenderItem
+{
+	Shader* m_shader;
+	const Mesh* m_mesh;
+	unsigned int m_vertexArray;
+	int m_vertexCount;
+	const ObjectTransform* m_transform;	// the Object block (include/object.glsl) of the draw
+	GpuTimer* m_timer;					// optional, brackets the draws made with this program
+	// Optional, called every time the program is bound to set what is shared by all its draws
+	const std::function<void(const Shader&)>* m_setupProgram;
+};
+
+// Draws collected from anywhere in the frame and issued in the order that changes the least state.
+// Every submission becomes a 64-bit key, from the most significant bits down:
+//   pass (5) | program (11) | material (12) | vertex array (12) | view depth (24)
+// so sorting the keys groups draws by program, then material, then geometry, and orders draws
+// that share all of those front to back. Transparent draws put their (inverted) depth right
+// after the pass instead, so they blend back to front.
+//
+// The keys are sorted with an LSD radix sort, 8 bits per pass, skipping the passes in which every
+// key has the same digit (the program bits, say, when there are only a few programs). All buffers
+// are kept between frames, so a frame with no more draws than the last does not allocate.
+class RenderQueue
+{
+public:
+	// Uniform binding of the Object block in include/object.glsl
+	static const unsigned int OBJECT_BLOCK_BINDING = 6;
+
+	// Every draw's Object block goes into uniforms, between its Begin() and End(). Draws that do
+	// not fit in this frame's slice are skipped.
+	explicit RenderQueue(UniformRing& uniforms);
+
+	// Clears the queue; depth is measured along this view
+	void Begin(const glm::mat4& view);
+	void Submit(RenderPass pass, const RenderItem& item);
+	// Sorts the draws and issues them
+	void Execute();
+
+	void DrawImGui(const char* title);
+
+	size_t GetCount() const { return m_Items.size(); }
+
+private:
+	struct SortEntry
+	{
+		uint64_t m_key;
+		uint32_t m_item;
+	};
+
+	static uint32_t DenseIndex(std::vector<uint32_t>& table, uint32_t value, uint32_t limit);
+	void RadixSort();
+
+private:
+	UniformRing& m_Uniforms;
+	glm::mat4 m_View;
+	std::vector<RenderItem> m_Items;
+	std::vector<SortEntry> m_Entries;
+	std::vector<SortEntry> m_Scratch;
+
+	// Programs, materials and vertex arrays numbered in the order they were first submitted, so
+	// their fields stay small however large the GL names get
+	std::vector<uint32_t> m_Programs;
+	std::vector<uint32_t> m_Materials;
+	std::vector<uint32_t> m_VertexArrays;
+
+	// Last Execute(), for DrawImGui()
+	int m_Draws;
+	int m_SkippedDraws;
+	int m_ProgramBinds;
+	int m_MaterialBinds;
+	int m_VertexArrayBinds;
+	int m_SortPasses;
+	float m_SortMicroseconds;
+};
@@ -0,0 +1,182 @@
+#include "RenderThread.h"
+
+#include <GLFW/glfw3.h>
+#include "deps/imgui/imgui.h"
+
+#include <chrono>
+
+RenderThread::RenderThread(GLFWwindow* window, const std::function<void(const FramePacket&)>& renderFrame)
+	: m_Window(window)
+	, m_RenderFrame(renderFrame)
+	, m_Running(false)
+	, m_WriteIndex(0)
+	, m_ReadIndex(0)
+	, m_QueuedCount(0)
+	, m_Call(nullptr)
+	, m_Stopping(false)
+	, m_RenderMilliseconds(0.0f)
+	, m_IdleMilliseconds(0.0f)
+	, m_FramesDrawn(0)
+	, m_PacketWaitMicroseconds(0.0f)
+	, m_CallWaitMicroseconds(0.0f)
+{
+}
+
+RenderThread::~RenderThread()
+{
+	Stop();
+}
+
+void RenderThread::Start()
+{
+	if (m_Running)
+		return;
+
+	// A context can only be current on one thread at a time
+	glfwMakeContextCurrent(nullptr);
+	m_Stopping = false;
+	m_Running = true;
+	m_Thread = std::thread(&RenderThread::Run, this);
+}
+
+void RenderThread::Stop()
+{
+	if (!m_Running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_RenderWake.notify_one();
+	m_Thread.join();
+	m_Running = false;
+
+	// Back on the calling thread, which destroys the GL objects
+	glfwMakeContextCurrent(m_Window);
+}
+
+FramePacket& RenderThread::BeginPacket()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_MainWake.wait(lock, [this] { return m_QueuedCount < PACKET_COUNT; });
+	}
+	m_PacketWaitMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	return m_Packets[m_WriteIndex];
+}
+
+void RenderThread::SubmitPacket()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_QueuedCount++;
+	}
+	m_WriteIndex = (m_WriteIndex + 1) % PACKET_COUNT;
+	m_RenderWake.notify_one();
+}
+
+void RenderThread::Enqueue(const std::function<void()>& command)
+{
+	if (!m_Running)
+	{
+		command();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Commands.push_back(command);
+	}
+	m_RenderWake.notify_one();
+}
+
+void RenderThread::Call(const std::function<void()>& command)
+{
+	if (!m_Running)
+	{
+		command();
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Call = &command;
+		m_RenderWake.notify_one();
+		m_MainWake.wait(lock, [this] { return m_Call == nullptr; });
+	}
+	m_CallWaitMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RenderThread::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		ImGui::Text("%d packets, %d queued, %lld frames drawn", PACKET_COUNT, m_QueuedCount, m_FramesDrawn);
+		ImGui::Text("Render thread: frame and swap %.2f ms, idle %.2f ms", m_RenderMilliseconds, m_IdleMilliseconds);
+	}
+	ImGui::Text("Main thread waits: packet %.1f us, last call %.1f us", m_PacketWaitMicroseconds, m_CallWaitMicroseconds);
+	ImGui::End();
+}
+
+void RenderThread::Run()
+{
+	glfwMakeContextCurrent(m_Window);
+
+	float idleMilliseconds = 0.0f;
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (true)
+	{
+		auto waitStart = std::chrono::high_resolution_clock::now();
+		m_RenderWake.wait(lock, [this] { return m_QueuedCount > 0 || !m_Commands.empty() || m_Call || m_Stopping; });
+		idleMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+
+		// Commands run unlocked, so the main thread can keep enqueueing and submitting meanwhile
+		while (!m_Commands.empty())
+		{
+			std::function<void()> command = std::move(m_Commands.front());
+			m_Commands.pop_front();
+			lock.unlock();
+			command();
+			lock.lock();
+		}
+		if (m_Call)
+		{
+			const std::function<void()>* call = m_Call;
+			lock.unlock();
+			(*call)();
+			lock.lock();
+			m_Call = nullptr;
+			m_MainWake.notify_one();
+		}
+
+		if (m_QueuedCount > 0)
+		{
+			const FramePacket& packet = m_Packets[m_ReadIndex];
+			lock.unlock();
+			auto frameStart = std::chrono::high_resolution_clock::now();
+			m_RenderFrame(packet);
+			glfwSwapBuffers(m_Window);
+			float frameMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+			lock.lock();
+
+			m_ReadIndex = (m_ReadIndex + 1) % PACKET_COUNT;
+			m_QueuedCount--;
+			m_RenderMilliseconds = frameMilliseconds;
+			m_IdleMilliseconds = idleMilliseconds;
+			m_FramesDrawn++;
+			idleMilliseconds = 0.0f;
+			m_MainWake.notify_one();
+		}
+		else if (m_Stopping && m_Commands.empty())
+		{
+			break;
+		}
+	}
+	lock.unlock();
+
+	glfwMakeContextCurrent(nullptr);
+}
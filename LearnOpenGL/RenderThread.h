@@ -0,0 +1,81 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "FramePacket.h"
+
+struct GLFWwindow;
+
+// Owns the window's GL context and draws the frames the main thread describes in FramePackets, so
+// input, simulation and UI of one frame run while the previous one is submitted to the driver.
+//
+// There are PACKET_COUNT packets used round robin: the main thread fills one while the render
+// thread draws another and a third may wait in between, which is as far as the main thread can
+// run ahead before BeginPacket() waits.
+//
+// Anything else that needs the context goes through the command queue: Enqueue() runs a command on
+// the render thread before the next packet, Call() does the same and waits for it. While the main
+// thread waits nothing else touches the render side, so a Call() may read render state and use
+// ImGui (the debug windows of the GL subsystems), at the cost of waiting for the frame in flight.
+//
+// Per frame on the main thread:
+//   FramePacket& packet = BeginPacket(); fill packet...; SubmitPacket();
+class RenderThread
+{
+public:
+	static const int PACKET_COUNT = 3;
+
+	// renderFrame issues every GL call of a frame, the render thread swaps the buffers after it
+	RenderThread(GLFWwindow* window, const std::function<void(const FramePacket&)>& renderFrame);
+	~RenderThread();
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// Moves the context, current on the calling thread, to the render thread
+	void Start();
+	// Draws every submitted packet, then makes the context current on the calling thread again
+	void Stop();
+
+	// The packet to fill for the next frame, waits until the render thread frees one
+	FramePacket& BeginPacket();
+	void SubmitPacket();
+
+	void Enqueue(const std::function<void()>& command);
+	void Call(const std::function<void()>& command);
+
+	void DrawImGui(const char* title);
+
+private:
+	void Run();
+
+private:
+	GLFWwindow* m_Window;
+	std::function<void(const FramePacket&)> m_RenderFrame;
+	std::thread m_Thread;
+	bool m_Running;
+
+	// Guards everything below up to the statistics written by the main thread
+	std::mutex m_Mutex;
+	std::condition_variable m_RenderWake;	// a packet or command arrived, or Stop() was called
+	std::condition_variable m_MainWake;		// a packet was drawn or a Call() finished
+
+	FramePacket m_Packets[PACKET_COUNT];
+	int m_WriteIndex;	// main thread only
+	int m_ReadIndex;
+	int m_QueuedCount;	// submitted and not yet drawn
+	std::deque<std::function<void()>> m_Commands;
+	const std::function<void()>* m_Call;	// the one waiting Call(), the main thread blocks so there is only one
+	bool m_Stopping;
+
+	float m_RenderMilliseconds;	// render function and swap of the last frame
+	float m_IdleMilliseconds;	// render thread waiting for the packet of the last frame
+	long long m_FramesDrawn;
+
+	// Main thread only
+	float m_PacketWaitMicroseconds;
+	float m_CallWaitMicroseconds;
+};
@@ -0,0 +1,129 @@
+#include "SamplerCache.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "GLState.h"
+#include "helpers/GLExtensions.h"
+#include "helpers/Logger.h"
+
+// Core in 4.6, exposed through EXT/ARB_texture_filter_anisotropic on our 4.5 loader
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+std::unordered_map<uint32_t, unsigned int> SamplerCache::m_Samplers;
+FilteringTier SamplerCache::m_Tier = FilteringTier::Anisotropic4x;
+float SamplerCache::m_MaxAnisotropy = 1.0f;
+
+void SamplerCache::Init()
+{
+	if (GLExtensions::IsSupported("GL_EXT_texture_filter_anisotropic") || GLExtensions::IsSupported("GL_ARB_texture_filter_anisotropic"))
+	{
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &m_MaxAnisotropy);
+	}
+
+	if (m_MaxAnisotropy <= 1.0f)
+		Logger::LogWarning("SamplerCache: anisotropic filtering not supported");
+}
+
+void SamplerCache::Shutdown()
+{
+	for (auto& sampler : m_Samplers)
+	{
+		glDeleteSamplers(1, &sampler.second);
+	}
+	m_Samplers.clear();
+}
+
+unsigned int SamplerCache::Get(const SamplerDesc& desc)
+{
+	// Clamp the requested filter to what the current tier allows
+	SamplerFilter filter = desc.m_filter;
+	float anisotropy = 1.0f;
+	if (filter == SamplerFilter::Trilinear)
+	{
+		switch (m_Tier)
+		{
+		case FilteringTier::Bilinear:
+			filter = SamplerFilter::Bilinear;
+			break;
+		case FilteringTier::Trilinear:
+			break;
+		case FilteringTier::Anisotropic4x:
+			anisotropy = std::min(4.0f, m_MaxAnisotropy);
+			break;
+		case FilteringTier::Anisotropic16x:
+			anisotropy = std::min(16.0f, m_MaxAnisotropy);
+			break;
+		}
+	}
+
+	uint32_t key = uint32_t(filter) | (uint32_t(desc.m_wrap) << 4) | (uint32_t(anisotropy) << 8) | (uint32_t(desc.m_depthCompare) << 16);
+	auto it = m_Samplers.find(key);
+	if (it != m_Samplers.end())
+		return it->second;
+
+	unsigned int sampler = Create(filter, desc.m_wrap, anisotropy, desc.m_depthCompare);
+	m_Samplers[key] = sampler;
+	return sampler;
+}
+
+void SamplerCache::Bind(unsigned int unit, const SamplerDesc& desc)
+{
+	GLState::BindSampler(unit, Get(desc));
+}
+
+const char* SamplerCache::GetTierName(FilteringTier tier)
+{
+	switch (tier)
+	{
+	case FilteringTier::Bilinear: return "Bilinear";
+	case FilteringTier::Trilinear: return "Trilinear";
+	case FilteringTier::Anisotropic4x: return "Anisotropic 4x";
+	case FilteringTier::Anisotropic16x: return "Anisotropic 16x";
+	}
+	return "Unknown";
+}
+
+unsigned int SamplerCache::Create(SamplerFilter filter, SamplerWrap wrap, float anisotropy, bool depthCompare)
+{
+	unsigned int sampler;
+	glGenSamplers(1, &sampler);
+
+	GLint glWrap = wrap == SamplerWrap::Repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, glWrap);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, glWrap);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, glWrap);
+
+	switch (filter)
+	{
+	case SamplerFilter::Nearest:
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		break;
+	case SamplerFilter::Bilinear:
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		break;
+	case SamplerFilter::Trilinear:
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		break;
+	}
+
+	if (anisotropy > 1.0f)
+		glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+
+	if (depthCompare)
+	{
+		glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+
+	return sampler;
+}
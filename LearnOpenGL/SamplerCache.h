@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+
+enum class SamplerFilter
+{
+	Nearest,
+	Bilinear,
+	Trilinear
+};
+
+enum class SamplerWrap
+{
+	Repeat,
+	ClampToEdge
+};
+
+// Global quality-versus-cost setting applied to every sampler in the scene.
+enum class FilteringTier
+{
+	Bilinear,
+	Trilinear,
+	Anisotropic4x,
+	Anisotropic16x
+};
+
+struct SamplerDesc
+{
+	SamplerFilter m_filter = SamplerFilter::Trilinear;
+	SamplerWrap m_wrap = SamplerWrap::Repeat;
+	// Depth textures read through sampler*Shadow, filtering compares before blending (hardware PCF)
+	bool m_depthCompare = false;
+};
+
+// Registry of immutable sampler objects shared by all textures. Textures no longer carry
+// their own filter/wrap state; instead the sampler matching the requested description and
+// the current filtering tier is bound to the texture unit they are used on.
+class SamplerCache
+{
+public:
+	static void Init();
+	static void Shutdown();
+
+	// Returns the sampler object for the description, clamped to the current filtering tier.
+	static unsigned int Get(const SamplerDesc& desc);
+	static void Bind(unsigned int unit, const SamplerDesc& desc);
+
+	static void SetFilteringTier(FilteringTier tier) { m_Tier = tier; }
+	static FilteringTier GetFilteringTier() { return m_Tier; }
+	static const char* GetTierName(FilteringTier tier);
+
+	static float GetMaxAnisotropy() { return m_MaxAnisotropy; }
+
+private:
+	static unsigned int Create(SamplerFilter filter, SamplerWrap wrap, float anisotropy, bool depthCompare);
+
+private:
+	static std::unordered_map<uint32_t, unsigned int> m_Samplers;
+	static FilteringTier m_Tier;
+	static float m_MaxAnisotropy;
+};
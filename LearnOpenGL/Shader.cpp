@@ -2,152 +2,492 @@
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
-{
-	// 1. read shader files
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
+#include "GLState.h"
+#include "ShaderPreprocessor.h"
+#include "helpers/GLExtensions.h"
+#include "helpers/Hash.h"
+#include "helpers/Logger.h"
 
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+const char* Shader::m_BinaryCacheDirectory = "cache/shaders";
 
-	try
+namespace
+{
+	// Driver binaries are only valid for the exact driver that produced them
+	uint64_t HashDriver(uint64_t seed)
 	{
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
+		const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (GLenum string : strings)
+		{
+			const char* value = reinterpret_cast<const char*>(glGetString(string));
+			if (value)
+				seed = HashBytes(value, std::strlen(value), seed);
+		}
+		return seed;
+	}
+
+	void InjectDefines(std::string& source, const std::vector<std::string>& defines)
+	{
+		if (defines.empty())
+			return;
+
+		std::string block;
+		for (const std::string& define : defines)
+		{
+			block += "#define " + define + "\n";
+		}
+
+		// #version has to stay the first statement, and the #line keeps error locations pointing at the file
+		size_t version = source.find("#version");
+		size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+		if (lineEnd == std::string::npos)
+		{
+			source.insert(0, block);
+			return;
+		}
 
-		std::stringstream vShaderStream, fShaderStream;
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
+		size_t versionLine = std::count(source.begin(), source.begin() + version, '\n') + 1;
+		block += "#line " + std::to_string(versionLine + 1) + " 0\n";
+		source.insert(lineEnd + 1, block);
+	}
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, ShaderCompileMode mode, const std::vector<std::string>& defines)
+	: m_Id(0)
+	, m_Vertex(0)
+	, m_Fragment(0)
+	, m_Compute(false)
+	, m_Pending(false)
+	, m_Failed(false)
+	, m_VertexPath(vertexPath)
+	, m_FragmentPath(fragmentPath)
+	, m_Defines(defines)
+{
+	Build(mode);
+}
+
+Shader::Shader(const char* computePath, ShaderCompileMode mode, const std::vector<std::string>& defines)
+	: m_Id(0)
+	, m_Vertex(0)
+	, m_Fragment(0)
+	, m_Compute(true)
+	, m_Pending(false)
+	, m_Failed(false)
+	, m_VertexPath(computePath)
+	, m_Defines(defines)
+{
+	Build(mode);
+}
 
-		vShaderFile.close();
-		fShaderFile.close();
+bool Shader::ReloadIfChanged(ShaderCompileMode mode)
+{
+	if (!ShaderPreprocessor::HasChanged(m_Dependencies))
+		return false;
 
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+	if (m_Pending)
+	{
+		glDeleteShader(m_Vertex);
+		glDeleteShader(m_Fragment);
+		m_Vertex = 0;
+		m_Fragment = 0;
+		m_Pending = false;
 	}
-	catch (std::ifstream::failure e)
+	glDeleteProgram(m_Id);
+	m_Id = 0;
+	m_Uniforms.clear();
+	// The new program may reuse the old name
+	GLState::Invalidate();
+	m_UniformIndices.clear();
+
+	Logger::Log("Shader: reloading " + (m_Compute ? m_VertexPath : m_VertexPath + " + " + m_FragmentPath));
+	Build(mode);
+	return true;
+}
+
+void Shader::Build(ShaderCompileMode mode)
+{
+	m_Failed = false;
+
+	// 1. read shader files, resolving #include
+	ShaderPreprocessor::Result vertex = ShaderPreprocessor::Expand(m_VertexPath);
+	ShaderPreprocessor::Result fragment;
+	if (m_Compute)
+		fragment.m_success = true;
+	else
+		fragment = ShaderPreprocessor::Expand(m_FragmentPath);
+
+	m_Dependencies = vertex.m_dependencies;
+	m_Dependencies.insert(m_Dependencies.end(), fragment.m_dependencies.begin(), fragment.m_dependencies.end());
+	m_VertexFiles = vertex.m_files;
+	m_FragmentFiles = fragment.m_files;
+
+	if (!vertex.m_success || !fragment.m_success)
 	{
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+		m_Failed = true;
+		// Retry on the next reload whichever file was at fault
+		m_Dependencies.push_back({ m_VertexPath, 0 });
+		return;
 	}
+
+	std::string vertexCode = vertex.m_source;
+	std::string fragmentCode = fragment.m_source;
+	InjectDefines(vertexCode, m_Defines);
+	InjectDefines(fragmentCode, m_Defines);
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	// 2. compile shaders
-	unsigned int vertex, fragment;
-	int success;
-	char infoLog[512];
-
-	// vertex shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, nullptr);
-	glCompileShader(vertex);
-
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-	if (!success)
+	// Try the program binary cache before compiling anything
+	uint64_t key = HashDriver(HashBytes(fragmentCode.data(), fragmentCode.size(), HashBytes(vertexCode.data(), vertexCode.size())));
+	std::string binaryPath = std::string(m_BinaryCacheDirectory) + "/" + HashToString(key) + ".bin";
+	if (LoadProgramBinary(binaryPath))
 	{
-		glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		ReflectUniforms();
+		ReflectUniformBlocks();
+		return;
 	}
 
-	// fragment shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, nullptr);
-	glCompileShader(fragment);
+	// 2. submit the sources; status is only queried once the driver reports completion
+	m_Vertex = glCreateShader(m_Compute ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER);
+	glShaderSource(m_Vertex, 1, &vShaderCode, nullptr);
+	glCompileShader(m_Vertex);
 
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-	if (!success)
+	if (!m_Compute)
 	{
-		glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
-		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+		m_Fragment = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(m_Fragment, 1, &fShaderCode, nullptr);
+		glCompileShader(m_Fragment);
 	}
 
 	// shader program
 	m_Id = glCreateProgram();
-	glAttachShader(m_Id, vertex);
-	glAttachShader(m_Id, fragment);
+	glAttachShader(m_Id, m_Vertex);
+	if (!m_Compute)
+		glAttachShader(m_Id, m_Fragment);
+	glProgramParameteri(m_Id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(m_Id);
 
-	glGetProgramiv(m_Id, GL_LINK_STATUS, &success);
+	m_BinaryPath = binaryPath;
+	m_Pending = true;
+
+	if (mode == ShaderCompileMode::Blocking)
+	{
+		Finalize();
+	}
+}
+
+bool Shader::IsReady()
+{
+	if (!m_Pending)
+		return !m_Failed;
+
+	// Without the extension there is no way to ask, so we block here instead
+	if (GLExtensions::HasParallelShaderCompile())
+	{
+		int completed = 0;
+		glGetProgramiv(m_Id, GL_COMPLETION_STATUS_KHR, &completed);
+		if (!completed)
+			return false;
+	}
+
+	Finalize();
+	return !m_Failed;
+}
+
+void Shader::Finalize()
+{
+	if (!m_Pending)
+		return;
+
+	m_Pending = false;
+
+	int success;
+	char infoLog[1024];
+
+	// Locations in the logs refer to #line source numbers, map them back to file names
+	glGetShaderiv(m_Vertex, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetProgramInfoLog(m_Id, 512, nullptr, infoLog);
+		glGetShaderInfoLog(m_Vertex, 1024, nullptr, infoLog);
+		std::cout << (m_Compute ? "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" : "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n") << ShaderPreprocessor::ResolveLog(infoLog, m_VertexFiles) << std::endl;
+	}
+
+	if (!m_Compute)
+	{
+		glGetShaderiv(m_Fragment, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(m_Fragment, 1024, nullptr, infoLog);
+			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << ShaderPreprocessor::ResolveLog(infoLog, m_FragmentFiles) << std::endl;
+		}
+	}
+
+	glGetProgramiv(m_Id, GL_LINK_STATUS, &success);
+	m_Failed = !success;
+	if (m_Failed)
+	{
+		glGetProgramInfoLog(m_Id, 1024, nullptr, infoLog);
 		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 	}
 
 	// delete shaders, they are linked in the program now
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDeleteShader(m_Vertex);
+	glDeleteShader(m_Fragment);
+	m_Vertex = 0;
+	m_Fragment = 0;
+
+	// A failed program has nothing to cache or reflect, IsReady() keeps it out of use
+	if (m_Failed)
+		return;
+
+	SaveProgramBinary(m_BinaryPath);
+	ReflectUniforms();
+	ReflectUniformBlocks();
 }
 
 void Shader::Use()
 {
-	glUseProgram(m_Id);
+	GLState::UseProgram(m_Id);
+}
+
+int Shader::GetUniformLocation(UniformName name) const
+{
+	auto it = m_UniformIndices.find(name.m_hash);
+	if (it == m_UniformIndices.end())
+		return -1;
+
+	return m_Uniforms[it->second].m_location;
+}
+
+bool Shader::LoadProgramBinary(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	file.seekg(0, std::ios::end);
+	std::streamoff size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	if (size <= std::streamoff(sizeof(uint32_t)))
+		return false;
+
+	uint32_t format = 0;
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	std::vector<char> binary(size_t(size) - sizeof(format));
+	file.read(binary.data(), std::streamsize(binary.size()));
+	if (binary.empty() || file.gcount() != std::streamsize(binary.size()))
+		return false;
+
+	m_Id = glCreateProgram();
+	glProgramBinary(m_Id, format, binary.data(), GLsizei(binary.size()));
+
+	// The driver may reject binaries after an update, in which case we simply compile again
+	int success;
+	glGetProgramiv(m_Id, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		Logger::LogWarning("Shader: cached program binary rejected, recompiling " + path);
+		glDeleteProgram(m_Id);
+		m_Id = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void Shader::SaveProgramBinary(const std::string& path) const
+{
+	int length = 0;
+	glGetProgramiv(m_Id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(m_Id, length, nullptr, &format, binary.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(m_BinaryCacheDirectory, error);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		Logger::LogWarning("Shader: could not write program binary " + path);
+		return;
+	}
+
+	uint32_t storedFormat = format;
+	file.write(reinterpret_cast<const char*>(&storedFormat), sizeof(storedFormat));
+	file.write(binary.data(), binary.size());
+}
+
+void Shader::ReflectUniforms()
+{
+	m_Uniforms.clear();
+	m_UniformIndices.clear();
+
+	int uniformCount = 0;
+	int maxNameLength = 0;
+	glGetProgramiv(m_Id, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(m_Id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+	for (int i = 0; i < uniformCount; i++)
+	{
+		int length = 0;
+		int size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_Id, i, maxNameLength, &length, &size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), length);
+
+		// Uniform block members have no location, they are set through buffers
+		int location = glGetUniformLocation(m_Id, name.c_str());
+		if (location < 0)
+			continue;
+
+		unsigned int index = static_cast<unsigned int>(m_Uniforms.size());
+		m_UniformIndices[HashUniformName(name.data(), name.size())] = index;
+		m_Uniforms.push_back({ location, type, size });
+
+		// Arrays are reported as "name[0]"; make the bare name and every element resolvable too
+		size_t bracket = name.rfind("[0]");
+		if (bracket != std::string::npos && bracket + 3 == name.size())
+		{
+			std::string base = name.substr(0, bracket);
+			m_UniformIndices[HashUniformName(base.data(), base.size())] = index;
+			for (int element = 1; element < size; element++)
+			{
+				std::string elementName = base + "[" + std::to_string(element) + "]";
+				m_UniformIndices[HashUniformName(elementName.data(), elementName.size())] = static_cast<unsigned int>(m_Uniforms.size());
+				m_Uniforms.push_back({ glGetUniformLocation(m_Id, elementName.c_str()), type, 1 });
+			}
+		}
+	}
+}
+
+void Shader::ReflectUniformBlocks()
+{
+	m_UniformBlocks.clear();
+
+	int blockCount = 0;
+	int maxNameLength = 0;
+	glGetProgramiv(m_Id, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	glGetProgramiv(m_Id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	int maxBlockNameLength = 0;
+	glGetProgramiv(m_Id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+	std::vector<char> nameBuffer(std::max({ maxNameLength, maxBlockNameLength, 1 }));
+
+	for (int block = 0; block < blockCount; block++)
+	{
+		UniformBlockInfo info;
+
+		int length = 0;
+		glGetActiveUniformBlockName(m_Id, block, GLsizei(nameBuffer.size()), &length, nameBuffer.data());
+		info.m_name.assign(nameBuffer.data(), length);
+		glGetActiveUniformBlockiv(m_Id, block, GL_UNIFORM_BLOCK_BINDING, &info.m_binding);
+		glGetActiveUniformBlockiv(m_Id, block, GL_UNIFORM_BLOCK_DATA_SIZE, &info.m_dataSize);
+
+		int memberCount = 0;
+		glGetActiveUniformBlockiv(m_Id, block, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &memberCount);
+		std::vector<int> indices(memberCount);
+		glGetActiveUniformBlockiv(m_Id, block, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices.data());
+
+		// One query per property for all members at once
+		std::vector<GLuint> uniformIndices(indices.begin(), indices.end());
+		std::vector<int> types(memberCount), sizes(memberCount), offsets(memberCount), arrayStrides(memberCount), matrixStrides(memberCount);
+		glGetActiveUniformsiv(m_Id, memberCount, uniformIndices.data(), GL_UNIFORM_TYPE, types.data());
+		glGetActiveUniformsiv(m_Id, memberCount, uniformIndices.data(), GL_UNIFORM_SIZE, sizes.data());
+		glGetActiveUniformsiv(m_Id, memberCount, uniformIndices.data(), GL_UNIFORM_OFFSET, offsets.data());
+		glGetActiveUniformsiv(m_Id, memberCount, uniformIndices.data(), GL_UNIFORM_ARRAY_STRIDE, arrayStrides.data());
+		glGetActiveUniformsiv(m_Id, memberCount, uniformIndices.data(), GL_UNIFORM_MATRIX_STRIDE, matrixStrides.data());
+
+		for (int member = 0; member < memberCount; member++)
+		{
+			glGetActiveUniformName(m_Id, uniformIndices[member], GLsizei(nameBuffer.size()), &length, nameBuffer.data());
+			info.m_members.push_back({ std::string(nameBuffer.data(), length), static_cast<unsigned int>(types[member]), sizes[member],
+				offsets[member], arrayStrides[member], matrixStrides[member] });
+		}
+
+		// Declaration order reads better than the driver's index order
+		std::sort(info.m_members.begin(), info.m_members.end(), [](const UniformBlockMember& a, const UniformBlockMember& b) { return a.m_offset < b.m_offset; });
+		m_UniformBlocks.push_back(std::move(info));
+	}
+}
+
+const Shader::UniformBlockInfo* Shader::FindUniformBlock(const std::string& name) const
+{
+	for (const UniformBlockInfo& block : m_UniformBlocks)
+	{
+		if (block.m_name == name)
+			return &block;
+	}
+	return nullptr;
 }
 
-void Shader::SetBool(const std::string& name, bool value) const
+void Shader::SetBool(UniformName name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+	glUniform1i(GetUniformLocation(name), (int)value);
 }
 
-void Shader::SetInt(const std::string& name, int value) const
+void Shader::SetInt(UniformName name, int value) const
 {
-	glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+	glUniform1i(GetUniformLocation(name), value);
 }
 
-void Shader::SetFloat(const std::string& name, float value) const
+void Shader::SetFloat(UniformName name, float value) const
 {
-	glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+	glUniform1f(GetUniformLocation(name), value);
 }
 
-void Shader::SetVec2(const std::string& name, const glm::vec2& value) const
+void Shader::SetVec2(UniformName name, const glm::vec2& value) const
 {
-	glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+	glUniform2fv(GetUniformLocation(name), 1, &value[0]);
 }
 
-void Shader::SetVec2(const std::string& name, float x, float y) const
+void Shader::SetVec2(UniformName name, float x, float y) const
 {
-	glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+	glUniform2f(GetUniformLocation(name), x, y);
 }
 
-void Shader::SetVec3(const std::string& name, const glm::vec3& value) const
+void Shader::SetVec3(UniformName name, const glm::vec3& value) const
 {
-	glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+	glUniform3fv(GetUniformLocation(name), 1, &value[0]);
 }
 
-void Shader::SetVec3(const std::string& name, float x, float y, float z) const
+void Shader::SetVec3(UniformName name, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+	glUniform3f(GetUniformLocation(name), x, y, z);
 }
 
-void Shader::SetVec4(const std::string& name, const glm::vec4& value) const
+void Shader::SetVec4(UniformName name, const glm::vec4& value) const
 {
-	glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+	glUniform4fv(GetUniformLocation(name), 1, &value[0]);
 }
 
-void Shader::SetVec4(const std::string& name, float x, float y, float z, float w) const
+void Shader::SetVec4(UniformName name, float x, float y, float z, float w) const
 {
-	glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+	glUniform4f(GetUniformLocation(name), x, y, z, w);
 }
 
-void Shader::SetMat2(const std::string& name, const glm::mat2& mat) const
+void Shader::SetMat2(UniformName name, const glm::mat2& mat) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix2fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
-void Shader::SetMat3(const std::string& name, const glm::mat3& mat) const
+void Shader::SetMat3(UniformName name, const glm::mat3& mat) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix3fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
-void Shader::SetMat4(const std::string& name, const glm::mat4& mat) const
+void Shader::SetMat4(UniformName name, const glm::mat4& mat) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
@@ -2,30 +2,133 @@
 
 #include <glm/glm.hpp>
 
+#include "ShaderPreprocessor.h"
+#include "Uniform.h"
+
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class ShaderCompileMode
+{
+	Blocking,	// compile, link and check status before the constructor returns
+	Deferred	// submit to the driver only, poll IsReady() before using the program
+};
 
 class Shader
 {
 public:
-	Shader(const char* vertexPath, const char* fragmentPath);
+	struct UniformInfo
+	{
+		int m_location;
+		unsigned int m_type;
+		int m_size;
+	};
+
+	// Layout of one member of a uniform block as the driver laid it out (std140 or otherwise)
+	struct UniformBlockMember
+	{
+		std::string m_name;
+		unsigned int m_type;
+		int m_size;
+		int m_offset;
+		int m_arrayStride;
+		int m_matrixStride;
+	};
+
+	struct UniformBlockInfo
+	{
+		std::string m_name;
+		int m_binding;
+		int m_dataSize;
+		std::vector<UniformBlockMember> m_members;
+	};
+
+public:
+	// Each define ("NAME" or "NAME VALUE") is injected into both stages right after #version
+	Shader(const char* vertexPath, const char* fragmentPath, ShaderCompileMode mode = ShaderCompileMode::Blocking,
+		const std::vector<std::string>& defines = {});
+	// A compute program, built, cached and reloaded like the others
+	explicit Shader(const char* computePath, ShaderCompileMode mode = ShaderCompileMode::Blocking,
+		const std::vector<std::string>& defines = {});
 
 	unsigned int GetId() const { return m_Id; }
 
+	// Non-blocking when GL_KHR_parallel_shader_compile is available; finalizes the program once it is
+	// done. False for a program that failed to compile or link, draw with a fallback instead.
+	bool IsReady();
+	// Still with the driver, IsReady() or Finalize() have not seen it complete yet
+	bool IsPending() const { return m_Pending; }
+	bool HasFailed() const { return m_Failed; }
+	// Blocks until the program is linked, then reports errors and reflects uniforms
+	void Finalize();
+	// Rebuilds the program if the sources or any file they #include were modified since the last build
+	bool ReloadIfChanged(ShaderCompileMode mode = ShaderCompileMode::Blocking);
+
 	void Use();
 
-	void SetBool(const std::string& name, bool value) const;
-	void SetInt(const std::string& name, int value) const;
-	void SetFloat(const std::string& name, float value) const;
-	void SetVec2(const std::string& name, const glm::vec2& value) const;
-	void SetVec2(const std::string& name, float x, float y) const;
-	void SetVec3(const std::string& name, const glm::vec3& value) const;
-	void SetVec3(const std::string& name, float x, float y, float z) const;
-	void SetVec4(const std::string& name, const glm::vec4& value) const;
-	void SetVec4(const std::string& name, float x, float y, float z, float w) const;
-	void SetMat2(const std::string& name, const glm::mat2& mat) const;
-	void SetMat3(const std::string& name, const glm::mat3& mat) const;
-	void SetMat4(const std::string& name, const glm::mat4& mat) const;
+	// Resolved once at link time, -1 if the uniform is not active
+	int GetUniformLocation(UniformName name) const;
+	// Typed handle for the per-draw path, resolve after the program is ready
+	template <typename T>
+	Uniform<T> GetUniform(UniformName name) const { return Uniform<T>(GetUniformLocation(name)); }
+
+	template <typename T>
+	void Set(UniformName name, const T& value) const { SetUniform(GetUniformLocation(name), value); }
+
+	const std::vector<UniformInfo>& GetUniforms() const { return m_Uniforms; }
+
+	const std::vector<UniformBlockInfo>& GetUniformBlocks() const { return m_UniformBlocks; }
+	// nullptr if the program has no active block with that name
+	const UniformBlockInfo* FindUniformBlock(const std::string& name) const;
+
+	void SetBool(UniformName name, bool value) const;
+	void SetInt(UniformName name, int value) const;
+	void SetFloat(UniformName name, float value) const;
+	void SetVec2(UniformName name, const glm::vec2& value) const;
+	void SetVec2(UniformName name, float x, float y) const;
+	void SetVec3(UniformName name, const glm::vec3& value) const;
+	void SetVec3(UniformName name, float x, float y, float z) const;
+	void SetVec4(UniformName name, const glm::vec4& value) const;
+	void SetVec4(UniformName name, float x, float y, float z, float w) const;
+	void SetMat2(UniformName name, const glm::mat2& mat) const;
+	void SetMat3(UniformName name, const glm::mat3& mat) const;
+	void SetMat4(UniformName name, const glm::mat4& mat) const;
+
+private:
+	void Build(ShaderCompileMode mode);
+	bool LoadProgramBinary(const std::string& path);
+	void SaveProgramBinary(const std::string& path) const;
+	void ReflectUniforms();
+	void ReflectUniformBlocks();
+
+private:
+	// Linked programs are cached here, keyed by a hash of the sources and the driver strings
+	static const char* m_BinaryCacheDirectory;
 
 private:
 	unsigned int m_Id;
+
+	// Compilation state while the driver is still working on the program. A compute program only
+	// has m_Vertex, which holds the compute stage.
+	unsigned int m_Vertex;
+	unsigned int m_Fragment;
+	bool m_Compute;
+	bool m_Pending;
+	bool m_Failed;	// did not compile or link, until the next build
+	std::string m_BinaryPath;
+
+	// Sources, for rebuilding when one of the dependencies changes
+	std::string m_VertexPath;
+	std::string m_FragmentPath;
+	std::vector<std::string> m_Defines;
+	std::vector<ShaderPreprocessor::Dependency> m_Dependencies;
+	std::vector<std::string> m_VertexFiles;
+	std::vector<std::string> m_FragmentFiles;
+
+	// Every active uniform (and array element) in a flat array, indexed by name hash
+	std::vector<UniformInfo> m_Uniforms;
+	std::unordered_map<uint64_t, unsigned int> m_UniformIndices;
+
+	std::vector<UniformBlockInfo> m_UniformBlocks;
 };
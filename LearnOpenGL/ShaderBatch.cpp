@@ -0,0 +1,58 @@
+#include "ShaderBatch.h"
+
+#include <algorithm>
+
+#include "Shader.h"
+#include "helpers/GLExtensions.h"
+#include "helpers/Logger.h"
+
+void ShaderBatch::EnableParallelCompile()
+{
+	if (GLExtensions::HasParallelShaderCompile())
+	{
+		GLExtensions::MaxShaderCompilerThreads(0xFFFFFFFF);
+		Logger::Log("ShaderBatch: parallel shader compilation enabled");
+	}
+	else
+	{
+		Logger::LogWarning("ShaderBatch: GL_KHR_parallel_shader_compile not supported, programs finalize on first use or one per batch per frame");
+	}
+}
+
+void ShaderBatch::Add(Shader& shader)
+{
+	m_Pending.push_back(&shader);
+}
+
+bool ShaderBatch::Poll()
+{
+	if (GLExtensions::HasParallelShaderCompile())
+	{
+		// Finalizes each program the driver reports complete, linked or not
+		for (Shader* shader : m_Pending)
+			shader->IsReady();
+	}
+	else
+	{
+		// Nothing to ask whether a program is done, so finalizing blocks. Only a few per frame, the
+		// programs that are drawn sooner finalize in IsReady() when they are first used.
+		size_t finalized = 0;
+		for (Shader* shader : m_Pending)
+		{
+			if (finalized == BLOCKING_FINALIZES_PER_POLL)
+				break;
+			if (shader->IsPending())
+			{
+				shader->Finalize();
+				finalized++;
+			}
+		}
+	}
+
+	m_Pending.erase(std::remove_if(m_Pending.begin(), m_Pending.end(), [](Shader* shader)
+	{
+		return !shader->IsPending();
+	}), m_Pending.end());
+
+	return m_Pending.empty();
+}
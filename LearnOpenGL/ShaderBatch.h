@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class Shader;
+
+// Tracks a group of programs created with ShaderCompileMode::Deferred. All sources are handed to
+// the driver up front, so with GL_KHR_parallel_shader_compile they compile concurrently, and
+// status queries only happen once each program reports completion.
+class ShaderBatch
+{
+public:
+	static const size_t BLOCKING_FINALIZES_PER_POLL = 1;
+
+	// Lets the driver use as many compiler threads as it likes. Call once after GLExtensions::Init.
+	static void EnableParallelCompile();
+
+	void Add(Shader& shader);
+
+	// Finalizes whatever has finished, returns true once nothing is left with the driver. Without
+	// GL_KHR_parallel_shader_compile it blocks on at most BLOCKING_FINALIZES_PER_POLL programs.
+	bool Poll();
+
+	size_t GetPendingCount() const { return m_Pending.size(); }
+
+private:
+	std::vector<Shader*> m_Pending;
+};
@@ -0,0 +1,115 @@
+#include "ShaderPermutations.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "deps/imgui/imgui.h"
+#include "helpers/Logger.h"
+
+ShaderPermutations::ShaderPermutations(const std::string& vertexPath, const std::string& fragmentPath, DefinesForKey definesForKey)
+	: m_VertexPath(vertexPath)
+	, m_FragmentPath(fragmentPath)
+	, m_DefinesForKey(definesForKey)
+	, m_Frame(0)
+{
+}
+
+Shader& ShaderPermutations::Get(uint32_t key)
+{
+	return *GetVariant(key).m_shader;
+}
+
+void ShaderPermutations::Prewarm(const std::vector<uint32_t>& keys)
+{
+	for (uint32_t key : keys)
+	{
+		GetVariant(key);
+	}
+
+	std::stringstream ss;
+	ss << "ShaderPermutations: " << m_FragmentPath << " has " << m_Variants.size() << " variants submitted";
+	Logger::Log(ss.str());
+}
+
+void ShaderPermutations::Poll()
+{
+	m_Batch.Poll();
+	m_Frame++;
+}
+
+void ShaderPermutations::ReloadChanged()
+{
+	for (auto& entry : m_Variants)
+	{
+		if (entry.second.m_shader->ReloadIfChanged(ShaderCompileMode::Deferred))
+			m_Batch.Add(*entry.second.m_shader);
+	}
+}
+
+GpuTimer& ShaderPermutations::GetTimer(uint32_t key)
+{
+	Variant& variant = GetVariant(key);
+	variant.m_lastUsedFrame = m_Frame;
+	return *variant.m_timer;
+}
+
+float ShaderPermutations::GetFrameMilliseconds() const
+{
+	float milliseconds = 0.0f;
+	for (const auto& entry : m_Variants)
+	{
+		if (entry.second.m_lastUsedFrame == m_Frame)
+			milliseconds += entry.second.m_timer->GetMilliseconds();
+	}
+	return milliseconds;
+}
+
+ShaderPermutations::Variant& ShaderPermutations::GetVariant(uint32_t key)
+{
+	auto found = m_Variants.find(key);
+	if (found != m_Variants.end())
+		return found->second;
+
+	std::vector<std::string> defines = m_DefinesForKey(key);
+
+	Variant& variant = m_Variants[key];
+	variant.m_shader = std::make_unique<Shader>(m_VertexPath.c_str(), m_FragmentPath.c_str(), ShaderCompileMode::Deferred, defines);
+	variant.m_timer = std::make_unique<GpuTimer>();
+	for (const std::string& define : defines)
+	{
+		variant.m_defines += (variant.m_defines.empty() ? "" : ", ") + define;
+	}
+	m_Batch.Add(*variant.m_shader);
+
+	return variant;
+}
+
+void ShaderPermutations::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	ImGui::Text("%zu variants, %zu still compiling", m_Variants.size(), m_Batch.GetPendingCount());
+	ImGui::Separator();
+
+	// Only the variants drawn recently, their timers are stale otherwise
+	std::vector<std::pair<uint32_t, const Variant*>> active;
+	for (const auto& entry : m_Variants)
+	{
+		if (entry.second.m_lastUsedFrame >= 0 && m_Frame - entry.second.m_lastUsedFrame <= 1)
+			active.emplace_back(entry.first, &entry.second);
+	}
+	std::sort(active.begin(), active.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	ImGui::Columns(3, "variants");
+	ImGui::Text("Key"); ImGui::NextColumn();
+	ImGui::Text("GPU ms"); ImGui::NextColumn();
+	ImGui::Text("Defines"); ImGui::NextColumn();
+	ImGui::Separator();
+	for (const auto& entry : active)
+	{
+		ImGui::Text("0x%02X", entry.first); ImGui::NextColumn();
+		ImGui::Text("%.3f", entry.second->m_timer->GetMilliseconds()); ImGui::NextColumn();
+		ImGui::TextUnformatted(entry.second->m_defines.c_str()); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::End();
+}
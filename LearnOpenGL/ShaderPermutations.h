@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GpuTimer.h"
+#include "Shader.h"
+#include "ShaderBatch.h"
+
+// Compiles specialized variants of one vertex/fragment pair on demand, keyed by feature bits.
+// The key is turned into a define list only once, when its variant is first requested.
+class ShaderPermutations
+{
+public:
+	using DefinesForKey = std::function<std::vector<std::string>(uint32_t key)>;
+
+	ShaderPermutations(const std::string& vertexPath, const std::string& fragmentPath, DefinesForKey definesForKey);
+
+	// Submits the variant for deferred compilation if it does not exist yet; check IsReady() before drawing
+	Shader& Get(uint32_t key);
+	// Submits every listed variant so none of them has to compile mid-frame later
+	void Prewarm(const std::vector<uint32_t>& keys);
+	// Non-blocking, finalizes the variants that finished compiling
+	void Poll();
+	// Recompiles (deferred) the variants whose sources or includes were modified
+	void ReloadChanged();
+
+	// Brackets the draws made with one variant so its GPU cost shows up in DrawImGui()
+	GpuTimer& GetTimer(uint32_t key);
+	// Smoothed GPU time of every variant timed since the last Poll(), for comparing render paths
+	float GetFrameMilliseconds() const;
+
+	size_t GetCount() const { return m_Variants.size(); }
+	void DrawImGui(const char* title);
+
+private:
+	struct Variant
+	{
+		std::unique_ptr<Shader> m_shader;
+		std::unique_ptr<GpuTimer> m_timer;
+		std::string m_defines;
+		int m_lastUsedFrame = -1;
+	};
+
+	Variant& GetVariant(uint32_t key);
+
+private:
+	std::string m_VertexPath;
+	std::string m_FragmentPath;
+	DefinesForKey m_DefinesForKey;
+
+	std::unordered_map<uint32_t, Variant> m_Variants;
+	ShaderBatch m_Batch;
+	int m_Frame;
+};
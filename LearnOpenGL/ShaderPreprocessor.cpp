@@ -0,0 +1,198 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+#include "helpers/Hash.h"
+#include "helpers/Logger.h"
+
+std::unordered_map<uint64_t, ShaderPreprocessor::Result> ShaderPreprocessor::m_Cache;
+size_t ShaderPreprocessor::m_CacheHits = 0;
+size_t ShaderPreprocessor::m_CacheMisses = 0;
+
+namespace
+{
+	bool ReadFile(const std::string& path, std::string& contents)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+
+	uint64_t StampFile(const std::string& path)
+	{
+		std::error_code error;
+		uint64_t fileSize = std::filesystem::file_size(path, error);
+		auto writeTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		return HashBytes(&writeTime, sizeof(writeTime), HashBytes(&fileSize, sizeof(fileSize)));
+	}
+
+	// Directive name if the line is a preprocessor directive, e.g. "include" for `  #  include "a.glsl"`
+	std::string Directive(const std::string& line, size_t& argument)
+	{
+		size_t hash = line.find_first_not_of(" \t");
+		if (hash == std::string::npos || line[hash] != '#')
+			return "";
+
+		size_t nameBegin = line.find_first_not_of(" \t", hash + 1);
+		if (nameBegin == std::string::npos)
+			return "";
+
+		size_t nameEnd = line.find_first_of(" \t\r", nameBegin);
+		argument = nameEnd == std::string::npos ? line.size() : nameEnd;
+		return line.substr(nameBegin, argument - nameBegin);
+	}
+}
+
+ShaderPreprocessor::Result ShaderPreprocessor::Expand(const std::string& path)
+{
+	std::string source;
+	if (!ReadFile(path, source))
+	{
+		Logger::LogError("ShaderPreprocessor: could not read " + path);
+		return Result();
+	}
+
+	uint64_t key = HashBytes(path.data(), path.size(), HashBytes(source.data(), source.size()));
+	auto cached = m_Cache.find(key);
+	if (cached != m_Cache.end() && !HasChanged(cached->second.m_dependencies))
+	{
+		m_CacheHits++;
+		return cached->second;
+	}
+	m_CacheMisses++;
+
+	Result result;
+	result.m_files.push_back(path);
+	result.m_dependencies.push_back({ path, StampFile(path) });
+
+	std::vector<std::string> stack;
+	std::vector<std::string> included;
+	result.m_success = ExpandFile(path, source, 0, result, stack, included);
+
+	if (result.m_success)
+		m_Cache[key] = result;
+	return result;
+}
+
+bool ShaderPreprocessor::HasChanged(const std::vector<Dependency>& dependencies)
+{
+	for (const Dependency& dependency : dependencies)
+	{
+		if (StampFile(dependency.m_path) != dependency.m_stamp)
+			return true;
+	}
+	return false;
+}
+
+bool ShaderPreprocessor::ExpandFile(const std::string& path, const std::string& source, int fileIndex, Result& result,
+	std::vector<std::string>& stack, std::vector<std::string>& included)
+{
+	stack.push_back(path);
+
+	std::istringstream lines(source);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+
+		size_t argument = 0;
+		std::string directive = Directive(line, argument);
+
+		if (directive == "pragma" && line.find("once", argument) != std::string::npos)
+		{
+			included.push_back(path);
+			result.m_source += '\n'; // keep the line count intact
+			continue;
+		}
+
+		if (directive != "include")
+		{
+			result.m_source += line;
+			result.m_source += '\n';
+			continue;
+		}
+
+		size_t open = line.find('"', argument);
+		size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+		if (close == std::string::npos)
+		{
+			std::stringstream ss;
+			ss << "ShaderPreprocessor: " << path << ":" << lineNumber << ": expected #include \"file\"";
+			Logger::LogError(ss.str());
+			stack.pop_back();
+			return false;
+		}
+
+		std::string includePath = (std::filesystem::path(path).parent_path() / line.substr(open + 1, close - open - 1)).lexically_normal().generic_string();
+		if (std::find(included.begin(), included.end(), includePath) != included.end())
+		{
+			result.m_source += '\n';
+			continue;
+		}
+
+		if (std::find(stack.begin(), stack.end(), includePath) != stack.end())
+		{
+			Logger::LogError("ShaderPreprocessor: recursive include of " + includePath + " from " + path);
+			stack.pop_back();
+			return false;
+		}
+
+		std::string includeSource;
+		if (!ReadFile(includePath, includeSource))
+		{
+			std::stringstream ss;
+			ss << "ShaderPreprocessor: " << path << ":" << lineNumber << ": could not read " << includePath;
+			Logger::LogError(ss.str());
+			stack.pop_back();
+			return false;
+		}
+
+		int includeIndex = int(result.m_files.size());
+		result.m_files.push_back(includePath);
+		result.m_dependencies.push_back({ includePath, StampFile(includePath) });
+
+		result.m_source += "#line 1 " + std::to_string(includeIndex) + "\n";
+		if (!ExpandFile(includePath, includeSource, includeIndex, result, stack, included))
+		{
+			stack.pop_back();
+			return false;
+		}
+		result.m_source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+	}
+
+	stack.pop_back();
+	return true;
+}
+
+std::string ShaderPreprocessor::ResolveLog(const std::string& log, const std::vector<std::string>& files)
+{
+	// Mesa/AMD: "0:12(5): error", NVIDIA: "0(12) : error", both with the source string number first
+	static const std::regex location(R"((^|\n)(ERROR: |WARNING: )?(\d+)([:(])(\d+))");
+
+	std::string resolved;
+	auto last = log.cbegin();
+	for (std::sregex_iterator it(log.begin(), log.end(), location), end; it != end; ++it)
+	{
+		const std::smatch& match = *it;
+		size_t file = std::stoul(match[3].str());
+
+		resolved.append(last, match[0].first);
+		resolved += match[1].str() + match[2].str();
+		resolved += file < files.size() ? files[file] : match[3].str();
+		resolved += match[4].str() == ":" ? ":" : "(";
+		resolved += match[5].str();
+		last = match[0].second;
+	}
+	resolved.append(last, log.cend());
+	return resolved;
+}
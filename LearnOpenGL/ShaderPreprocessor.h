@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Expands #include "file" directives in GLSL (paths relative to the including file).
+// Files marked with #pragma once are only pasted the first time. Every file gets a source string
+// number in #line directives, so compile errors can be mapped back to the file they came from.
+// Expansions are cached by the content hash of the root file and reused until one of its files changes.
+class ShaderPreprocessor
+{
+public:
+	struct Dependency
+	{
+		std::string m_path;
+		uint64_t m_stamp; // size + modification time
+	};
+
+	struct Result
+	{
+		bool m_success = false;
+		std::string m_source;
+		// Index = source string number used in the #line directives, 0 is the root file
+		std::vector<std::string> m_files;
+		// Root file included
+		std::vector<Dependency> m_dependencies;
+	};
+
+public:
+	static Result Expand(const std::string& path);
+
+	// True if any of the files has been modified since the expansion
+	static bool HasChanged(const std::vector<Dependency>& dependencies);
+
+	// Rewrites "0:12(5): error" / "0(12) : error" style locations into "file.glsl:12(5): error"
+	static std::string ResolveLog(const std::string& log, const std::vector<std::string>& files);
+
+	static size_t GetCacheHits() { return m_CacheHits; }
+	static size_t GetCacheMisses() { return m_CacheMisses; }
+
+private:
+	static bool ExpandFile(const std::string& path, const std::string& source, int fileIndex, Result& result,
+		std::vector<std::string>& stack, std::vector<std::string>& included);
+
+private:
+	static std::unordered_map<uint64_t, Result> m_Cache;
+	static size_t m_CacheHits;
+	static size_t m_CacheMisses;
+};
@@ -0,0 +1,538 @@
+#include "ShadowAtlas.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "deps/imgui/imgui.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "SamplerCache.h"
+#include "UniformRing.h"
+#include "helpers/Logger.h"
+
+namespace
+{
+	const float NEAR_PLANE = 0.05f;
+	// Normal offset applied before the lookup, in shadow map texels
+	const float NORMAL_OFFSET_TEXELS = 1.5f;
+	// glPolygonOffset in the depth pass, on top of the normal offset
+	const float SLOPE_BIAS = 2.0f;
+	const float CONSTANT_BIAS = 4.0f;
+	// Frames a light has to want another tile size before it is moved, so lights near a size
+	// boundary do not bounce between tiles (and get re-rendered) every frame
+	const int RESIZE_DELAY = 30;
+
+	// Cube face order of include/shadow_atlas.glsl: +X, -X, +Y, -Y, +Z, -Z
+	const glm::vec3 FACE_DIRECTIONS[6] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const glm::vec3 FACE_UPS[6] = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+
+	// Whether a sphere, relative to the light, reaches into the 90 degree frustum of a cube face
+	bool SphereTouchesFace(const glm::vec3& center, float radius, int face)
+	{
+		const glm::vec3& axis = FACE_DIRECTIONS[face];
+		const glm::vec3& u = FACE_UPS[face];
+		glm::vec3 v = glm::cross(axis, u);
+		float forward = glm::dot(center, axis);
+		float limit = radius * std::sqrt(2.0f);
+		return std::abs(glm::dot(center, u)) - forward <= limit && std::abs(glm::dot(center, v)) - forward <= limit;
+	}
+
+	int LargestPowerOfTwoBelow(float value)
+	{
+		return 1 << std::max(0, int(std::floor(std::log2(std::max(value, 1.0f)))));
+	}
+}
+
+void ShadowAtlas::TileAllocator::Reset(int size, int minSize)
+{
+	m_Size = size;
+	m_LevelCount = LevelOf(minSize) + 1;
+	m_Free.assign(m_LevelCount, {});
+	for (int level = 0; level < m_LevelCount; level++)
+	{
+		// The most squares a level can ever hold, so allocating never grows them
+		m_Free[level].reserve(size_t(1) << (2 * level));
+	}
+	m_Free[0].push_back(glm::ivec2(0));
+}
+
+bool ShadowAtlas::TileAllocator::Allocate(int size, glm::ivec2& origin)
+{
+	int level = LevelOf(size);
+	if (level < 0 || level >= m_LevelCount)
+		return false;
+
+	// Smallest free square that is big enough
+	int from = level;
+	while (from >= 0 && m_Free[from].empty())
+		from--;
+	if (from < 0)
+		return false;
+
+	glm::ivec2 square = m_Free[from].back();
+	m_Free[from].pop_back();
+
+	// Split it down, keeping the first quarter and freeing the other three each time
+	for (int split = from + 1; split <= level; split++)
+	{
+		int half = m_Size >> split;
+		m_Free[split].push_back(square + glm::ivec2(half, 0));
+		m_Free[split].push_back(square + glm::ivec2(0, half));
+		m_Free[split].push_back(square + glm::ivec2(half, half));
+	}
+
+	origin = square;
+	return true;
+}
+
+void ShadowAtlas::TileAllocator::Free(const glm::ivec2& origin, int size)
+{
+	glm::ivec2 square = origin;
+	int level = LevelOf(size);
+
+	// Merge with the buddies for as long as all four quarters are free
+	while (level > 0)
+	{
+		int parentSize = m_Size >> (level - 1);
+		glm::ivec2 parent(square.x & ~(parentSize - 1), square.y & ~(parentSize - 1));
+		int half = parentSize / 2;
+
+		std::vector<glm::ivec2>& free = m_Free[level];
+		int buddies = 0;
+		for (const glm::ivec2& quarter : { parent, parent + glm::ivec2(half, 0), parent + glm::ivec2(0, half), parent + glm::ivec2(half, half) })
+		{
+			if (quarter != square && std::find(free.begin(), free.end(), quarter) != free.end())
+				buddies++;
+		}
+		if (buddies < 3)
+			break;
+
+		free.erase(std::remove_if(free.begin(), free.end(), [&](const glm::ivec2& other)
+		{
+			return other.x >= parent.x && other.x < parent.x + parentSize && other.y >= parent.y && other.y < parent.y + parentSize;
+		}), free.end());
+		square = parent;
+		level--;
+	}
+
+	m_Free[level].push_back(square);
+}
+
+int ShadowAtlas::TileAllocator::GetFreeArea() const
+{
+	int area = 0;
+	for (int level = 0; level < m_LevelCount; level++)
+	{
+		int size = m_Size >> level;
+		area += int(m_Free[level].size()) * size * size;
+	}
+	return area;
+}
+
+int ShadowAtlas::TileAllocator::LevelOf(int size) const
+{
+	int level = 0;
+	while ((m_Size >> level) > size)
+		level++;
+	return level;
+}
+
+ShadowAtlas::ShadowAtlas(int size)
+	: m_Size(size)
+	, m_Depth(0)
+	, m_Framebuffer(0)
+	, m_DepthShader("res/shaders/shadow_depth_vertex.glsl", "res/shaders/shadow_depth_fragment.glsl")
+	, m_Block()
+	, m_UpdateBudget(6)
+	, m_RenderedLastFrame(0)
+	, m_DirtyBacklog(0)
+	, m_CpuMilliseconds(0.0f)
+{
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_Depth);
+	glTextureStorage2D(m_Depth, 1, GL_DEPTH_COMPONENT24, m_Size, m_Size);
+	GpuMemoryTracker::TrackTexture(m_Depth, GpuMemoryTracker::TextureBytes(m_Size, m_Size, 1, 4, 1), GpuMemoryCategory::Attachment, "ShadowAtlas", "GL_DEPTH_COMPONENT24");
+
+	glCreateFramebuffers(1, &m_Framebuffer);
+	glNamedFramebufferTexture(m_Framebuffer, GL_DEPTH_ATTACHMENT, m_Depth, 0);
+	glNamedFramebufferDrawBuffer(m_Framebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(m_Framebuffer, GL_NONE);
+	if (glCheckNamedFramebufferStatus(m_Framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		Logger::LogError("ShadowAtlas: framebuffer is not complete");
+
+	m_Allocator.Reset(m_Size, MIN_TILE_SIZE);
+
+	for (int i = 0; i <= MAX_POINT_LIGHTS; i++)
+	{
+		Light& light = m_Lights[i];
+		light = {};
+		light.m_point = i < MAX_POINT_LIGHTS;
+		light.m_tileCount = light.m_point ? 6 : 1;
+	}
+	m_Schedule.reserve((MAX_POINT_LIGHTS + 1) * 6);
+
+	m_Block.atlasParams = glm::vec4(1.0f / float(m_Size), NORMAL_OFFSET_TEXELS, 0.0f, 0.0f);
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+	glDeleteFramebuffers(1, &m_Framebuffer);
+	GpuMemoryTracker::UntrackTexture(m_Depth);
+	glDeleteTextures(1, &m_Depth);
+	GLState::Invalidate();
+}
+
+void ShadowAtlas::SetPointLight(int index, bool enabled, const glm::vec3& position, float radius)
+{
+	SetLight(m_Lights[index], enabled, true, position, glm::vec3(0.0f), 0.0f, radius);
+}
+
+void ShadowAtlas::SetSpotLight(bool enabled, const glm::vec3& position, const glm::vec3& direction, float outerCutOff, float radius)
+{
+	SetLight(m_Lights[MAX_POINT_LIGHTS], enabled, false, position, direction, outerCutOff, radius);
+}
+
+void ShadowAtlas::SetLight(Light& light, bool enabled, bool point, const glm::vec3& position, const glm::vec3& direction, float outerCutOff, float radius)
+{
+	if (!enabled)
+	{
+		if (light.m_enabled)
+			FreeTiles(light);
+		light.m_enabled = false;
+		return;
+	}
+
+	bool changed = !light.m_enabled || position != light.m_position || radius != light.m_radius
+		|| (!point && (direction != light.m_direction || outerCutOff != light.m_outerCutOff));
+	light.m_enabled = true;
+	if (!changed)
+		return;
+
+	light.m_position = position;
+	light.m_direction = direction;
+	light.m_outerCutOff = outerCutOff;
+	light.m_radius = radius;
+	if (light.m_tileSize > 0)
+		UpdateViewProjections(light);
+}
+
+void ShadowAtlas::MarkDirty(const glm::vec3& center, float radius)
+{
+	for (Light& light : m_Lights)
+	{
+		if (!light.m_enabled || light.m_tileSize == 0)
+			continue;
+
+		glm::vec3 offset = center - light.m_position;
+		float reach = radius + light.m_radius;
+		if (glm::dot(offset, offset) > reach * reach)
+			continue;
+
+		for (int i = 0; i < light.m_tileCount; i++)
+		{
+			if (!light.m_point || SphereTouchesFace(offset, radius, i))
+				light.m_tiles[i].m_dirty = true;
+		}
+	}
+}
+
+void ShadowAtlas::MarkAllDirty()
+{
+	for (Light& light : m_Lights)
+	{
+		for (Tile& tile : light.m_tiles)
+		{
+			tile.m_dirty = true;
+		}
+	}
+}
+
+void ShadowAtlas::Update(const glm::vec3& cameraPosition)
+{
+	// Importance is how big the light's range looks from the camera, which sets its tile size:
+	// the largest tile once the camera is within range, half of it for every doubling of distance
+	int order[MAX_POINT_LIGHTS + 1];
+	int orderCount = 0;
+	for (int i = 0; i <= MAX_POINT_LIGHTS; i++)
+	{
+		Light& light = m_Lights[i];
+		if (!light.m_enabled)
+			continue;
+
+		float distance = glm::length(light.m_position - cameraPosition);
+		light.m_importance = light.m_radius / std::max(distance, NEAR_PLANE);
+		int halvings = light.m_importance >= 1.0f ? 0 : int(std::ceil(-std::log2(light.m_importance)));
+		light.m_desiredTileSize = std::max(MAX_TILE_SIZE >> std::min(halvings, 16), MIN_TILE_SIZE);
+		order[orderCount++] = i;
+	}
+	std::sort(order, order + orderCount, [this](int a, int b) { return m_Lights[a].m_importance > m_Lights[b].m_importance; });
+
+	// Most important first, so when the atlas runs out the least important lights go without
+	for (int i = 0; i < orderCount; i++)
+	{
+		Light& light = m_Lights[order[i]];
+		if (light.m_tileSize != 0)
+		{
+			light.m_framesWantingResize = light.m_desiredTileSize != light.m_tileSize ? light.m_framesWantingResize + 1 : 0;
+			if (light.m_framesWantingResize < RESIZE_DELAY)
+				continue;
+			FreeTiles(light);
+		}
+
+		while (!AllocateTiles(light, light.m_desiredTileSize))
+		{
+			// Take the tiles of the least important light that has some
+			Light* victim = nullptr;
+			for (int j = orderCount - 1; j > i && !victim; j--)
+			{
+				if (m_Lights[order[j]].m_tileSize != 0)
+					victim = &m_Lights[order[j]];
+			}
+			if (!victim)
+				break;
+			FreeTiles(*victim);
+		}
+	}
+
+	// Never rendered tiles first (they are unshadowed until then), then by importance
+	m_Schedule.clear();
+	for (int i = 0; i < orderCount; i++)
+	{
+		const Light& light = m_Lights[order[i]];
+		if (light.m_tileSize == 0)
+			continue;
+		for (int tile = 0; tile < light.m_tileCount; tile++)
+		{
+			if (!light.m_tiles[tile].m_rendered)
+				m_Schedule.push_back(glm::ivec2(order[i], tile));
+		}
+	}
+	for (int i = 0; i < orderCount; i++)
+	{
+		const Light& light = m_Lights[order[i]];
+		if (light.m_tileSize == 0)
+			continue;
+		for (int tile = 0; tile < light.m_tileCount; tile++)
+		{
+			if (light.m_tiles[tile].m_rendered && light.m_tiles[tile].m_dirty)
+				m_Schedule.push_back(glm::ivec2(order[i], tile));
+		}
+	}
+
+	m_DirtyBacklog = std::max(int(m_Schedule.size()) - m_UpdateBudget, 0);
+	if (int(m_Schedule.size()) > m_UpdateBudget)
+		m_Schedule.resize(m_UpdateBudget);
+}
+
+void ShadowAtlas::Render(const std::function<void(const Shader&)>& drawCasters)
+{
+	m_RenderedLastFrame = 0;
+	if (!m_Schedule.empty() && m_DepthShader.IsReady())
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		m_Timer.Begin();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+		GLState::SetDepthTest(true);
+		GLState::SetDepthMask(true);
+		GLState::SetDepthFunc(GL_LESS);
+		// Clears honour the scissor, so each tile is cleared on its own
+		glEnable(GL_SCISSOR_TEST);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+		m_DepthShader.Use();
+
+		const float farDepth = 1.0f;
+		for (const glm::ivec2& entry : m_Schedule)
+		{
+			Light& light = m_Lights[entry.x];
+			Tile& tile = light.m_tiles[entry.y];
+
+			glViewport(tile.m_origin.x, tile.m_origin.y, light.m_tileSize, light.m_tileSize);
+			glScissor(tile.m_origin.x, tile.m_origin.y, light.m_tileSize, light.m_tileSize);
+			glClearNamedFramebufferfv(m_Framebuffer, GL_DEPTH, 0, &farDepth);
+			m_DepthShader.SetMat4("lightViewProjection", tile.m_viewProjection);
+			drawCasters(m_DepthShader);
+
+			tile.m_rendered = true;
+			tile.m_dirty = false;
+			m_RenderedLastFrame++;
+		}
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glDisable(GL_SCISSOR_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		m_Timer.End();
+		m_CpuMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+	}
+
+	WriteBlock();
+}
+
+void ShadowAtlas::Bind(UniformRing& uniforms) const
+{
+	SamplerDesc sampler;
+	sampler.m_filter = SamplerFilter::Bilinear;
+	sampler.m_wrap = SamplerWrap::ClampToEdge;
+	sampler.m_depthCompare = true;
+
+	GLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, m_Depth);
+	SamplerCache::Bind(TEXTURE_UNIT, sampler);
+	uniforms.Bind<ShadowAtlasBlock>(UNIFORM_BINDING, uniforms.Push(m_Block));
+}
+
+void ShadowAtlas::ReloadShaders()
+{
+	m_DepthShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+}
+
+void ShadowAtlas::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	ImGui::SliderInt("Tile updates per frame", &m_UpdateBudget, 1, 36);
+	if (ImGui::Button("Mark every tile dirty"))
+		MarkAllDirty();
+
+	int usedArea = m_Size * m_Size - m_Allocator.GetFreeArea();
+	ImGui::Text("%d x %d atlas, %.1f%% allocated", m_Size, m_Size, 100.0f * float(usedArea) / float(m_Size * m_Size));
+	ImGui::Text("%d tiles rendered this frame, %d still waiting", m_RenderedLastFrame, m_DirtyBacklog);
+	ImGui::Text("Last update: CPU %.3f ms, GPU %.3f ms", m_CpuMilliseconds, m_Timer.GetMilliseconds());
+	ImGui::Separator();
+
+	ImGui::Columns(4, "lights");
+	ImGui::Text("Light"); ImGui::NextColumn();
+	ImGui::Text("Importance"); ImGui::NextColumn();
+	ImGui::Text("Tile"); ImGui::NextColumn();
+	ImGui::Text("Dirty"); ImGui::NextColumn();
+	ImGui::Separator();
+	for (int i = 0; i <= MAX_POINT_LIGHTS; i++)
+	{
+		const Light& light = m_Lights[i];
+		if (!light.m_enabled)
+			continue;
+
+		int dirty = 0;
+		for (int tile = 0; tile < light.m_tileCount; tile++)
+		{
+			if (light.m_tiles[tile].m_dirty || !light.m_tiles[tile].m_rendered)
+				dirty++;
+		}
+
+		if (light.m_point)
+			ImGui::Text("Point %d", i);
+		else
+			ImGui::Text("Spot");
+		ImGui::NextColumn();
+		ImGui::Text("%.2f", light.m_importance); ImGui::NextColumn();
+		if (light.m_tileSize != 0)
+			ImGui::Text("%d x %d", light.m_tileCount, light.m_tileSize);
+		else
+			ImGui::Text("none");
+		ImGui::NextColumn();
+		ImGui::Text("%d", light.m_tileSize != 0 ? dirty : 0); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::End();
+}
+
+bool ShadowAtlas::AllocateTiles(Light& light, int tileSize)
+{
+	for (int size = tileSize; size >= MIN_TILE_SIZE; size /= 2)
+	{
+		int allocated = 0;
+		while (allocated < light.m_tileCount && m_Allocator.Allocate(size, light.m_tiles[allocated].m_origin))
+			allocated++;
+
+		if (allocated == light.m_tileCount)
+		{
+			light.m_tileSize = size;
+			light.m_framesWantingResize = 0;
+			for (int i = 0; i < light.m_tileCount; i++)
+			{
+				light.m_tiles[i].m_rendered = false;
+				light.m_tiles[i].m_dirty = true;
+			}
+			UpdateViewProjections(light);
+			return true;
+		}
+
+		for (int i = 0; i < allocated; i++)
+		{
+			m_Allocator.Free(light.m_tiles[i].m_origin, size);
+		}
+	}
+	return false;
+}
+
+void ShadowAtlas::FreeTiles(Light& light)
+{
+	if (light.m_tileSize == 0)
+		return;
+
+	for (int i = 0; i < light.m_tileCount; i++)
+	{
+		m_Allocator.Free(light.m_tiles[i].m_origin, light.m_tileSize);
+		light.m_tiles[i].m_rendered = false;
+	}
+	light.m_tileSize = 0;
+	light.m_framesWantingResize = 0;
+}
+
+void ShadowAtlas::UpdateViewProjections(Light& light)
+{
+	if (light.m_point)
+	{
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, light.m_radius);
+		for (int face = 0; face < 6; face++)
+		{
+			light.m_tiles[face].m_viewProjection = projection * glm::lookAt(light.m_position, light.m_position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+			light.m_tiles[face].m_dirty = true;
+		}
+	}
+	else
+	{
+		float fov = 2.0f * std::acos(std::clamp(light.m_outerCutOff, -1.0f, 1.0f));
+		glm::vec3 up = std::abs(light.m_direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::mat4 projection = glm::perspective(std::min(fov, glm::radians(170.0f)), 1.0f, NEAR_PLANE, light.m_radius);
+		light.m_tiles[0].m_viewProjection = projection * glm::lookAt(light.m_position, light.m_position + light.m_direction, up);
+		light.m_tiles[0].m_dirty = true;
+	}
+}
+
+void ShadowAtlas::WriteBlock()
+{
+	for (int i = 0; i <= MAX_POINT_LIGHTS; i++)
+	{
+		const Light& light = m_Lights[i];
+		for (int tile = 0; tile < light.m_tileCount; tile++)
+		{
+			ShadowTileStd140& out = light.m_point ? m_Block.pointShadowTiles[i * 6 + tile] : m_Block.spotShadowTile;
+			const Tile& in = light.m_tiles[tile];
+			if (!light.m_enabled || light.m_tileSize == 0 || !in.m_rendered)
+			{
+				out.rect = glm::vec4(0.0f);
+				continue;
+			}
+
+			// Sampled with the matrix the depth was rendered with, until the tile is re-rendered
+			if (!in.m_dirty)
+				out.viewProjection = in.m_viewProjection;
+
+			float tanHalfFov = light.m_point ? 1.0f : std::tan(0.5f * std::min(2.0f * std::acos(light.m_outerCutOff), glm::radians(170.0f)));
+			out.rect = glm::vec4(glm::vec2(in.m_origin) / float(m_Size), float(light.m_tileSize) / float(m_Size), 2.0f * tanHalfFov / float(light.m_tileSize));
+		}
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+#include "GpuTimer.h"
+#include "Shader.h"
+#include "UniformBlocks.h"
+
+class UniformRing;
+
+// Shadows of the point lights and the spotlight, all rendered into tiles of one depth atlas
+// instead of a cubemap per light. A spotlight takes one tile, a point light six (one per cube face).
+//
+// Tile sizes follow each light's importance, its range over its distance to the camera, and are
+// handed out by a buddy allocator, so lights keep their tiles from frame to frame. When the atlas
+// is full, the least important lights get smaller tiles or none at all.
+//
+// Tiles are only re-rendered when something inside them changed: the light moved, or a caster
+// moved through it (reported with MarkDirty()). At most the update budget of tiles is rendered per
+// frame, most important first, so the cost stays bounded no matter how many lights are dirty.
+// Tiles that were never rendered are sampled as unshadowed until their turn comes.
+//
+// The lit shaders read the result through include/shadow_atlas.glsl.
+class ShadowAtlas
+{
+public:
+	static const int MAX_POINT_LIGHTS = ShadowAtlasBlock::MAX_POINT_LIGHTS;
+	static const int MIN_TILE_SIZE = 128;
+	static const int MAX_TILE_SIZE = 1024;
+	// Texture unit and uniform block binding include/shadow_atlas.glsl expects
+	static const unsigned int TEXTURE_UNIT = 9;
+	static const unsigned int UNIFORM_BINDING = 4;
+
+	explicit ShadowAtlas(int size = 4096);
+	~ShadowAtlas();
+
+	ShadowAtlas(const ShadowAtlas&) = delete;
+	ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+	// The shadowed lights, set every frame. Disabled lights give their tiles back.
+	void SetPointLight(int index, bool enabled, const glm::vec3& position, float radius);
+	void SetSpotLight(bool enabled, const glm::vec3& position, const glm::vec3& direction, float outerCutOff, float radius);
+	// A caster moved through this sphere, call it with both its old and its new bounds
+	void MarkDirty(const glm::vec3& center, float radius);
+	void MarkAllDirty();
+
+	// Sizes and allocates the tiles and picks the ones to render this frame
+	void Update(const glm::vec3& cameraPosition);
+	// Renders the tiles Update() picked. drawCasters is called once per tile with the depth program
+	// bound and must set "model" for every draw. Leaves the viewport for the caller to restore.
+	void Render(const std::function<void(const Shader&)>& drawCasters);
+	// Binds the atlas, and this frame's ShadowAtlas block from uniforms, for the lit programs
+	void Bind(UniformRing& uniforms) const;
+
+	void ReloadShaders();
+	void DrawImGui(const char* title);
+
+	int GetSize() const { return m_Size; }
+
+private:
+	struct Tile
+	{
+		glm::ivec2 m_origin;
+		glm::mat4 m_viewProjection;
+		bool m_rendered;	// holds a valid depth map
+		bool m_dirty;		// the depth map is out of date
+	};
+
+	struct Light
+	{
+		bool m_enabled;
+		bool m_point;
+		glm::vec3 m_position;
+		glm::vec3 m_direction;
+		float m_outerCutOff;
+		float m_radius;
+
+		float m_importance;
+		int m_tileSize;				// 0 = no tiles
+		int m_desiredTileSize;
+		int m_framesWantingResize;
+		int m_tileCount;			// 6 for point lights, 1 for the spotlight
+		Tile m_tiles[6];
+	};
+
+	// Hands out power of two squares of the atlas, splitting and merging buddies
+	class TileAllocator
+	{
+	public:
+		void Reset(int size, int minSize);
+		bool Allocate(int size, glm::ivec2& origin);
+		void Free(const glm::ivec2& origin, int size);
+		int GetFreeArea() const;
+
+	private:
+		int LevelOf(int size) const;
+
+	private:
+		int m_Size = 0;
+		int m_LevelCount = 0;
+		// Free squares of every level, level 0 being the whole atlas
+		std::vector<std::vector<glm::ivec2>> m_Free;
+	};
+
+	void SetLight(Light& light, bool enabled, bool point, const glm::vec3& position, const glm::vec3& direction, float outerCutOff, float radius);
+	bool AllocateTiles(Light& light, int tileSize);
+	void FreeTiles(Light& light);
+	void UpdateViewProjections(Light& light);
+	void WriteBlock();
+
+private:
+	int m_Size;
+	unsigned int m_Depth;
+	unsigned int m_Framebuffer;
+	Shader m_DepthShader;
+	TileAllocator m_Allocator;
+
+	// Slots 0 to MAX_POINT_LIGHTS - 1 are the point lights, the last one the spotlight
+	Light m_Lights[MAX_POINT_LIGHTS + 1];
+	// (light, tile) pairs to render this frame, reused so scheduling does not allocate
+	std::vector<glm::ivec2> m_Schedule;
+
+	ShadowAtlasBlock m_Block;
+
+	int m_UpdateBudget;
+	int m_RenderedLastFrame;
+	int m_DirtyBacklog;
+	float m_CpuMilliseconds;
+	GpuTimer m_Timer;
+};
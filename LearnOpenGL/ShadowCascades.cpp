@@ -0,0 +1,286 @@
+#include "ShadowCascades.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "deps/imgui/imgui.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "SamplerCache.h"
+#include "UniformRing.h"
+#include "helpers/Logger.h"
+
+namespace
+{
+	// Normal offset applied before the lookup, in shadow map texels
+	const float NORMAL_OFFSET_TEXELS = 1.5f;
+	// Shadows fade out over the last part of the shadow distance instead of ending on a hard line
+	const float FADE_START = 0.9f;
+	// glPolygonOffset in the depth pass, on top of the normal offset
+	const float SLOPE_BIAS = 2.0f;
+	const float CONSTANT_BIAS = 2.0f;
+}
+
+ShadowCascades::ShadowCascades(int resolution)
+	: m_Resolution(resolution)
+	, m_DepthArray(0)
+	, m_DepthShader("res/shaders/shadow_depth_vertex.glsl", "res/shaders/shadow_depth_fragment.glsl")
+	, m_Block()
+	, m_ShadowDistance(40.0f)
+	, m_SplitLambda(0.75f)
+	, m_CacheSlack(1.25f)
+	, m_CachingEnabled(true)
+	, m_RefreshInterval(8)
+	, m_LightDirection(0.0f)
+	, m_LightRotation(1.0f)
+	, m_CacheValid(false)
+	, m_Frame(0)
+	, m_NextRefresh(FIRST_CACHED_CASCADE)
+	, m_RenderedLastFrame(0)
+{
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_DepthArray);
+	glTextureStorage3D(m_DepthArray, 1, GL_DEPTH_COMPONENT24, m_Resolution, m_Resolution, CASCADE_COUNT);
+	GpuMemoryTracker::TrackTexture(m_DepthArray, GpuMemoryTracker::TextureBytes(m_Resolution, m_Resolution, CASCADE_COUNT, 4, 1), GpuMemoryCategory::Attachment, "ShadowCascades", "GL_DEPTH_COMPONENT24");
+
+	for (int i = 0; i < CASCADE_COUNT; i++)
+	{
+		Cascade& cascade = m_Cascades[i];
+		cascade.m_center = glm::vec3(0.0f);
+		cascade.m_radius = 0.0f;
+		cascade.m_renderedCenter = glm::vec3(0.0f);
+		cascade.m_renderedRadius = 0.0f;
+		cascade.m_viewProjection = glm::mat4(1.0f);
+		cascade.m_renderThisFrame = false;
+		cascade.m_lastRenderedFrame = -1;
+		cascade.m_cpuMilliseconds = 0.0f;
+
+		// Depth only, one framebuffer per layer so a cascade is rendered with a single bind
+		glCreateFramebuffers(1, &cascade.m_framebuffer);
+		glNamedFramebufferTextureLayer(cascade.m_framebuffer, GL_DEPTH_ATTACHMENT, m_DepthArray, 0, i);
+		glNamedFramebufferDrawBuffer(cascade.m_framebuffer, GL_NONE);
+		glNamedFramebufferReadBuffer(cascade.m_framebuffer, GL_NONE);
+
+		if (glCheckNamedFramebufferStatus(cascade.m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			Logger::LogError("ShadowCascades: framebuffer is not complete");
+	}
+}
+
+ShadowCascades::~ShadowCascades()
+{
+	for (Cascade& cascade : m_Cascades)
+	{
+		glDeleteFramebuffers(1, &cascade.m_framebuffer);
+	}
+	GpuMemoryTracker::UntrackTexture(m_DepthArray);
+	glDeleteTextures(1, &m_DepthArray);
+	GLState::Invalidate();
+}
+
+void ShadowCascades::Update(const glm::mat4& view, float fovY, float aspect, float nearPlane, const glm::vec3& lightDirection)
+{
+	m_Frame++;
+
+	glm::vec3 direction = glm::normalize(lightDirection);
+	if (direction != m_LightDirection)
+	{
+		m_LightDirection = direction;
+		glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		m_LightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+		m_CacheValid = false;
+	}
+
+	// The round-robin refresh of the cached cascades, one every m_RefreshInterval frames
+	int refresh = -1;
+	if (m_CachingEnabled && m_RefreshInterval > 0 && m_Frame % m_RefreshInterval == 0)
+	{
+		refresh = m_NextRefresh;
+		m_NextRefresh = m_NextRefresh + 1 < CASCADE_COUNT ? m_NextRefresh + 1 : FIRST_CACHED_CASCADE;
+	}
+
+	const glm::mat4 inverseView = glm::inverse(view);
+	float sliceNear = nearPlane;
+	for (int i = 0; i < CASCADE_COUNT; i++)
+	{
+		// Practical split scheme: a blend of uniform and logarithmic splits
+		float fraction = float(i + 1) / float(CASCADE_COUNT);
+		float uniformSplit = nearPlane + (m_ShadowDistance - nearPlane) * fraction;
+		float logSplit = nearPlane * std::pow(m_ShadowDistance / nearPlane, fraction);
+		float sliceFar = uniformSplit + (logSplit - uniformSplit) * m_SplitLambda;
+
+		Cascade& cascade = m_Cascades[i];
+		FitCascade(cascade, inverseView, fovY, aspect, sliceNear, sliceFar);
+
+		if (m_CachingEnabled && i >= FIRST_CACHED_CASCADE)
+		{
+			bool covered = m_CacheValid && cascade.m_lastRenderedFrame >= 0
+				&& glm::length(cascade.m_center - cascade.m_renderedCenter) + cascade.m_radius <= cascade.m_renderedRadius;
+			cascade.m_renderThisFrame = !covered || i == refresh;
+			if (cascade.m_renderThisFrame)
+			{
+				cascade.m_renderedCenter = cascade.m_center;
+				cascade.m_renderedRadius = cascade.m_radius * m_CacheSlack;
+			}
+		}
+		else
+		{
+			cascade.m_renderThisFrame = true;
+			cascade.m_renderedCenter = cascade.m_center;
+			cascade.m_renderedRadius = cascade.m_radius;
+		}
+
+		if (cascade.m_renderThisFrame)
+			cascade.m_viewProjection = MakeViewProjection(cascade.m_renderedCenter, cascade.m_renderedRadius);
+
+		m_Block.cascadeViewProjections[i] = cascade.m_viewProjection;
+		m_Block.cascadeSplits[i] = sliceFar;
+		m_Block.cascadeTexelSizes[i] = 2.0f * cascade.m_renderedRadius / float(m_Resolution);
+		sliceNear = sliceFar;
+	}
+	m_CacheValid = true;
+
+	m_Block.shadowParams = glm::vec4(NORMAL_OFFSET_TEXELS, m_ShadowDistance * FADE_START, 0.0f, 0.0f);
+}
+
+void ShadowCascades::Render(const std::function<void(const Shader&)>& drawCasters)
+{
+	m_RenderedLastFrame = 0;
+	if (!m_DepthShader.IsReady())
+		return;
+
+	glViewport(0, 0, m_Resolution, m_Resolution);
+	GLState::SetDepthTest(true);
+	GLState::SetDepthMask(true);
+	GLState::SetDepthFunc(GL_LESS);
+	// Casters between the light and the cascade's near plane are clamped onto it instead of
+	// clipped, so the depth range only has to cover the receivers
+	glEnable(GL_DEPTH_CLAMP);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+	m_DepthShader.Use();
+
+	const float farDepth = 1.0f;
+	for (Cascade& cascade : m_Cascades)
+	{
+		if (!cascade.m_renderThisFrame)
+			continue;
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		cascade.m_timer.Begin();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, cascade.m_framebuffer);
+		glClearNamedFramebufferfv(cascade.m_framebuffer, GL_DEPTH, 0, &farDepth);
+		m_DepthShader.SetMat4("lightViewProjection", cascade.m_viewProjection);
+		drawCasters(m_DepthShader);
+
+		cascade.m_timer.End();
+		cascade.m_cpuMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - begin).count();
+		cascade.m_lastRenderedFrame = m_Frame;
+		m_RenderedLastFrame++;
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_DEPTH_CLAMP);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowCascades::Bind(UniformRing& uniforms) const
+{
+	SamplerDesc sampler;
+	sampler.m_filter = SamplerFilter::Bilinear;
+	sampler.m_wrap = SamplerWrap::ClampToEdge;
+	sampler.m_depthCompare = true;
+
+	GLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, m_DepthArray);
+	SamplerCache::Bind(TEXTURE_UNIT, sampler);
+	uniforms.Bind<ShadowsBlock>(UNIFORM_BINDING, uniforms.Push(m_Block));
+}
+
+void ShadowCascades::ReloadShaders()
+{
+	m_DepthShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+}
+
+void ShadowCascades::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	if (ImGui::SliderFloat("Shadow distance", &m_ShadowDistance, 5.0f, 200.0f))
+		m_CacheValid = false;
+	if (ImGui::SliderFloat("Split lambda", &m_SplitLambda, 0.0f, 1.0f))
+		m_CacheValid = false;
+	if (ImGui::Checkbox("Cache distant cascades", &m_CachingEnabled))
+		m_CacheValid = false;
+	if (m_CachingEnabled)
+	{
+		if (ImGui::SliderFloat("Cache slack", &m_CacheSlack, 1.0f, 2.0f))
+			m_CacheValid = false;
+		ImGui::SliderInt("Refresh every n frames", &m_RefreshInterval, 0, 60);
+	}
+	if (ImGui::Button("Invalidate cache"))
+		m_CacheValid = false;
+
+	ImGui::Text("%d of %d cascades rendered this frame, %d x %d", m_RenderedLastFrame, CASCADE_COUNT, m_Resolution, m_Resolution);
+	ImGui::Separator();
+
+	ImGui::Columns(5, "cascades");
+	ImGui::Text("Cascade"); ImGui::NextColumn();
+	ImGui::Text("Split"); ImGui::NextColumn();
+	ImGui::Text("Age"); ImGui::NextColumn();
+	ImGui::Text("CPU ms"); ImGui::NextColumn();
+	ImGui::Text("GPU ms"); ImGui::NextColumn();
+	ImGui::Separator();
+	float totalCpu = 0.0f;
+	float totalGpu = 0.0f;
+	for (int i = 0; i < CASCADE_COUNT; i++)
+	{
+		const Cascade& cascade = m_Cascades[i];
+		// CPU and GPU times are of the last time the cascade was rendered
+		ImGui::Text("%d%s", i, i >= FIRST_CACHED_CASCADE && m_CachingEnabled ? " (cached)" : ""); ImGui::NextColumn();
+		ImGui::Text("%.1f", m_Block.cascadeSplits[i]); ImGui::NextColumn();
+		ImGui::Text("%d", cascade.m_lastRenderedFrame >= 0 ? m_Frame - cascade.m_lastRenderedFrame : -1); ImGui::NextColumn();
+		ImGui::Text("%.3f", cascade.m_cpuMilliseconds); ImGui::NextColumn();
+		ImGui::Text("%.3f", cascade.m_timer.GetMilliseconds()); ImGui::NextColumn();
+		if (cascade.m_renderThisFrame)
+		{
+			totalCpu += cascade.m_cpuMilliseconds;
+			totalGpu += cascade.m_timer.GetMilliseconds();
+		}
+	}
+	ImGui::Columns(1);
+	ImGui::Text("This frame: CPU %.3f ms, GPU %.3f ms", totalCpu, totalGpu);
+	ImGui::End();
+}
+
+void ShadowCascades::FitCascade(Cascade& cascade, const glm::mat4& inverseView, float fovY, float aspect, float sliceNear, float sliceFar) const
+{
+	// Smallest sphere through the slice's corners. It only depends on the projection, never on
+	// the camera's orientation, which keeps the cascade's texel size fixed while looking around.
+	float tanHalfFov = std::tan(fovY * 0.5f);
+	float diagonalSq = tanHalfFov * tanHalfFov * (1.0f + aspect * aspect);
+	float centerDepth = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + diagonalSq), sliceFar);
+	float farOffset = sliceFar - centerDepth;
+	float radius = std::sqrt(farOffset * farOffset + sliceFar * sliceFar * diagonalSq);
+
+	glm::vec3 position = glm::vec3(inverseView[3]);
+	glm::vec3 forward = -glm::vec3(inverseView[2]);
+	cascade.m_center = position + forward * centerDepth;
+	cascade.m_radius = radius;
+}
+
+glm::mat4 ShadowCascades::MakeViewProjection(const glm::vec3& center, float radius) const
+{
+	// Snap the center to whole texels in light space, so a moving camera shifts the shadow map
+	// by exact texels and every caster rasterizes the same way it did last frame
+	glm::vec3 lightCenter = glm::vec3(m_LightRotation * glm::vec4(center, 1.0f));
+	float texelSize = 2.0f * radius / float(m_Resolution);
+	lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+	lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+	// Light space looks down -z, so the receivers span [center.z - radius, center.z + radius]
+	glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+		-(lightCenter.z + radius), -(lightCenter.z - radius));
+	return projection * m_LightRotation;
+}
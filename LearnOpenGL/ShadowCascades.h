@@ -0,0 +1,99 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <functional>
+
+#include "GpuTimer.h"
+#include "Shader.h"
+#include "UniformBlocks.h"
+
+class UniformRing;
+
+// Cascaded shadow maps for the directional light. The camera frustum up to the shadow distance
+// is split into CASCADE_COUNT slices, each covered by one layer of a depth texture array.
+//
+// Every cascade is fit to the bounding sphere of its slice, so its size does not change as the
+// camera turns, and its origin is snapped to whole shadow texels, so moving the camera does not
+// make shadow edges crawl. Distant cascades (from FIRST_CACHED_CASCADE on) are rendered with some
+// slack around that sphere and then reused for as long as the camera's slice stays inside it.
+// They are only re-rendered when the slice leaves the cached area, the light or the static
+// geometry changed (InvalidateCache()), or when their turn in the round-robin refresh comes up,
+// which bounds how stale dynamic casters in the distance can get.
+//
+// The lit shaders read the result through include/shadows.glsl.
+class ShadowCascades
+{
+public:
+	static const int CASCADE_COUNT = ShadowsBlock::CASCADE_COUNT;
+	static const int FIRST_CACHED_CASCADE = 2;
+	// Texture unit and uniform block binding include/shadows.glsl expects
+	static const unsigned int TEXTURE_UNIT = 8;
+	static const unsigned int UNIFORM_BINDING = 3;
+
+	explicit ShadowCascades(int resolution = 2048);
+	~ShadowCascades();
+
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+	// Fits the cascades to this frame's camera and decides which of them have to be re-rendered
+	void Update(const glm::mat4& view, float fovY, float aspect, float nearPlane, const glm::vec3& lightDirection);
+	// Renders the cascades Update() picked. drawCasters is called once per cascade with the depth
+	// program bound and must set "model" for every draw. Leaves the viewport for the caller to restore.
+	void Render(const std::function<void(const Shader&)>& drawCasters);
+	// Binds the shadow map, and this frame's Shadows block from uniforms, for the lit programs
+	void Bind(UniformRing& uniforms) const;
+
+	// The static geometry changed, every cascade is re-rendered next frame
+	void InvalidateCache() { m_CacheValid = false; }
+	void ReloadShaders();
+
+	void DrawImGui(const char* title);
+
+	int GetResolution() const { return m_Resolution; }
+	float GetShadowDistance() const { return m_ShadowDistance; }
+	void SetShadowDistance(float distance) { m_ShadowDistance = distance; }
+
+private:
+	struct Cascade
+	{
+		// Bounding sphere of the camera slice this frame
+		glm::vec3 m_center;
+		float m_radius;
+		// The area the layer was last rendered for, which the shaders keep sampling while it is cached
+		glm::vec3 m_renderedCenter;
+		float m_renderedRadius;
+		glm::mat4 m_viewProjection;
+
+		bool m_renderThisFrame;
+		int m_lastRenderedFrame;
+		float m_cpuMilliseconds;
+		GpuTimer m_timer;
+		unsigned int m_framebuffer;
+	};
+
+	void FitCascade(Cascade& cascade, const glm::mat4& inverseView, float fovY, float aspect, float sliceNear, float sliceFar) const;
+	glm::mat4 MakeViewProjection(const glm::vec3& center, float radius) const;
+
+private:
+	int m_Resolution;
+	unsigned int m_DepthArray;
+	Cascade m_Cascades[CASCADE_COUNT];
+	Shader m_DepthShader;
+
+	ShadowsBlock m_Block;
+
+	// Settings, exposed in DrawImGui()
+	float m_ShadowDistance;
+	float m_SplitLambda;
+	float m_CacheSlack;
+	bool m_CachingEnabled;
+	int m_RefreshInterval;
+
+	glm::vec3 m_LightDirection;
+	glm::mat4 m_LightRotation;
+	bool m_CacheValid;
+	int m_Frame;
+	int m_NextRefresh;
+	int m_RenderedLastFrame;
+};
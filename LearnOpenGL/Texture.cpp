@@ -2,24 +2,34 @@
 #include <iostream>
 #include "stb_image.h"
 
-Texture::Texture(const std::string& texture, TextureMode mode)
-{
-	// Generate OpenGL texture
-	glGenTextures(1, &m_Id);
-	glBindTexture(GL_TEXTURE_2D, m_Id);
-
-	// Set texture parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+#include "AssetCache.h"
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "helpers/Hash.h"
 
+Texture::Texture(const std::string& texture, TextureMode mode, const SamplerDesc& sampler)
+	: m_Id(0)
+	, m_Sampler(sampler)
+{
 	// Load image
 	int width, height, nrChannels;
 	stbi_set_flip_vertically_on_load(true);
 	unsigned char* data = stbi_load(texture.c_str(), &width, &height, &nrChannels, 0);
 	if (data)
 	{
+		// Reuse the GL texture if the same pixels were already loaded under another name
+		size_t size = size_t(width) * height * nrChannels;
+		uint64_t hash = HashBytes(data, size, (uint64_t(width) << 32) | (uint64_t(height) << 8) | uint64_t(mode));
+		if (AssetCache::FindTexture(hash, size, m_Id))
+		{
+			stbi_image_free(data);
+			return;
+		}
+
+		// Generate OpenGL texture
+		glGenTextures(1, &m_Id);
+		GLState::BindTexture(0, GL_TEXTURE_2D, m_Id);
+
 		switch (mode)
 		{
 		case TextureMode::JPG:
@@ -29,6 +39,14 @@ Texture::Texture(const std::string& texture, TextureMode mode)
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
 			break;
 		}
+		// Filtering comes from the shared sampler objects, which always sample mips
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		int bytesPerTexel = mode == TextureMode::JPG ? 3 : 4;
+		size_t gpuBytes = GpuMemoryTracker::TextureBytes(width, height, 1, bytesPerTexel, GpuMemoryTracker::MipLevels(width, height));
+		GpuMemoryTracker::TrackTexture(m_Id, gpuBytes, GpuMemoryCategory::Texture, texture, mode == TextureMode::JPG ? "GL_RGB8" : "GL_RGBA8");
+
+		AssetCache::AddTexture(hash, m_Id, size);
 	}
 	else
 	{
@@ -39,6 +57,6 @@ Texture::Texture(const std::string& texture, TextureMode mode)
 
 void Texture::Use(GLenum texture)
 {
-	glActiveTexture(texture);
-	glBindTexture(GL_TEXTURE_2D, m_Id);
+	GLState::BindTexture(texture - GL_TEXTURE0, GL_TEXTURE_2D, m_Id);
+	SamplerCache::Bind(texture - GL_TEXTURE0, m_Sampler);
 }
@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "SamplerCache.h"
+
 enum class TextureMode
 {
 	JPG,
@@ -12,7 +14,7 @@ enum class TextureMode
 class Texture
 {
 public:
-	Texture(const std::string& texture, TextureMode mode);
+	Texture(const std::string& texture, TextureMode mode, const SamplerDesc& sampler = SamplerDesc());
 
 	unsigned int GetId() const { return m_Id; }
 
@@ -20,4 +22,5 @@ public:
 
 private:
 	unsigned int m_Id;
+	SamplerDesc m_Sampler;
 };
@@ -0,0 +1,149 @@
+#include "TransformBatch.h"
+
+#include <xmmintrin.h>
+
+#include <chrono>
+
+namespace
+{
+	// Inverse transpose of the upper 3x3 of four models, one object per lane
+	void NormalMatrices4(const glm::mat4* const models[4], glm::mat3x4* const out[4])
+	{
+		// Columns a, b and c of the upper 3x3 are transposed so that ax holds the x of a for all four
+		// objects, and so on (the w row is dropped)
+		__m128 ax = _mm_loadu_ps(&(*models[0])[0][0]);
+		__m128 ay = _mm_loadu_ps(&(*models[1])[0][0]);
+		__m128 az = _mm_loadu_ps(&(*models[2])[0][0]);
+		__m128 aw = _mm_loadu_ps(&(*models[3])[0][0]);
+		_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+		__m128 bx = _mm_loadu_ps(&(*models[0])[1][0]);
+		__m128 by = _mm_loadu_ps(&(*models[1])[1][0]);
+		__m128 bz = _mm_loadu_ps(&(*models[2])[1][0]);
+		__m128 bw = _mm_loadu_ps(&(*models[3])[1][0]);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+		__m128 cx = _mm_loadu_ps(&(*models[0])[2][0]);
+		__m128 cy = _mm_loadu_ps(&(*models[1])[2][0]);
+		__m128 cz = _mm_loadu_ps(&(*models[2])[2][0]);
+		__m128 cw = _mm_loadu_ps(&(*models[3])[2][0]);
+		_MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+		// The inverse transpose of [a b c] is [b x c, c x a, a x b] / det
+		__m128 n0x = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+		__m128 n0y = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+		__m128 n0z = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+		__m128 n1x = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+		__m128 n1y = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+		__m128 n1z = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+		__m128 n2x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+		__m128 n2y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+		__m128 n2z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, n0x), _mm_mul_ps(ay, n0y)), _mm_mul_ps(az, n0z));
+		__m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+		__m128 columns[3][4] = {
+			{ _mm_mul_ps(n0x, inverseDet), _mm_mul_ps(n0y, inverseDet), _mm_mul_ps(n0z, inverseDet), _mm_setzero_ps() },
+			{ _mm_mul_ps(n1x, inverseDet), _mm_mul_ps(n1y, inverseDet), _mm_mul_ps(n1z, inverseDet), _mm_setzero_ps() },
+			{ _mm_mul_ps(n2x, inverseDet), _mm_mul_ps(n2y, inverseDet), _mm_mul_ps(n2z, inverseDet), _mm_setzero_ps() },
+		};
+		for (int column = 0; column < 3; column++)
+		{
+			// Back from one component per register to one object per register
+			__m128* c = columns[column];
+			_MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+			for (size_t k = 0; k < 4; k++)
+				_mm_storeu_ps(&(*out[k])[column][0], c[k]);
+		}
+	}
+
+	glm::mat3x4 NormalMatrix(const glm::mat4& model)
+	{
+		glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+		return glm::mat3x4(glm::vec4(normal[0], 0.0f), glm::vec4(normal[1], 0.0f), glm::vec4(normal[2], 0.0f));
+	}
+}
+
+TransformBatch::TransformBatch(size_t capacity)
+	: m_CpuMilliseconds(0.0f)
+{
+	m_Models.reserve(capacity);
+	m_Transforms.reserve(capacity);
+}
+
+int TransformBatch::Add(const glm::mat4& model)
+{
+	m_Models.push_back(model);
+	m_Transforms.push_back({ model, model, glm::mat3x4(1.0f) });
+	return static_cast<int>(m_Models.size()) - 1;
+}
+
+void TransformBatch::Update(const glm::mat4& viewProjection)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	Compute(m_Models.data(), m_Transforms.data(), m_Models.size(), viewProjection);
+	m_CpuMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void TransformBatch::Compute(const glm::mat4* models, ObjectTransform* out, size_t count, const glm::mat4& viewProjection)
+{
+	const __m128 vp0 = _mm_loadu_ps(&viewProjection[0][0]);
+	const __m128 vp1 = _mm_loadu_ps(&viewProjection[1][0]);
+	const __m128 vp2 = _mm_loadu_ps(&viewProjection[2][0]);
+	const __m128 vp3 = _mm_loadu_ps(&viewProjection[3][0]);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		// Model and MVP, one column of the product per step
+		for (size_t k = 0; k < 4; k++)
+		{
+			const glm::mat4& model = models[i + k];
+			ObjectTransform& transform = out[i + k];
+			for (int column = 0; column < 4; column++)
+			{
+				__m128 m = _mm_loadu_ps(&model[column][0]);
+				_mm_storeu_ps(&transform.m_model[column][0], m);
+
+				__m128 result = _mm_mul_ps(vp0, _mm_shuffle_ps(m, m, _MM_SHUFFLE(0, 0, 0, 0)));
+				result = _mm_add_ps(result, _mm_mul_ps(vp1, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))));
+				result = _mm_add_ps(result, _mm_mul_ps(vp2, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2))));
+				result = _mm_add_ps(result, _mm_mul_ps(vp3, _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm_storeu_ps(&transform.m_modelViewProjection[column][0], result);
+			}
+		}
+
+		const glm::mat4* models4[4] = { &models[i], &models[i + 1], &models[i + 2], &models[i + 3] };
+		glm::mat3x4* out4[4] = { &out[i].m_normalMatrix, &out[i + 1].m_normalMatrix, &out[i + 2].m_normalMatrix, &out[i + 3].m_normalMatrix };
+		NormalMatrices4(models4, out4);
+	}
+
+	// The last few objects that do not fill a SIMD register
+	ComputeScalar(models + i, out + i, count - i, viewProjection);
+}
+
+void TransformBatch::ComputeScalar(const glm::mat4* models, ObjectTransform* out, size_t count, const glm::mat4& viewProjection)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const glm::mat4& model = models[i];
+		out[i].m_model = model;
+		out[i].m_modelViewProjection = viewProjection * model;
+		out[i].m_normalMatrix = NormalMatrix(model);
+	}
+}
+
+void TransformBatch::ComputeNormalMatrices(const glm::mat4* models, size_t modelStride, glm::mat3x4* out, size_t outStride, size_t count)
+{
+	auto model = [&](size_t i) { return reinterpret_cast<const glm::mat4*>(reinterpret_cast<const char*>(models) + i * modelStride); };
+	auto normal = [&](size_t i) { return reinterpret_cast<glm::mat3x4*>(reinterpret_cast<char*>(out) + i * outStride); };
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const glm::mat4* models4[4] = { model(i), model(i + 1), model(i + 2), model(i + 3) };
+		glm::mat3x4* out4[4] = { normal(i), normal(i + 1), normal(i + 2), normal(i + 3) };
+		NormalMatrices4(models4, out4);
+	}
+	for (; i < count; i++)
+		*normal(i) = NormalMatrix(*model(i));
+}
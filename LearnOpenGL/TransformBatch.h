@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Everything the vertex shaders need to place one object, computed on the CPU once per object
+// per frame instead of once per vertex. The normal matrix is the inverse transpose of the
+// model's upper 3x3, with its columns padded to vec4 so it can be copied into std140/std430
+// blocks as is (and set as a mat3x4 uniform).
+struct ObjectTransform
+{
+	glm::mat4 m_model;
+	glm::mat4 m_modelViewProjection;
+	glm::mat3x4 m_normalMatrix;
+};
+
+// Model matrices of many objects, turned into ObjectTransforms together with SSE. The normal
+// matrices are worked out four objects at a time (one per SIMD lane), the MVPs one column per
+// instruction.
+class TransformBatch
+{
+public:
+	// Reserves room for the objects added at load time, so Add() does not allocate later
+	explicit TransformBatch(size_t capacity = 0);
+
+	// Returns the index to pass to SetModel() and Get()
+	int Add(const glm::mat4& model);
+	void SetModel(int index, const glm::mat4& model) { m_Models[index] = model; }
+	const glm::mat4& GetModel(int index) const { return m_Models[index]; }
+
+	// Recomputes every object's matrices for this frame's camera
+	void Update(const glm::mat4& viewProjection);
+
+	const ObjectTransform& Get(int index) const { return m_Transforms[index]; }
+	size_t GetCount() const { return m_Models.size(); }
+	float GetCpuMilliseconds() const { return m_CpuMilliseconds; }
+
+	// The batch itself, for callers that keep their own arrays. out may not alias models.
+	static void Compute(const glm::mat4* models, ObjectTransform* out, size_t count, const glm::mat4& viewProjection);
+	// The same with plain glm, one object at a time, for comparison
+	static void ComputeScalar(const glm::mat4* models, ObjectTransform* out, size_t count, const glm::mat4& viewProjection);
+	// Only the normal matrices, for models and outputs interleaved with other data (instances, say).
+	// The strides are the byte distances from one model and one output to the next.
+	static void ComputeNormalMatrices(const glm::mat4* models, size_t modelStride, glm::mat3x4* out, size_t outStride, size_t count);
+
+private:
+	std::vector<glm::mat4> m_Models;
+	std::vector<ObjectTransform> m_Transforms;
+	float m_CpuMilliseconds;
+};
@@ -0,0 +1,221 @@
+#include "TransformBenchmark.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "deps/imgui/imgui.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "helpers/Logger.h"
+
+TransformBenchmark::TransformBenchmark(int segments)
+	: m_VertexArray(0)
+	, m_VertexBuffer(0)
+	, m_IndexBuffer(0)
+	, m_VertexCount(0)
+	, m_IndexCount(0)
+	, m_Color(0)
+	, m_Depth(0)
+	, m_Framebuffer(0)
+	, m_PerVertexShader("res/shaders/transform_stress_vertex.glsl", "res/shaders/transform_stress_fragment.glsl", ShaderCompileMode::Blocking, { "PER_VERTEX_MATRICES" })
+	, m_PrecomputedShader("res/shaders/transform_stress_vertex.glsl", "res/shaders/transform_stress_fragment.glsl")
+	, m_Objects(GRID_SIZE * GRID_SIZE)
+	, m_ScalarMilliseconds(0.0f)
+	, m_SimdMilliseconds(0.0f)
+{
+	CreateSphere(segments);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_Color);
+	glTextureStorage2D(m_Color, 1, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+	GpuMemoryTracker::TrackTexture(m_Color, GpuMemoryTracker::TextureBytes(TARGET_SIZE, TARGET_SIZE, 1, 4, 1), GpuMemoryCategory::Attachment, "TransformBenchmark color", "GL_RGBA8");
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_Depth);
+	glTextureStorage2D(m_Depth, 1, GL_DEPTH_COMPONENT24, TARGET_SIZE, TARGET_SIZE);
+	GpuMemoryTracker::TrackTexture(m_Depth, GpuMemoryTracker::TextureBytes(TARGET_SIZE, TARGET_SIZE, 1, 4, 1), GpuMemoryCategory::Attachment, "TransformBenchmark depth", "GL_DEPTH_COMPONENT24");
+
+	glCreateFramebuffers(1, &m_Framebuffer);
+	glNamedFramebufferTexture(m_Framebuffer, GL_COLOR_ATTACHMENT0, m_Color, 0);
+	glNamedFramebufferTexture(m_Framebuffer, GL_DEPTH_ATTACHMENT, m_Depth, 0);
+	if (glCheckNamedFramebufferStatus(m_Framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		Logger::LogError("TransformBenchmark: framebuffer is not complete");
+
+	m_View = glm::lookAt(glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	m_Projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	// Rotated and squashed, so the normal matrix is not just the model's upper 3x3
+	for (int y = 0; y < GRID_SIZE; y++)
+	{
+		for (int x = 0; x < GRID_SIZE; x++)
+		{
+			glm::vec3 position(2.0f * float(x) - float(GRID_SIZE - 1), 2.0f * float(y) - float(GRID_SIZE - 1), 0.0f);
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+			model = glm::rotate(model, 0.4f * float(x + y * GRID_SIZE), glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+			model = glm::scale(model, glm::vec3(0.9f, 0.5f + 0.1f * float(x), 0.9f));
+			m_Objects.Add(model);
+		}
+	}
+
+	m_CpuModels.resize(CPU_OBJECT_COUNT);
+	m_CpuTransforms.resize(CPU_OBJECT_COUNT);
+	for (int i = 0; i < CPU_OBJECT_COUNT; i++)
+	{
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(float(i % 64), 0.0f, float(i / 64)));
+		m_CpuModels[i] = glm::scale(glm::rotate(model, float(i), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f + 0.01f * float(i % 7)));
+	}
+}
+
+TransformBenchmark::~TransformBenchmark()
+{
+	glDeleteFramebuffers(1, &m_Framebuffer);
+	GpuMemoryTracker::UntrackTexture(m_Color);
+	GpuMemoryTracker::UntrackTexture(m_Depth);
+	glDeleteTextures(1, &m_Color);
+	glDeleteTextures(1, &m_Depth);
+	glDeleteVertexArrays(1, &m_VertexArray);
+	GpuMemoryTracker::UntrackBuffer(m_VertexBuffer);
+	GpuMemoryTracker::UntrackBuffer(m_IndexBuffer);
+	glDeleteBuffers(1, &m_VertexBuffer);
+	glDeleteBuffers(1, &m_IndexBuffer);
+	GLState::Invalidate();
+}
+
+void TransformBenchmark::CreateSphere(int segments)
+{
+	// Position, normal and texture coordinates, laid out like Mesh::Vertex for lit_vertex.glsl
+	const int rings = segments / 2;
+	std::vector<float> vertices;
+	vertices.reserve(size_t(segments + 1) * size_t(rings + 1) * 8);
+	for (int ring = 0; ring <= rings; ring++)
+	{
+		float v = float(ring) / float(rings);
+		float theta = v * glm::pi<float>();
+		for (int segment = 0; segment <= segments; segment++)
+		{
+			float u = float(segment) / float(segments);
+			float phi = u * glm::two_pi<float>();
+			glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			vertices.insert(vertices.end(), { normal.x, normal.y, normal.z, normal.x, normal.y, normal.z, u, v });
+		}
+	}
+
+	std::vector<unsigned int> indices;
+	indices.reserve(size_t(segments) * size_t(rings) * 6);
+	for (int ring = 0; ring < rings; ring++)
+	{
+		for (int segment = 0; segment < segments; segment++)
+		{
+			unsigned int first = ring * (segments + 1) + segment;
+			unsigned int below = first + segments + 1;
+			indices.insert(indices.end(), { first, below, first + 1, first + 1, below, below + 1 });
+		}
+	}
+	m_VertexCount = static_cast<int>(vertices.size() / 8);
+	m_IndexCount = static_cast<int>(indices.size());
+
+	glCreateBuffers(1, &m_VertexBuffer);
+	glNamedBufferStorage(m_VertexBuffer, vertices.size() * sizeof(float), vertices.data(), 0);
+	GpuMemoryTracker::TrackBuffer(m_VertexBuffer, vertices.size() * sizeof(float), GpuMemoryCategory::VertexBuffer, "TransformBenchmark sphere", "vec3 + vec3 + vec2");
+	glCreateBuffers(1, &m_IndexBuffer);
+	glNamedBufferStorage(m_IndexBuffer, indices.size() * sizeof(unsigned int), indices.data(), 0);
+	GpuMemoryTracker::TrackBuffer(m_IndexBuffer, indices.size() * sizeof(unsigned int), GpuMemoryCategory::IndexBuffer, "TransformBenchmark sphere", "GL_UNSIGNED_INT");
+
+	glCreateVertexArrays(1, &m_VertexArray);
+	glVertexArrayVertexBuffer(m_VertexArray, 0, m_VertexBuffer, 0, 8 * sizeof(float));
+	glVertexArrayElementBuffer(m_VertexArray, m_IndexBuffer);
+	for (unsigned int attribute = 0; attribute < 3; attribute++)
+	{
+		glEnableVertexArrayAttrib(m_VertexArray, attribute);
+		glVertexArrayAttribFormat(m_VertexArray, attribute, attribute == 2 ? 2 : 3, GL_FLOAT, GL_FALSE, attribute * 3 * sizeof(float));
+		glVertexArrayAttribBinding(m_VertexArray, attribute, 0);
+	}
+}
+
+void TransformBenchmark::Run()
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	auto start = Clock::now();
+	TransformBatch::ComputeScalar(m_CpuModels.data(), m_CpuTransforms.data(), m_CpuModels.size(), m_Projection * m_View);
+	m_ScalarMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	start = Clock::now();
+	TransformBatch::Compute(m_CpuModels.data(), m_CpuTransforms.data(), m_CpuModels.size(), m_Projection * m_View);
+	m_SimdMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+
+	m_Objects.Update(m_Projection * m_View);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+	glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+	GLState::SetDepthTest(true);
+	GLState::SetDepthMask(true);
+	GLState::SetDepthFunc(GL_LESS);
+	GLState::BindVertexArray(m_VertexArray);
+
+	if (m_PerVertexShader.IsReady())
+	{
+		m_PerVertexTimer.Begin();
+		DrawGrid(m_PerVertexShader, true);
+		m_PerVertexTimer.End();
+	}
+	if (m_PrecomputedShader.IsReady())
+	{
+		m_PrecomputedTimer.Begin();
+		DrawGrid(m_PrecomputedShader, false);
+		m_PrecomputedTimer.End();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void TransformBenchmark::DrawGrid(Shader& shader, bool perVertex)
+{
+	const float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float farDepth = 1.0f;
+	glClearNamedFramebufferfv(m_Framebuffer, GL_COLOR, 0, clearColor);
+	glClearNamedFramebufferfv(m_Framebuffer, GL_DEPTH, 0, &farDepth);
+
+	shader.Use();
+	if (perVertex)
+	{
+		shader.SetMat4("view", m_View);
+		shader.SetMat4("projection", m_Projection);
+	}
+	for (size_t i = 0; i < m_Objects.GetCount(); i++)
+	{
+		const ObjectTransform& transform = m_Objects.Get(int(i));
+		shader.SetMat4("model", transform.m_model);
+		if (!perVertex)
+		{
+			shader.SetMat4("modelViewProjection", transform.m_modelViewProjection);
+			shader.Set("normalMatrix", transform.m_normalMatrix);
+		}
+		glDrawElements(GL_TRIANGLES, m_IndexCount, GL_UNSIGNED_INT, nullptr);
+	}
+}
+
+void TransformBenchmark::ReloadShaders()
+{
+	m_PerVertexShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+	m_PrecomputedShader.ReloadIfChanged(ShaderCompileMode::Blocking);
+}
+
+void TransformBenchmark::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	ImGui::Text("%d spheres of %d vertices, %d triangles each", int(m_Objects.GetCount()), m_VertexCount, m_IndexCount / 3);
+
+	float perVertex = m_PerVertexTimer.GetMilliseconds();
+	float precomputed = m_PrecomputedTimer.GetMilliseconds();
+	ImGui::Text("inverse() per vertex:  GPU %.3f ms", perVertex);
+	ImGui::Text("Matrices from the CPU: GPU %.3f ms", precomputed);
+	if (perVertex > 0.0f)
+		ImGui::Text("%.1f%% less vertex time", 100.0f * (perVertex - precomputed) / perVertex);
+	ImGui::Separator();
+
+	ImGui::Text("%d objects on the CPU", CPU_OBJECT_COUNT);
+	ImGui::Text("glm:            %.3f ms", m_ScalarMilliseconds);
+	ImGui::Text("TransformBatch: %.3f ms", m_SimdMilliseconds);
+	ImGui::End();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "GpuTimer.h"
+#include "Shader.h"
+#include "TransformBatch.h"
+
+// Stress test for the per-object matrices. Draws a grid of dense spheres into a small offscreen
+// target, where every triangle covers far less than a pixel so the vertex shader dominates, once
+// with the MVP and normal matrix derived per vertex and once with the ones TransformBatch computed.
+// The difference of the two GPU times is the vertex ALU the CPU path saves.
+//
+// On the CPU side it also times TransformBatch on CPU_OBJECT_COUNT objects against plain glm.
+class TransformBenchmark
+{
+public:
+	static const int GRID_SIZE = 4;
+	static const int CPU_OBJECT_COUNT = 4096;
+	static const int TARGET_SIZE = 128;
+
+	// The sphere has segments * segments / 2 quads
+	explicit TransformBenchmark(int segments = 256);
+	~TransformBenchmark();
+
+	TransformBenchmark(const TransformBenchmark&) = delete;
+	TransformBenchmark& operator=(const TransformBenchmark&) = delete;
+
+	// Draws both variants. Leaves the viewport for the caller to restore.
+	void Run();
+	void ReloadShaders();
+	void DrawImGui(const char* title);
+
+	int GetVertexCount() const { return m_VertexCount; }
+	float GetPerVertexMilliseconds() const { return m_PerVertexTimer.GetMilliseconds(); }
+	float GetPrecomputedMilliseconds() const { return m_PrecomputedTimer.GetMilliseconds(); }
+
+private:
+	void CreateSphere(int segments);
+	void DrawGrid(Shader& shader, bool perVertex);
+
+private:
+	unsigned int m_VertexArray;
+	unsigned int m_VertexBuffer;
+	unsigned int m_IndexBuffer;
+	int m_VertexCount;
+	int m_IndexCount;
+
+	unsigned int m_Color;
+	unsigned int m_Depth;
+	unsigned int m_Framebuffer;
+
+	Shader m_PerVertexShader;
+	Shader m_PrecomputedShader;
+	GpuTimer m_PerVertexTimer;
+	GpuTimer m_PrecomputedTimer;
+
+	glm::mat4 m_View;
+	glm::mat4 m_Projection;
+	TransformBatch m_Objects;
+
+	std::vector<glm::mat4> m_CpuModels;
+	std::vector<ObjectTransform> m_CpuTransforms;
+	float m_ScalarMilliseconds;
+	float m_SimdMilliseconds;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+// FNV-1a, constexpr so names written as literals are hashed at compile time
+constexpr uint64_t HashUniformName(const char* name, size_t length)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= uint8_t(name[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+constexpr size_t UniformNameLength(const char* name)
+{
+	size_t length = 0;
+	while (name[length] != '\0')
+		length++;
+	return length;
+}
+
+// A uniform name reduced to its hash. Converts implicitly from literals (constexpr) and std::string
+// (hashed in place), so looking a uniform up never builds a string.
+struct UniformName
+{
+	constexpr UniformName(const char* name)
+		: m_hash(HashUniformName(name, UniformNameLength(name)))
+		, m_name(name)
+	{
+	}
+
+	UniformName(const std::string& name)
+		: m_hash(HashUniformName(name.data(), name.size()))
+		, m_name(name.c_str())
+	{
+	}
+
+	uint64_t m_hash;
+	const char* m_name; // only valid for the duration of the call it was passed to
+};
+
+inline void SetUniform(int location, bool value) { glUniform1i(location, int(value)); }
+inline void SetUniform(int location, int value) { glUniform1i(location, value); }
+inline void SetUniform(int location, float value) { glUniform1f(location, value); }
+inline void SetUniform(int location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+inline void SetUniform(int location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+inline void SetUniform(int location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+inline void SetUniform(int location, const glm::mat2& value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniform(int location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniform(int location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniform(int location, const glm::mat3x4& value) { glUniformMatrix3x4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+// A uniform location resolved once, after the program is linked. Setting it is a single glUniform call.
+// Resolve again (assign a new handle) if the program is rebuilt.
+template <typename T>
+class Uniform
+{
+public:
+	Uniform() = default;
+	explicit Uniform(int location) : m_Location(location) {}
+
+	void Set(const T& value) const { SetUniform(m_Location, value); }
+
+	bool IsValid() const { return m_Location >= 0; }
+	int GetLocation() const { return m_Location; }
+
+private:
+	int m_Location = -1;
+};
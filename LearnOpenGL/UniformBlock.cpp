@@ -0,0 +1,64 @@
+#include "UniformBlock.h"
+
+#include <sstream>
+
+#include "Shader.h"
+#include "helpers/Logger.h"
+
+namespace
+{
+	// Arrays of basic types are reported as "name[0]", members of instanced blocks as "Block.name"
+	const Shader::UniformBlockMember* FindMember(const Shader::UniformBlockInfo& block, const std::string& name)
+	{
+		for (const Shader::UniformBlockMember& member : block.m_members)
+		{
+			if (member.m_name == name || member.m_name == name + "[0]" || member.m_name == block.m_name + "." + name)
+				return &member;
+		}
+		return nullptr;
+	}
+}
+
+bool ValidateUniformBlockLayout(const Shader& shader, const char* blockName, size_t blockSize, const std::vector<UniformBlockField>& fields)
+{
+	const Shader::UniformBlockInfo* block = shader.FindUniformBlock(blockName);
+	if (!block)
+	{
+		Logger::LogError(std::string("UniformBlock: program has no active block ") + blockName);
+		return false;
+	}
+
+	std::stringstream errors;
+	if (blockSize < size_t(block->m_dataSize))
+		errors << "\n  C++ struct is " << blockSize << " bytes, GLSL block needs " << block->m_dataSize;
+
+	for (const UniformBlockField& field : fields)
+	{
+		// Members the shader does not use are optimized out, nothing to check
+		const Shader::UniformBlockMember* member = FindMember(*block, field.m_name);
+		if (!member)
+			continue;
+
+		if (member->m_type != field.m_type)
+			errors << "\n  " << field.m_name << ": GLSL type 0x" << std::hex << member->m_type << " vs C++ 0x" << field.m_type << std::dec;
+		if (size_t(member->m_offset) != field.m_offset)
+			errors << "\n  " << field.m_name << ": GLSL offset " << member->m_offset << " vs C++ " << field.m_offset;
+		if (member->m_size > 1 && member->m_arrayStride != field.m_arrayStride)
+			errors << "\n  " << field.m_name << ": GLSL array stride " << member->m_arrayStride << " vs C++ " << field.m_arrayStride;
+		if (member->m_size > field.m_arraySize)
+			errors << "\n  " << field.m_name << ": GLSL array has " << member->m_size << " elements, C++ " << field.m_arraySize;
+		if (member->m_matrixStride != 0 && member->m_matrixStride != field.m_matrixStride)
+			errors << "\n  " << field.m_name << ": GLSL matrix stride " << member->m_matrixStride << " vs C++ " << field.m_matrixStride;
+	}
+
+	if (!errors.str().empty())
+	{
+		Logger::LogError(std::string("UniformBlock: ") + blockName + " layout does not match its C++ mirror:" + errors.str());
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << "UniformBlock: " << blockName << " validated (" << block->m_members.size() << " members, " << block->m_dataSize << " bytes)";
+	Logger::Log(ss.str());
+	return true;
+}
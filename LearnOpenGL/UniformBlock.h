@@ -0,0 +1,112 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+
+class Shader;
+
+// GL type enum of a C++ member, for checking mirror structs against reflection
+template <typename T> struct GLSLType;
+template <> struct GLSLType<float> { static const GLenum value = GL_FLOAT; };
+template <> struct GLSLType<int> { static const GLenum value = GL_INT; };
+template <> struct GLSLType<unsigned int> { static const GLenum value = GL_UNSIGNED_INT; };
+template <> struct GLSLType<glm::vec2> { static const GLenum value = GL_FLOAT_VEC2; };
+template <> struct GLSLType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template <> struct GLSLType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template <> struct GLSLType<glm::ivec4> { static const GLenum value = GL_INT_VEC4; };
+template <> struct GLSLType<glm::uvec4> { static const GLenum value = GL_UNSIGNED_INT_VEC4; };
+template <> struct GLSLType<glm::mat3> { static const GLenum value = GL_FLOAT_MAT3; };
+template <> struct GLSLType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+template <> struct GLSLType<glm::mat3x4> { static const GLenum value = GL_FLOAT_MAT3x4; };
+
+template <typename T> struct MatrixColumnBytes { static const int value = 0; };
+template <> struct MatrixColumnBytes<glm::mat3> { static const int value = sizeof(glm::mat3::col_type); };
+template <> struct MatrixColumnBytes<glm::mat4> { static const int value = sizeof(glm::mat4::col_type); };
+template <> struct MatrixColumnBytes<glm::mat3x4> { static const int value = sizeof(glm::mat3x4::col_type); };
+
+// Where one member of a C++ mirror struct lives
+struct UniformBlockField
+{
+	std::string m_name;		// as GLSL names it, e.g. "view" or "pointLights[2].position"
+	size_t m_offset;
+	GLenum m_type;
+	int m_arraySize;		// 1 for non-arrays
+	int m_arrayStride;		// C++ element size for arrays, 0 otherwise
+	int m_matrixStride;		// C++ column size for matrices, 0 otherwise
+};
+
+template <typename T>
+UniformBlockField MakeUniformBlockField(const std::string& name, size_t offset)
+{
+	using Element = std::remove_all_extents_t<T>;
+	const int arraySize = std::is_array<T>::value ? int(std::extent<T>::value) : 1;
+	return { name, offset, GLSLType<Element>::value, arraySize, std::is_array<T>::value ? int(sizeof(Element)) : 0, MatrixColumnBytes<Element>::value };
+}
+
+// Describes a member of Block by name; arrays of structs are listed element by element
+#define UNIFORM_BLOCK_FIELD(Block, member) MakeUniformBlockField<decltype(Block::member)>(#member, offsetof(Block, member))
+// Describes a member of a Struct nested at `offset` in a block, as GLSL names it: "prefix.member"
+#define UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, Struct, member) MakeUniformBlockField<decltype(Struct::member)>(std::string(prefix) + "." #member, (offset) + offsetof(Struct, member))
+
+// Specialize for every C++ mirror of a GLSL uniform block:
+//   static const char* Name();                      GLSL block name
+//   static std::vector<UniformBlockField> Fields(); every member the shader may use
+template <typename Block>
+struct UniformBlockLayout;
+
+// Compares the C++ layout against the program's reflected block and logs every mismatch.
+// Run once at startup for each block and each program that uses it.
+bool ValidateUniformBlockLayout(const Shader& shader, const char* blockName, size_t blockSize, const std::vector<UniformBlockField>& fields);
+
+template <typename Block>
+bool ValidateUniformBlock(const Shader& shader)
+{
+	static_assert(std::is_trivially_copyable<Block>::value, "uniform blocks are uploaded with a plain copy");
+	return ValidateUniformBlockLayout(shader, UniformBlockLayout<Block>::Name(), sizeof(Block), UniformBlockLayout<Block>::Fields());
+}
+
+// A buffer holding exactly one Block. Once the layout is validated, the whole struct goes to the
+// GPU in a single copy instead of one glBufferSubData per member at hand-computed offsets.
+template <typename Block>
+class UniformBuffer
+{
+public:
+	explicit UniformBuffer(const std::string& owner)
+		: m_Id(0)
+	{
+		glCreateBuffers(1, &m_Id);
+		glNamedBufferData(m_Id, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+		GpuMemoryTracker::TrackBuffer(m_Id, sizeof(Block), GpuMemoryCategory::UniformBuffer, owner, UniformBlockLayout<Block>::Name());
+	}
+
+	~UniformBuffer()
+	{
+		GpuMemoryTracker::UntrackBuffer(m_Id);
+		glDeleteBuffers(1, &m_Id);
+	}
+
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	void Upload(const Block& block)
+	{
+		glNamedBufferSubData(m_Id, 0, sizeof(Block), &block);
+	}
+
+	void Bind(unsigned int binding) const
+	{
+		GLState::BindBufferRange(GL_UNIFORM_BUFFER, binding, m_Id, 0, sizeof(Block));
+	}
+
+	unsigned int GetId() const { return m_Id; }
+
+private:
+	unsigned int m_Id;
+};
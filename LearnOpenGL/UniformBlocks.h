@@ -0,0 +1,272 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "UniformBlock.h"
+
+// C++ mirrors of the GLSL uniform blocks. Members are laid out by hand to match std140
+// (vec3 and vec4 aligned to 16 bytes, matrices as vec4 columns) and checked against the
+// driver's reflection with ValidateUniformBlock<T>() at startup.
+
+// layout(std140, binding = 0) uniform Matrices in ubo_test.vs, written to the UniformRing every frame
+struct MatricesBlock
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+};
+
+template <>
+struct UniformBlockLayout<MatricesBlock>
+{
+	static const char* Name() { return "Matrices"; }
+	static std::vector<UniformBlockField> Fields()
+	{
+		return {
+			UNIFORM_BLOCK_FIELD(MatricesBlock, projection),
+			UNIFORM_BLOCK_FIELD(MatricesBlock, view),
+		};
+	}
+};
+
+// layout(std140, binding = 1) uniform ClusterParams in include/clusters.glsl, filled by LightClusters
+struct ClusterParamsBlock
+{
+	glm::uvec4 gridSize;	// xyz = clusters per axis
+	glm::vec4 zParams;		// x = slice scale, y = slice bias, z = near, w = far
+	glm::vec4 tileSize;		// xy = tile size in pixels
+};
+
+template <>
+struct UniformBlockLayout<ClusterParamsBlock>
+{
+	static const char* Name() { return "ClusterParams"; }
+	static std::vector<UniformBlockField> Fields()
+	{
+		return {
+			UNIFORM_BLOCK_FIELD(ClusterParamsBlock, gridSize),
+			UNIFORM_BLOCK_FIELD(ClusterParamsBlock, zParams),
+			UNIFORM_BLOCK_FIELD(ClusterParamsBlock, tileSize),
+		};
+	}
+};
+
+// std140 mirrors of the light structs in include/lighting.glsl. Padding members fill the
+// vec3 slots GLSL rounds up to 16 bytes.
+struct DirLightStd140
+{
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+
+	static void AppendFields(std::vector<UniformBlockField>& fields, const std::string& prefix, size_t offset)
+	{
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, DirLightStd140, direction));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, DirLightStd140, ambient));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, DirLightStd140, diffuse));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, DirLightStd140, specular));
+	}
+};
+
+struct PointLightStd140
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float pad0;
+
+	static void AppendFields(std::vector<UniformBlockField>& fields, const std::string& prefix, size_t offset)
+	{
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, PointLightStd140, position));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, PointLightStd140, constant));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, PointLightStd140, ambient));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, PointLightStd140, linear));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, PointLightStd140, diffuse));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, PointLightStd140, quadratic));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, PointLightStd140, specular));
+	}
+};
+
+struct SpotLightStd140
+{
+	glm::vec3 position;
+	float cutOff;
+	glm::vec3 direction;
+	float outerCutOff;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+
+	static void AppendFields(std::vector<UniformBlockField>& fields, const std::string& prefix, size_t offset)
+	{
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, position));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, cutOff));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, direction));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, outerCutOff));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, ambient));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, constant));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, diffuse));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, linear));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, specular));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, SpotLightStd140, quadratic));
+	}
+};
+
+// layout(std140, binding = 2) uniform Frame in include/frame.glsl, written to the UniformRing every frame
+struct FrameBlock
+{
+	static const int MAX_POINT_LIGHTS = 4;
+
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 inverseViewProjection;
+	glm::vec3 viewPos;
+	float pad0;
+
+	DirLightStd140 dirLight;
+	PointLightStd140 pointLights[MAX_POINT_LIGHTS];
+	SpotLightStd140 spotLight;
+};
+
+template <>
+struct UniformBlockLayout<FrameBlock>
+{
+	static const char* Name() { return "Frame"; }
+	static std::vector<UniformBlockField> Fields()
+	{
+		std::vector<UniformBlockField> fields = {
+			UNIFORM_BLOCK_FIELD(FrameBlock, view),
+			UNIFORM_BLOCK_FIELD(FrameBlock, projection),
+			UNIFORM_BLOCK_FIELD(FrameBlock, inverseViewProjection),
+			UNIFORM_BLOCK_FIELD(FrameBlock, viewPos),
+		};
+		DirLightStd140::AppendFields(fields, "dirLight", offsetof(FrameBlock, dirLight));
+		for (int i = 0; i < FrameBlock::MAX_POINT_LIGHTS; i++)
+		{
+			PointLightStd140::AppendFields(fields, "pointLights[" + std::to_string(i) + "]", offsetof(FrameBlock, pointLights) + i * sizeof(PointLightStd140));
+		}
+		SpotLightStd140::AppendFields(fields, "spotLight", offsetof(FrameBlock, spotLight));
+		return fields;
+	}
+};
+
+// layout(std140, binding = 3) uniform Shadows in include/shadows.glsl, filled by ShadowCascades
+struct ShadowsBlock
+{
+	static const int CASCADE_COUNT = 4;
+
+	glm::mat4 cascadeViewProjections[CASCADE_COUNT];
+	glm::vec4 cascadeSplits;		// far view depth of each cascade
+	glm::vec4 cascadeTexelSizes;	// world size of one shadow map texel in each cascade
+	glm::vec4 shadowParams;			// x = normal offset in texels, y = view depth where the shadows start fading out
+};
+
+template <>
+struct UniformBlockLayout<ShadowsBlock>
+{
+	static const char* Name() { return "Shadows"; }
+	static std::vector<UniformBlockField> Fields()
+	{
+		return {
+			UNIFORM_BLOCK_FIELD(ShadowsBlock, cascadeViewProjections),
+			UNIFORM_BLOCK_FIELD(ShadowsBlock, cascadeSplits),
+			UNIFORM_BLOCK_FIELD(ShadowsBlock, cascadeTexelSizes),
+			UNIFORM_BLOCK_FIELD(ShadowsBlock, shadowParams),
+		};
+	}
+};
+
+// std140 ShadowTile in include/shadow_atlas.glsl
+struct ShadowTileStd140
+{
+	glm::mat4 viewProjection;
+	glm::vec4 rect;		// xy = atlas uv origin, z = uv size, w = world texel size per unit of distance (0 = not rendered yet)
+
+	static void AppendFields(std::vector<UniformBlockField>& fields, const std::string& prefix, size_t offset)
+	{
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, ShadowTileStd140, viewProjection));
+		fields.push_back(UNIFORM_BLOCK_STRUCT_FIELD(prefix, offset, ShadowTileStd140, rect));
+	}
+};
+
+// layout(std140, binding = 4) uniform ShadowAtlas in include/shadow_atlas.glsl, filled by ShadowAtlas
+struct ShadowAtlasBlock
+{
+	static const int MAX_POINT_LIGHTS = 4;
+	static const int POINT_TILE_COUNT = MAX_POINT_LIGHTS * 6;
+
+	ShadowTileStd140 pointShadowTiles[POINT_TILE_COUNT];	// six cube faces per point light
+	ShadowTileStd140 spotShadowTile;
+	glm::vec4 atlasParams;		// x = 1 / atlas size, y = normal offset in texels
+};
+static_assert(ShadowAtlasBlock::MAX_POINT_LIGHTS == FrameBlock::MAX_POINT_LIGHTS, "include/shadow_atlas.glsl sizes its tiles with the Frame block's MAX_POINT_LIGHTS");
+
+template <>
+struct UniformBlockLayout<ShadowAtlasBlock>
+{
+	static const char* Name() { return "ShadowAtlas"; }
+	static std::vector<UniformBlockField> Fields()
+	{
+		std::vector<UniformBlockField> fields;
+		for (int i = 0; i < ShadowAtlasBlock::POINT_TILE_COUNT; i++)
+		{
+			ShadowTileStd140::AppendFields(fields, "pointShadowTiles[" + std::to_string(i) + "]", offsetof(ShadowAtlasBlock, pointShadowTiles) + i * sizeof(ShadowTileStd140));
+		}
+		ShadowTileStd140::AppendFields(fields, "spotShadowTile", offsetof(ShadowAtlasBlock, spotShadowTile));
+		fields.push_back(UNIFORM_BLOCK_FIELD(ShadowAtlasBlock, atlasParams));
+		return fields;
+	}
+};
+
+// layout(std140, binding = 5) uniform Environment in include/ibl.glsl, filled by ImageBasedLighting
+struct EnvironmentBlock
+{
+	glm::vec4 irradianceSH[9];	// rgb, convolved with the cosine lobe and divided by pi
+	glm::vec4 environmentParams;	// x = last prefiltered mip, y = diffuse intensity, z = specular intensity
+};
+
+template <>
+struct UniformBlockLayout<EnvironmentBlock>
+{
+	static const char* Name() { return "Environment"; }
+	static std::vector<UniformBlockField> Fields()
+	{
+		return {
+			UNIFORM_BLOCK_FIELD(EnvironmentBlock, irradianceSH),
+			UNIFORM_BLOCK_FIELD(EnvironmentBlock, environmentParams),
+		};
+	}
+};
+
+// layout(std140, binding = 6) uniform Object in include/object.glsl, written to the UniformRing by
+// the RenderQueue for every draw. The same layout as ObjectTransform.
+struct ObjectBlock
+{
+	glm::mat4 model;
+	glm::mat4 modelViewProjection;
+	glm::mat3x4 normalMatrix;	// inverse transpose of model, columns padded to vec4
+};
+
+template <>
+struct UniformBlockLayout<ObjectBlock>
+{
+	static const char* Name() { return "Object"; }
+	static std::vector<UniformBlockField> Fields()
+	{
+		return {
+			UNIFORM_BLOCK_FIELD(ObjectBlock, model),
+			UNIFORM_BLOCK_FIELD(ObjectBlock, modelViewProjection),
+			UNIFORM_BLOCK_FIELD(ObjectBlock, normalMatrix),
+		};
+	}
+};
@@ -0,0 +1,167 @@
+#include "UniformRing.h"
+
+#include "deps/imgui/imgui.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "GLState.h"
+#include "GpuMemoryTracker.h"
+#include "helpers/Logger.h"
+
+namespace
+{
+	// Long enough that a wait only times out on a lost GPU
+	const GLuint64 FENCE_TIMEOUT_NANOSECONDS = 1000000000;
+}
+
+UniformRing::UniformRing(GLsizeiptr frameSize, const std::string& name)
+	: m_Buffer(0)
+	, m_FrameSize(0)
+	, m_Alignment(256)
+	, m_Mapped(nullptr)
+	, m_Slice(FRAME_COUNT - 1)
+	, m_Used(0)
+	, m_Requested(0)
+	, m_Pushes(0)
+	, m_Name(name)
+	, m_OverflowLogged(false)
+	, m_WaitMicroseconds(0.0f)
+	, m_FrameBytes(0)
+	, m_FramePushes(0)
+{
+	for (GLsync& fence : m_Fences)
+		fence = nullptr;
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_Alignment = alignment;
+	Allocate(frameSize);
+}
+
+UniformRing::~UniformRing()
+{
+	Release();
+}
+
+void UniformRing::Allocate(GLsizeiptr frameSize)
+{
+	m_FrameSize = (frameSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+
+	// Coherent, so pushed blocks are visible to the next draw without a flush
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &m_Buffer);
+	glNamedBufferStorage(m_Buffer, m_FrameSize * FRAME_COUNT, nullptr, flags);
+	m_Mapped = static_cast<char*>(glMapNamedBufferRange(m_Buffer, 0, m_FrameSize * FRAME_COUNT, flags));
+	if (!m_Mapped)
+	{
+		Logger::LogError("UniformRing " + m_Name + ": could not map the uniform buffer");
+		m_FrameSize = 0;
+	}
+	GpuMemoryTracker::TrackBuffer(m_Buffer, m_FrameSize * FRAME_COUNT, GpuMemoryCategory::UniformBuffer, "UniformRing " + m_Name, "std140 blocks");
+}
+
+void UniformRing::Release()
+{
+	for (GLsync& fence : m_Fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (m_Mapped)
+		glUnmapNamedBuffer(m_Buffer);
+	m_Mapped = nullptr;
+	glDeleteBuffers(1, &m_Buffer);
+	GpuMemoryTracker::UntrackBuffer(m_Buffer);
+	m_Buffer = 0;
+	// Deleting the buffer unbound its ranges behind GLState's back
+	GLState::Invalidate();
+}
+
+void UniformRing::Begin()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// The last frame dropped blocks: double the slices until it would have fit. Every slice may
+	// still be in use, so wait for all of them before the buffer goes.
+	if (m_Requested > m_FrameSize && m_Mapped)
+	{
+		GLsizeiptr frameSize = m_FrameSize;
+		while (frameSize < m_Requested)
+			frameSize *= 2;
+		for (GLsync fence : m_Fences)
+		{
+			if (fence)
+				glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NANOSECONDS);
+		}
+		Release();
+		Allocate(frameSize);
+		Logger::LogWarning("UniformRing " + m_Name + ": grown to " + std::to_string(m_FrameSize) + " bytes per frame");
+		m_OverflowLogged = false;
+	}
+
+	m_Slice = (m_Slice + 1) % FRAME_COUNT;
+	m_Used = 0;
+	m_Requested = 0;
+	m_Pushes = 0;
+
+	GLsync& fence = m_Fences[m_Slice];
+	if (fence)
+	{
+		// Flush on the first try, so the fence cannot wait on commands that were never submitted
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NANOSECONDS);
+		if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+			Logger::LogWarning("UniformRing " + m_Name + ": the GPU did not release a slice in time");
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	m_WaitMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+GLintptr UniformRing::Push(const void* data, GLsizeiptr size)
+{
+	GLsizeiptr aligned = (size + m_Alignment - 1) / m_Alignment * m_Alignment;
+	m_Requested += aligned;
+	if (m_Used + aligned > m_FrameSize)
+	{
+		if (!m_OverflowLogged)
+		{
+			Logger::LogWarning("UniformRing " + m_Name + ": more than " + std::to_string(m_FrameSize) + " bytes in a frame, the rest are dropped until it grows");
+			m_OverflowLogged = true;
+		}
+		return -1;
+	}
+
+	// Written once and in order, the mapping may be write-combined memory that must not be read
+	GLintptr offset = m_Slice * m_FrameSize + m_Used;
+	std::memcpy(m_Mapped + offset, data, size);
+	m_Used += aligned;
+	m_Pushes++;
+	return offset;
+}
+
+void UniformRing::BindRange(unsigned int binding, GLintptr offset, GLsizeiptr size) const
+{
+	if (offset < 0)
+		return;
+
+	GLState::BindBufferRange(GL_UNIFORM_BUFFER, binding, m_Buffer, offset, size);
+}
+
+void UniformRing::End()
+{
+	m_FrameBytes = m_Used;
+	m_FramePushes = m_Pushes;
+
+	if (m_Used > 0)
+		m_Fences[m_Slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformRing::DrawImGui(const char* title)
+{
+	ImGui::Begin(title);
+	ImGui::Text("%d blocks, %d / %d bytes, aligned to %d", m_FramePushes, int(m_FrameBytes), int(m_FrameSize), int(m_Alignment));
+	ImGui::Text("Fence wait %.1f us", m_WaitMicroseconds);
+	ImGui::End();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+
+// Per-frame uniform data (camera, lights, per-draw matrices) written straight into one
+// persistently mapped buffer and bound a range at a time, instead of glBufferSubData into buffers
+// the GPU may still be reading from, which makes the driver copy or wait.
+//
+// Like InstanceBuffer, the buffer holds FRAME_COUNT slices used round robin with a fence per
+// slice, so Begin() only waits when the CPU runs a full FRAME_COUNT frames ahead. Every block
+// starts at a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT. A frame that pushes more than a
+// slice holds gets -1 for the blocks that did not fit, and the next Begin() grows the slices.
+//
+// Per frame:
+//   Begin(); Bind<Block>(binding, Push(block))...; End() after the last draw reading the slice
+class UniformRing
+{
+public:
+	static const int FRAME_COUNT = 3;
+
+	// frameSize bytes of blocks per frame to start with
+	UniformRing(GLsizeiptr frameSize, const std::string& name);
+	~UniformRing();
+
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	// Moves to the next slice, waiting for the GPU to finish with it if needed. Grows every slice,
+	// waiting for the whole buffer, when the last frame did not fit.
+	void Begin();
+	// Copies size bytes into this frame's slice and returns their offset, or -1 once the slice is full
+	GLintptr Push(const void* data, GLsizeiptr size);
+	template <typename Block>
+	GLintptr Push(const Block& block) { return Push(&block, sizeof(Block)); }
+	// Binds size bytes at offset from Push(). Does nothing for -1, the caller has to skip its draws.
+	void BindRange(unsigned int binding, GLintptr offset, GLsizeiptr size) const;
+	template <typename Block>
+	void Bind(unsigned int binding, GLintptr offset) const { BindRange(binding, offset, sizeof(Block)); }
+	// Fences the slice after its last draw
+	void End();
+
+	void DrawImGui(const char* title);
+
+	unsigned int GetId() const { return m_Buffer; }
+
+private:
+	void Allocate(GLsizeiptr frameSize);
+	void Release();
+
+private:
+	unsigned int m_Buffer;
+	GLsizeiptr m_FrameSize;	// rounded up to the offset alignment
+	GLsizeiptr m_Alignment;
+	char* m_Mapped;
+
+	GLsync m_Fences[FRAME_COUNT];
+	int m_Slice;
+	GLsizeiptr m_Used;	// bytes of the current slice
+	GLsizeiptr m_Requested;	// bytes the current frame pushed, including the ones that did not fit
+	int m_Pushes;
+
+	std::string m_Name;
+	bool m_OverflowLogged;
+	float m_WaitMicroseconds;
+	// Last completed frame, for DrawImGui()
+	GLsizeiptr m_FrameBytes;
+	int m_FramePushes;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Counts every global operator new in the process, and per thread. AllocationCounter.cpp replaces
+// the global allocation functions, so this works without any changes at the call sites.
+class AllocationCounter
+{
+public:
+	static size_t GetCount() { return m_Count.load(std::memory_order_relaxed); }
+	// Only the calling thread's allocations, so another thread running meanwhile does not count
+	static size_t GetThreadCount() { return m_ThreadCount; }
+
+	static void Increment()
+	{
+		m_Count.fetch_add(1, std::memory_order_relaxed);
+		m_ThreadCount++;
+	}
+
+private:
+	static std::atomic<size_t> m_Count;
+	static thread_local size_t m_ThreadCount;
+};
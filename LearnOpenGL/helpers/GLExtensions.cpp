@@ -0,0 +1,40 @@
+#include "GLExtensions.h"
+
+std::unordered_set<std::string> GLExtensions::m_Extensions;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC GLExtensions::m_MaxShaderCompilerThreads = nullptr;
+PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC GLExtensions::m_MultiDrawElementsIndirectCount = nullptr;
+
+void GLExtensions::Init(GLADloadproc loader)
+{
+	int extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (int i = 0; i < extensionCount; i++)
+	{
+		m_Extensions.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+	}
+
+	if (IsSupported("GL_KHR_parallel_shader_compile"))
+		m_MaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(loader("glMaxShaderCompilerThreadsKHR"));
+	else if (IsSupported("GL_ARB_parallel_shader_compile"))
+		m_MaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(loader("glMaxShaderCompilerThreadsARB"));
+
+	if (IsSupported("GL_ARB_indirect_parameters"))
+		m_MultiDrawElementsIndirectCount = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC>(loader("glMultiDrawElementsIndirectCountARB"));
+}
+
+bool GLExtensions::IsSupported(const std::string& name)
+{
+	return m_Extensions.count(name) != 0;
+}
+
+void GLExtensions::MaxShaderCompilerThreads(GLuint count)
+{
+	if (m_MaxShaderCompilerThreads)
+		m_MaxShaderCompilerThreads(count);
+}
+
+void GLExtensions::MultiDrawElementsIndirectCount(GLenum mode, GLenum type, const void* indirect, GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride)
+{
+	if (m_MultiDrawElementsIndirectCount)
+		m_MultiDrawElementsIndirectCount(mode, type, indirect, drawCount, maxDrawCount, stride);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_set>
+
+// Our GLAD loader is generated for plain GL 4.5 without extensions, so the few extension
+// entry points and enums we use are declared and loaded here.
+
+// GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// GL_ARB_indirect_parameters (core in 4.6)
+#ifndef GL_PARAMETER_BUFFER_ARB
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#endif
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC)(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+
+class GLExtensions
+{
+public:
+	static void Init(GLADloadproc loader);
+
+	static bool IsSupported(const std::string& name);
+
+	static bool HasParallelShaderCompile() { return m_MaxShaderCompilerThreads != nullptr; }
+	static void MaxShaderCompilerThreads(GLuint count);
+
+	// Draw count read from the buffer bound to GL_PARAMETER_BUFFER_ARB
+	static bool HasIndirectDrawCount() { return m_MultiDrawElementsIndirectCount != nullptr; }
+	static void MultiDrawElementsIndirectCount(GLenum mode, GLenum type, const void* indirect, GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+
+private:
+	static std::unordered_set<std::string> m_Extensions;
+	static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC m_MaxShaderCompilerThreads;
+	static PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC m_MultiDrawElementsIndirectCount;
+};
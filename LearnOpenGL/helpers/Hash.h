@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// 64-bit non-cryptographic content hash (XXH64 algorithm).
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// Formats a hash as a fixed-width hex string, handy for cache file names.
+std::string HashToString(uint64_t hash);
@@ -2,6 +2,7 @@
 #include <sstream>
 
 HANDLE Logger::hConsole;
+std::mutex Logger::m_Mutex;
 
 /* Init */
 void Logger::Init()
@@ -40,6 +41,7 @@ void Logger::LogError(const std::string& msg)
 
 void Logger::LogColor(const std::string& msg, int color)
 {
+	std::lock_guard<std::mutex> lock(m_Mutex);
 	SetConsoleTextAttribute(hConsole, color);
 	std::cout << msg << std::endl;
 	SetConsoleTextAttribute(hConsole, LOG_COLOR_DEFAULT);
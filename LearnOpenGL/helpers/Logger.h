@@ -1,6 +1,10 @@
 #pragma once
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <Windows.h>
 
 #define LOG_COLOR_DEFAULT 7
@@ -23,4 +27,6 @@ private:
 
 private:
 	static HANDLE hConsole;
+	// The main and render threads both log, the colour and the line go out together
+	static std::mutex m_Mutex;
 };
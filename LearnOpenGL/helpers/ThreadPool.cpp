@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+	: m_Task(nullptr)
+	, m_Count(0)
+	, m_Next(0)
+	, m_Busy(0)
+	, m_Generation(0)
+	, m_Quit(false)
+{
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_Threads.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_WorkReady.notify_all();
+
+	for (std::thread& thread : m_Threads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& task)
+{
+	if (count <= 0)
+		return;
+
+	// Not worth waking anyone up for
+	if (m_Threads.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Task = &task;
+		m_Count = count;
+		m_Next = 0;
+		m_Busy = static_cast<unsigned int>(m_Threads.size());
+		m_Generation++;
+	}
+	m_WorkReady.notify_all();
+
+	RunTasks();
+
+	// Every worker checks in, even the ones that woke up after the tasks ran out
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_WorkDone.wait(lock, [this]() { return m_Busy == 0; });
+	m_Task = nullptr;
+}
+
+unsigned int ThreadPool::DefaultThreadCount()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkReady.wait(lock, [&]() { return m_Quit || m_Generation != seenGeneration; });
+			if (m_Quit)
+				return;
+			seenGeneration = m_Generation;
+		}
+
+		RunTasks();
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			last = --m_Busy == 0;
+		}
+		if (last)
+			m_WorkDone.notify_one();
+	}
+}
+
+void ThreadPool::RunTasks()
+{
+	for (int i = m_Next++; i < m_Count; i = m_Next++)
+	{
+		(*m_Task)(i);
+	}
+}
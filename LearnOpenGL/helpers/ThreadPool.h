@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for splitting per-frame CPU work into independent tasks.
+// The threads are started once, so dispatching work every frame does not create threads or allocate.
+class ThreadPool
+{
+public:
+	// Defaults to one worker per hardware thread, minus the calling thread which helps out
+	explicit ThreadPool(unsigned int threadCount = DefaultThreadCount());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Runs task(0) .. task(count - 1) on the workers and the calling thread, returns once all are done.
+	// Tasks must not depend on each other or call ParallelFor themselves.
+	void ParallelFor(int count, const std::function<void(int)>& task);
+
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_Threads.size()); }
+
+	static unsigned int DefaultThreadCount();
+
+private:
+	void WorkerLoop();
+	void RunTasks();
+
+private:
+	std::vector<std::thread> m_Threads;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkReady;
+	std::condition_variable m_WorkDone;
+
+	const std::function<void(int)>* m_Task;
+	int m_Count;
+	std::atomic<int> m_Next;
+	unsigned int m_Busy;
+	uint64_t m_Generation;
+	bool m_Quit;
+};
@@ -0,0 +1,44 @@
+#version 450 core
+// Lighting pass of the deferred path, drawn as a fullscreen quad with framebuffer_vertex.glsl.
+// Permutation defines as in lit_fragment.glsl; the specular mask is always read from the G-buffer.
+#include "include/scene_lights.glsl"
+#include "include/gbuffer.glsl"
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform Material material;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+
+	// Nothing was drawn here, leave it to the skybox
+	if (depth == 1.0)
+		discard;
+
+	// World position from the depth buffer, no position target needed
+	vec4 ndc = vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 world = inverseViewProjection * ndc;
+
+	vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+
+	Surface surface;
+	surface.position = world.xyz / world.w;
+	surface.normal = DecodeNormal(texelFetch(gNormal, pixel, 0).rg);
+	surface.viewDir = normalize(viewPos - surface.position);
+	surface.albedo = albedoSpecular.rgb;
+	surface.specMask = albedoSpecular.a;
+	surface.shininess = material.shininess;
+
+	FragColor = vec4(CalcSceneLighting(surface, vec4(gl_FragCoord.xy, depth, 1.0)), 1.0);
+
+	// Lets the forward passes after this one depth test against the deferred geometry
+	gl_FragDepth = depth;
+}
@@ -3,9 +3,10 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
 
-uniform mat4 view;
-uniform mat4 projection;
+// Per object, computed on the CPU (TransformBatch)
 uniform mat4 model;
+uniform mat4 modelViewProjection;
+uniform mat3x4 normalMatrix;
 
 out VS_OUT
 {
@@ -16,8 +17,8 @@ out VS_OUT
 
 void main()
 {
-	vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
+	vs_out.Normal = mat3(normalMatrix) * aNormal;
 	vs_out.Position = vec3(model * vec4(aPos, 1.0));
 	vs_out.TexCoords = aTexCoords;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = modelViewProjection * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 450 core
+// Geometry pass of the deferred path, drawn with lit_vertex.glsl.
+// HAS_SPECULAR_MAP is injected by ShaderPermutations (see LightingFeatures).
+#include "include/lighting.glsl"
+#include "include/gbuffer.glsl"
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+layout(location = 0) out vec4 gAlbedoSpecular;
+layout(location = 1) out vec2 gNormal;
+
+uniform Material material;
+
+void main()
+{
+	vec4 diffuseSpecular = texture(material.diffuseSpecular, TexCoords);
+
+#ifdef HAS_SPECULAR_MAP
+	gAlbedoSpecular = diffuseSpecular;
+#else
+	gAlbedoSpecular = vec4(diffuseSpecular.rgb, 0.0);
+#endif
+	gNormal = EncodeNormal(normalize(Normal));
+}
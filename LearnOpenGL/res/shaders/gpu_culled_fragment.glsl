@@ -0,0 +1,13 @@
+#version 450 core
+in vec3 WorldPos;
+flat in vec4 InstanceColor;
+
+out vec4 FragColor;
+
+void main()
+{
+	// Faceted, the props have no normals
+	vec3 normal = normalize(cross(dFdx(WorldPos), dFdy(WorldPos)));
+	float light = 0.35 + 0.65 * max(dot(normal, normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+	FragColor = vec4(InstanceColor.rgb * light, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 450 core
+layout(location = 0) in vec3 aPos;
+// baseInstance of the draw command, which GpuCulling sets to the object's index
+layout(location = 1) in uint aObject;
+
+layout(std140, binding = 0) uniform Matrices
+{
+	mat4 projection;
+	mat4 view;
+};
+
+#include "include/instances.glsl"
+
+out vec3 WorldPos;
+flat out vec4 InstanceColor;
+
+void main()
+{
+	Instance instance = instances[aObject];
+	vec4 worldPos = instance.model * vec4(aPos, 1.0);
+	gl_Position = projection * view * worldPos;
+	WorldPos = worldPos.xyz;
+	InstanceColor = instance.color;
+}
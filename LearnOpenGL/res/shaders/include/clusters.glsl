@@ -0,0 +1,73 @@
+#pragma once
+// Clustered point lights, binned on the CPU by LightClusters.
+// Include after lighting.glsl.
+
+struct ClusteredLight
+{
+	vec4 positionRadius;	// world space, w = radius of influence
+	vec4 ambientConstant;
+	vec4 diffuseLinear;
+	vec4 specularQuadratic;
+};
+
+layout(std140, binding = 1) uniform ClusterParams
+{
+	uvec4 gridSize;		// xyz = clusters per axis
+	vec4 zParams;		// x = slice scale, y = slice bias, z = near, w = far
+	vec4 tileSize;		// xy = tile size in pixels
+};
+
+layout(std430, binding = 1) readonly buffer ClusterLights
+{
+	ClusteredLight clusterLights[];
+};
+
+layout(std430, binding = 2) readonly buffer ClusterRanges
+{
+	uvec2 clusterRanges[];	// x = first index, y = light count
+};
+
+layout(std430, binding = 3) readonly buffer ClusterLightIndices
+{
+	uint clusterLightIndices[];
+};
+
+// Which froxel a fragment falls in, from its window position and depth buffer value
+uint GetClusterIndex(vec4 fragCoord)
+{
+	// Undo the perspective depth mapping to get the positive view-space distance
+	float ndcDepth = fragCoord.z * 2.0 - 1.0;
+	float viewDepth = 2.0 * zParams.z * zParams.w / (zParams.w + zParams.z - ndcDepth * (zParams.w - zParams.z));
+
+	uvec3 cluster;
+	cluster.xy = min(uvec2(fragCoord.xy / tileSize.xy), gridSize.xy - 1u);
+	cluster.z = uint(clamp(log(viewDepth) * zParams.x + zParams.y, 0.0, float(gridSize.z - 1u)));
+	return cluster.x + cluster.y * gridSize.x + cluster.z * gridSize.x * gridSize.y;
+}
+
+vec3 CalcClusteredLights(Surface surface, vec4 fragCoord)
+{
+	uvec2 range = clusterRanges[GetClusterIndex(fragCoord)];
+
+	vec3 result = vec3(0.0);
+	for (uint i = range.x; i < range.x + range.y; i++)
+	{
+		ClusteredLight clustered = clusterLights[clusterLightIndices[i]];
+
+		// The froxel box is conservative, skip the fragments outside the sphere itself
+		vec3 toLight = clustered.positionRadius.xyz - surface.position;
+		if (dot(toLight, toLight) > clustered.positionRadius.w * clustered.positionRadius.w)
+			continue;
+
+		PointLight light;
+		light.position = clustered.positionRadius.xyz;
+		light.ambient = clustered.ambientConstant.rgb;
+		light.constant = clustered.ambientConstant.w;
+		light.diffuse = clustered.diffuseLinear.rgb;
+		light.linear = clustered.diffuseLinear.w;
+		light.specular = clustered.specularQuadratic.rgb;
+		light.quadratic = clustered.specularQuadratic.w;
+		result += CalcPointLight(light, surface, 1.0);
+	}
+	return result;
+}
@@ -0,0 +1,18 @@
+#pragma once
+// Camera and light constants, written once per frame into the UniformRing (FrameBlock in
+// UniformBlocks.h) and bound at a fixed point, so switching lit programs never re-uploads them.
+#include "lighting.glsl"
+
+#define MAX_POINT_LIGHTS 4
+
+layout(std140, binding = 2) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPos;
+
+	DirLight dirLight;
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	SpotLight spotLight;
+};
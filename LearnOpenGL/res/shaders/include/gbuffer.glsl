@@ -0,0 +1,27 @@
+#pragma once
+// G-buffer layout shared by gbuffer_fragment.glsl and deferred_fragment.glsl (see GBuffer):
+//   0:     RGBA8  albedo rgb, specular mask a
+//   1:     RG16   octahedral normal, remapped to [0, 1]
+//   depth: 32F    the world position is reconstructed from it
+
+vec2 OctahedronWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Projects the unit normal onto an octahedron and unfolds its lower half over the upper one
+vec2 EncodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : OctahedronWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+vec3 DecodeNormal(vec2 encoded)
+{
+	encoded = encoded * 2.0 - 1.0;
+	vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
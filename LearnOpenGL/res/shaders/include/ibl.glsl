@@ -0,0 +1,34 @@
+#pragma once
+// Ambient light from the skybox, baked by ImageBasedLighting: diffuse irradiance as 9 spherical
+// harmonics coefficients and specular as a GGX prefiltered cubemap, rougher down the mip chain.
+// Include after lighting.glsl.
+
+layout(std140, binding = 5) uniform Environment
+{
+	vec4 irradianceSH[9];	// rgb, convolved with the cosine lobe and divided by pi
+	vec4 environmentParams;	// x = last prefiltered mip, y = diffuse intensity, z = specular intensity
+};
+
+layout(binding = 10) uniform samplerCube prefilteredEnvironment;
+
+// Irradiance / pi arriving at a surface facing n, the basis constants are folded into the coefficients
+vec3 CalcIrradiance(vec3 n)
+{
+	return irradianceSH[0].rgb
+		+ irradianceSH[1].rgb * n.y + irradianceSH[2].rgb * n.z + irradianceSH[3].rgb * n.x
+		+ irradianceSH[4].rgb * (n.x * n.y) + irradianceSH[5].rgb * (n.y * n.z)
+		+ irradianceSH[6].rgb * (3.0 * n.z * n.z - 1.0)
+		+ irradianceSH[7].rgb * (n.x * n.z) + irradianceSH[8].rgb * (n.x * n.x - n.y * n.y);
+}
+
+vec3 CalcEnvironmentLight(Surface surface)
+{
+	vec3 diffuse = CalcIrradiance(surface.normal) * surface.albedo * environmentParams.y;
+
+	// The Phong exponent as a GGX roughness picks the prefiltered mip
+	float roughness = sqrt(2.0 / (surface.shininess + 2.0));
+	vec3 R = reflect(-surface.viewDir, surface.normal);
+	vec3 specular = textureLod(prefilteredEnvironment, R, roughness * environmentParams.x).rgb * surface.specMask * environmentParams.z;
+
+	return diffuse + specular;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+// Per-instance data written by InstanceBuffer, indexed with gl_InstanceID.
+
+struct Instance
+{
+	mat4 model;
+	mat3x4 normalMatrix;	// inverse transpose of model, columns padded to vec4
+	vec4 color;				// the flat color or tint of the instance
+};
+
+layout(std430, binding = 4) readonly buffer Instances
+{
+	Instance instances[];
+};
@@ -0,0 +1,134 @@
+#pragma once
+// Light types and Phong lighting shared by every lit shader.
+// Honours HAS_SPECULAR_MAP, so define it (or not) before including this file.
+// The light structs live in the std140 Frame block (include/frame.glsl): members are ordered so
+// every float fills the padding after a vec3, and FrameBlock in UniformBlocks.h mirrors them.
+
+struct Material
+{
+	sampler2D diffuseSpecular; // rgb = diffuse, a = specular mask
+	float shininess;
+};
+
+struct DirLight
+{
+	vec3 direction;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct PointLight
+{
+	vec3 position;
+	float constant;
+	vec3 ambient;
+	float linear;
+	vec3 diffuse;
+	float quadratic;
+	vec3 specular;
+};
+
+struct SpotLight
+{
+	vec3 position;
+	float cutOff;
+	vec3 direction;
+	float outerCutOff;
+	vec3 ambient;
+	float constant;
+	vec3 diffuse;
+	float linear;
+	vec3 specular;
+	float quadratic;
+};
+
+// Everything the lighting functions need to know about the shaded point
+struct Surface
+{
+	vec3 position;
+	vec3 normal;
+	vec3 viewDir;
+	vec3 albedo;
+	float specMask;
+	float shininess;
+};
+
+// Compiled out entirely for meshes without a specular map
+vec3 CalcSpecular(vec3 lightSpecular, vec3 lightDir, Surface surface)
+{
+#ifdef HAS_SPECULAR_MAP
+	vec3 reflectDir = reflect(-lightDir, surface.normal);
+	float spec = pow(max(dot(surface.viewDir, reflectDir), 0.0), surface.shininess);
+	return lightSpecular * spec * surface.specMask;
+#else
+	return vec3(0.0);
+#endif
+}
+
+// shadow scales the diffuse and specular terms, 1 = unshadowed
+vec3 CalcDirLight(DirLight light, Surface surface, float shadow)
+{
+	vec3 lightDir = normalize(-light.direction);
+	
+	// diffuse
+	float diff = max(dot(surface.normal, lightDir), 0.0);
+	
+	// combine results
+	vec3 ambient  = light.ambient  * surface.albedo;
+	vec3 diffuse  = light.diffuse  * diff * surface.albedo;
+	vec3 specular = CalcSpecular(light.specular, lightDir, surface);
+	
+	return (ambient + shadow * (diffuse + specular));
+}
+
+// shadow as in CalcDirLight
+vec3 CalcPointLight(PointLight light, Surface surface, float shadow)
+{
+	vec3 lightDir = normalize(light.position - surface.position);
+	
+	// diffuse
+	float diff = max(dot(surface.normal, lightDir), 0.0);
+
+	// attenuation
+	float distance    = length(light.position - surface.position);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+	// combine results
+	vec3 ambient  = light.ambient  * surface.albedo;
+	vec3 diffuse  = light.diffuse  * diff * surface.albedo;
+	vec3 specular = CalcSpecular(light.specular, lightDir, surface);
+	ambient  *= attenuation;
+	diffuse  *= attenuation;
+	specular *= attenuation;
+
+	return (ambient + shadow * (diffuse + specular));
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface surface, float shadow)
+{
+	vec3 lightDir = normalize(light.position - surface.position);
+
+	// diffuse
+	float diff = max(dot(surface.normal, lightDir), 0.0);
+	
+	// attenuation
+	float distance = length(light.position - surface.position);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	
+	// spotlight intensity
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = light.cutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+	
+	// combine results
+	vec3 ambient  = light.ambient  * surface.albedo;
+	vec3 diffuse  = light.diffuse  * diff * surface.albedo;
+	vec3 specular = CalcSpecular(light.specular, lightDir, surface);
+	ambient  *= attenuation * intensity;
+	diffuse  *= attenuation * intensity;
+	specular *= attenuation * intensity;
+	
+	return (ambient + shadow * (diffuse + specular));
+}
@@ -0,0 +1,11 @@
+#pragma once
+// Per-draw matrices, computed on the CPU (TransformBatch) and written by the RenderQueue into the
+// UniformRing, one range bound per draw (ObjectBlock in UniformBlocks.h). The normal matrix is the
+// inverse transpose of model with its columns padded to vec4.
+
+layout(std140, binding = 6) uniform Object
+{
+	mat4 model;
+	mat4 modelViewProjection;
+	mat3x4 normalMatrix;
+};
@@ -0,0 +1,75 @@
+#pragma once
+// The sum over the scene's lights, shared by the forward and deferred paths.
+// Lights are compiled in or out by the permutation defines (see LightingFeatures):
+// NR_POINT_LIGHTS, HAS_DIR_LIGHT, HAS_DIR_SHADOWS, HAS_SPOT_LIGHT, HAS_CLUSTERED_LIGHTS, HAS_LOCAL_SHADOWS,
+// HAS_IBL
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 4
+#endif
+
+#include "lighting.glsl"
+#include "frame.glsl"
+#ifdef HAS_CLUSTERED_LIGHTS
+#include "clusters.glsl"
+#endif
+#ifdef HAS_DIR_SHADOWS
+#include "shadows.glsl"
+#endif
+#ifdef HAS_LOCAL_SHADOWS
+#include "shadow_atlas.glsl"
+#endif
+#ifdef HAS_IBL
+#include "ibl.glsl"
+#endif
+
+#if NR_POINT_LIGHTS > MAX_POINT_LIGHTS
+#error NR_POINT_LIGHTS exceeds the point lights in the Frame block
+#endif
+
+// fragCoord is gl_FragCoord, or its equivalent in a fullscreen pass, for the cluster lookup
+vec3 CalcSceneLighting(Surface surface, vec4 fragCoord)
+{
+	vec3 result = vec3(0.0);
+
+	// phase 1: Directional lighting
+#ifdef HAS_DIR_LIGHT
+#ifdef HAS_DIR_SHADOWS
+	float dirShadow = CalcDirShadow(surface, normalize(-dirLight.direction));
+#else
+	float dirShadow = 1.0;
+#endif
+	result += CalcDirLight(dirLight, surface, dirShadow);
+#endif
+
+	// phase 2: Point lights, either only those binned into this fragment's cluster or all of them
+#ifdef HAS_CLUSTERED_LIGHTS
+	result += CalcClusteredLights(surface, fragCoord);
+#elif NR_POINT_LIGHTS > 0
+	for (int i = 0; i < NR_POINT_LIGHTS; i++)
+	{
+#ifdef HAS_LOCAL_SHADOWS
+		float pointShadow = CalcPointShadow(i, surface, pointLights[i].position);
+#else
+		float pointShadow = 1.0;
+#endif
+		result += CalcPointLight(pointLights[i], surface, pointShadow);
+	}
+#endif
+
+	// phase 3: Spot light
+#ifdef HAS_SPOT_LIGHT
+#ifdef HAS_LOCAL_SHADOWS
+	float spotShadow = CalcSpotShadow(surface, spotLight.position);
+#else
+	float spotShadow = 1.0;
+#endif
+	result += CalcSpotLight(spotLight, surface, spotShadow);
+#endif
+
+	// phase 4: Ambient light from the skybox
+#ifdef HAS_IBL
+	result += CalcEnvironmentLight(surface);
+#endif
+
+	return result;
+}
@@ -0,0 +1,67 @@
+#pragma once
+// Point and spot light shadows, rendered into tiles of one depth atlas by ShadowAtlas.
+// Include after frame.glsl.
+
+struct ShadowTile
+{
+	mat4 viewProjection;
+	vec4 rect;		// xy = atlas uv origin, z = uv size, w = world texel size per unit of distance (0 = not rendered yet)
+};
+
+layout(std140, binding = 4) uniform ShadowAtlas
+{
+	ShadowTile pointShadowTiles[MAX_POINT_LIGHTS * 6];	// six cube faces per point light: +X, -X, +Y, -Y, +Z, -Z
+	ShadowTile spotShadowTile;
+	vec4 atlasParams;	// x = 1 / atlas size, y = normal offset in texels
+};
+
+layout(binding = 9) uniform sampler2DShadow shadowAtlas;
+
+// 1 = fully lit, 0 = fully in shadow
+float SampleShadowTile(ShadowTile tile, Surface surface, vec3 lightPosition)
+{
+	if (tile.rect.w == 0.0)
+		return 1.0;
+
+	// Texels grow with the distance to the light, and so does the offset that keeps a surface out of its own shadow
+	float normalOffset = distance(surface.position, lightPosition) * tile.rect.w * atlasParams.y;
+	vec4 clip = tile.viewProjection * vec4(surface.position + surface.normal * normalOffset, 1.0);
+	vec3 ndc = clip.xyz / clip.w;
+	vec2 uv = tile.rect.xy + (ndc.xy * 0.5 + 0.5) * tile.rect.z;
+	float depth = ndc.z * 0.5 + 0.5;
+
+	// 3x3 taps of hardware 2x2 PCF, kept inside the tile so they never read a neighbour
+	vec2 tileMin = tile.rect.xy + 1.5 * atlasParams.x;
+	vec2 tileMax = tile.rect.xy + tile.rect.z - 1.5 * atlasParams.x;
+	float lit = 0.0;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			vec2 tap = clamp(uv + vec2(x, y) * atlasParams.x, tileMin, tileMax);
+			lit += texture(shadowAtlas, vec3(tap, depth));
+		}
+	}
+	return lit / 9.0;
+}
+
+float CalcPointShadow(int light, Surface surface, vec3 lightPosition)
+{
+	// The cube face the surface is seen through from the light
+	vec3 toSurface = surface.position - lightPosition;
+	vec3 absolute = abs(toSurface);
+	int face;
+	if (absolute.x >= absolute.y && absolute.x >= absolute.z)
+		face = toSurface.x > 0.0 ? 0 : 1;
+	else if (absolute.y >= absolute.z)
+		face = toSurface.y > 0.0 ? 2 : 3;
+	else
+		face = toSurface.z > 0.0 ? 4 : 5;
+
+	return SampleShadowTile(pointShadowTiles[light * 6 + face], surface, lightPosition);
+}
+
+float CalcSpotShadow(Surface surface, vec3 lightPosition)
+{
+	return SampleShadowTile(spotShadowTile, surface, lightPosition);
+}
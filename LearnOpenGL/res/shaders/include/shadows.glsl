@@ -0,0 +1,50 @@
+#pragma once
+// Cascaded shadow maps of the directional light, rendered by ShadowCascades.
+// Include after frame.glsl.
+
+#define SHADOW_CASCADE_COUNT 4
+
+layout(std140, binding = 3) uniform Shadows
+{
+	mat4 cascadeViewProjections[SHADOW_CASCADE_COUNT];
+	vec4 cascadeSplits;		// far view depth of each cascade
+	vec4 cascadeTexelSizes;	// world size of one shadow map texel in each cascade
+	vec4 shadowParams;		// x = normal offset in texels, y = view depth where the shadows start fading out
+};
+
+layout(binding = 8) uniform sampler2DArrayShadow shadowCascades;
+
+// 1 = fully lit, 0 = fully in shadow
+float CalcDirShadow(Surface surface, vec3 lightDir)
+{
+	float viewDepth = -(view * vec4(surface.position, 1.0)).z;
+	if (viewDepth >= cascadeSplits[SHADOW_CASCADE_COUNT - 1])
+		return 1.0;
+
+	int cascade = 0;
+	for (int i = 0; i < SHADOW_CASCADE_COUNT - 1; i++)
+	{
+		if (viewDepth > cascadeSplits[i])
+			cascade = i + 1;
+	}
+
+	// Push the lookup off the surface along its normal, more so where it faces away from the light
+	float normalOffset = cascadeTexelSizes[cascade] * shadowParams.x * (1.0 - 0.5 * max(dot(surface.normal, lightDir), 0.0));
+	vec4 lightPosition = cascadeViewProjections[cascade] * vec4(surface.position + surface.normal * normalOffset, 1.0);
+	vec3 shadowCoord = lightPosition.xyz * 0.5 + 0.5;
+
+	// 3x3 taps of hardware 2x2 PCF
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowCascades, 0).xy);
+	float lit = 0.0;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			lit += texture(shadowCascades, vec4(shadowCoord.xy + vec2(x, y) * texelSize, float(cascade), shadowCoord.z));
+		}
+	}
+	lit /= 9.0;
+
+	float fade = clamp((viewDepth - shadowParams.y) / (cascadeSplits[SHADOW_CASCADE_COUNT - 1] - shadowParams.y), 0.0, 1.0);
+	return mix(lit, 1.0, fade);
+}
@@ -1,51 +1,8 @@
 #version 450 core
-struct Material
-{
-	sampler2D diffuse;
-	sampler2D specular;
-	float shininess;
-};
-
-struct DirLight
-{
-	vec3 direction;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-struct PointLight
-{
-	vec3 position;
-
-	float constant;
-	float linear;
-	float quadratic;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-struct SpotLight
-{
-	bool useSpotlight;
-	vec3 position;
-	vec3 direction;
-	float cutOff;
-	float outerCutOff;
-	
-	float constant;
-	float linear;
-	float quadratic;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-#define NR_POINT_LIGHTS 4
+// Permutation defines, injected by ShaderPermutations (see LightingFeatures):
+// NR_POINT_LIGHTS, HAS_DIR_LIGHT, HAS_DIR_SHADOWS, HAS_SPOT_LIGHT, HAS_SPECULAR_MAP, HAS_CLUSTERED_LIGHTS,
+// HAS_LOCAL_SHADOWS, HAS_IBL
+#include "include/scene_lights.glsl"
 
 in vec3 FragPos;
 in vec3 Normal;
@@ -53,114 +10,20 @@ in vec2 TexCoords;
 
 out vec4 FragColor;
 
-uniform vec3 viewPos;
 uniform Material material;
 
-// Lights
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-
 void main()
 {
-	// properties
-	vec3 norm = normalize(Normal);
-	vec3 viewDir = normalize(viewPos - FragPos);
+	// one fetch for the whole material, shared by every light
+	vec4 diffuseSpecular = texture(material.diffuseSpecular, TexCoords);
 
-	// phase 1: Directional lighting
-	vec3 result = CalcDirLight(dirLight, norm, viewDir);
-	
-	// phase 2: Point lights
-	for (int i = 0; i < NR_POINT_LIGHTS; i++)
-	{
-		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
-	}
-	
-	// phase 3: Spot light
-	if (spotLight.useSpotlight)
-	{
-		result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
-	}
-
-	FragColor = vec4(result, 1.0);
-}
-
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-	vec3 lightDir = normalize(-light.direction);
-	
-	// diffuse
-	float diff = max(dot(normal, lightDir), 0.0);
-	
-	// specular
-	vec3 reflectDir = reflect(-lightDir, normal);
-	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-	
-	// combine results
-	vec3 ambient  = light.ambient  * vec3(texture(material.diffuse, TexCoords));
-	vec3 diffuse  = light.diffuse  * diff * vec3(texture(material.diffuse, TexCoords));
-	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-	
-	return (ambient + diffuse + specular);
-}
-
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-	vec3 lightDir = normalize(light.position - fragPos);
-	
-	// diffuse
-	float diff = max(dot(normal, lightDir), 0.0);
-
-	// specular
-	vec3 reflectDir = reflect(-lightDir, normal);
-	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-
-	// attenuation
-	float distance    = length(light.position - fragPos);
-	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-
-	// combine results
-	vec3 ambient  = light.ambient  * vec3(texture(material.diffuse, TexCoords));
-	vec3 diffuse  = light.diffuse  * diff * vec3(texture(material.diffuse, TexCoords));
-	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-	ambient  *= attenuation;
-	diffuse  *= attenuation;
-	specular *= attenuation;
-
-	return (ambient + diffuse + specular);
-}
-
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-	vec3 lightDir = normalize(light.position - fragPos);
+	Surface surface;
+	surface.position = FragPos;
+	surface.normal = normalize(Normal);
+	surface.viewDir = normalize(viewPos - FragPos);
+	surface.albedo = diffuseSpecular.rgb;
+	surface.specMask = diffuseSpecular.a;
+	surface.shininess = material.shininess;
 
-	// diffuse
-	float diff = max(dot(normal, lightDir), 0.0);
-	
-	// specular
-	vec3 reflectDir = reflect(-lightDir, normal);
-	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-	
-	// attenuation
-	float distance = length(light.position - fragPos);
-	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-	
-	// spotlight intensity
-	float theta = dot(lightDir, normalize(-light.direction));
-	float epsilon = light.cutOff - light.outerCutOff;
-	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-	
-	// combine results
-	vec3 ambient  = light.ambient  * vec3(texture(material.diffuse, TexCoords));
-	vec3 diffuse  = light.diffuse  * diff * vec3(texture(material.diffuse, TexCoords));
-	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-	ambient  *= attenuation * intensity;
-	diffuse  *= attenuation * intensity;
-	specular *= attenuation * intensity;
-	
-	return (ambient + diffuse + specular);
+	FragColor = vec4(CalcSceneLighting(surface, gl_FragCoord), 1.0);
 }
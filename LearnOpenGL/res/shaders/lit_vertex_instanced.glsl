@@ -0,0 +1,24 @@
+#version 450 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+// lit_vertex.glsl with the per-object matrices read from InstanceBuffer. The camera comes from
+// the Frame block the fragment stage already declares.
+#include "include/frame.glsl"
+#include "include/instances.glsl"
+
+void main()
+{
+	Instance instance = instances[gl_InstanceID];
+	vec4 worldPos = instance.model * vec4(aPos, 1.0);
+	gl_Position = projection * view * worldPos;
+	FragPos = vec3(worldPos);
+	Normal = mat3(instance.normalMatrix) * aNormal;
+	TexCoords = aTexCoords;
+}
@@ -0,0 +1,6 @@
+#version 450 core
+// Nothing to write, the depth comes from rasterization
+
+void main()
+{
+}
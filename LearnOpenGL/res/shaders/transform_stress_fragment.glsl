@@ -0,0 +1,12 @@
+#version 450 core
+// Reads every output of transform_stress_vertex.glsl so none of the work is optimized away
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+void main()
+{
+	FragColor = vec4(normalize(Normal) * 0.5 + 0.5, fract(TexCoords.x + FragPos.z));
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 450 core
+// The inputs and outputs of lit_vertex.glsl, drawn by TransformBenchmark. With PER_VERTEX_MATRICES
+// the MVP and the normal matrix are derived in the shader, the way lit_vertex.glsl used to.
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 model;
+#ifdef PER_VERTEX_MATRICES
+uniform mat4 view;
+uniform mat4 projection;
+#else
+uniform mat4 modelViewProjection;
+uniform mat3x4 normalMatrix;
+#endif
+
+void main()
+{
+#ifdef PER_VERTEX_MATRICES
+	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	Normal = mat3(transpose(inverse(model))) * aNormal;
+#else
+	gl_Position = modelViewProjection * vec4(aPos, 1.0);
+	Normal = mat3(normalMatrix) * aNormal;
+#endif
+	FragPos = vec3(model * vec4(aPos, 1.0));
+	TexCoords = aTexCoords;
+}
\ No newline at end of file
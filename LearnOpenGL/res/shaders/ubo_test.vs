@@ -1,12 +1,12 @@
 #version 450 core
 layout(location = 0) in vec3 aPos;
 
-layout(std140) uniform Matrices
+layout(std140, binding = 0) uniform Matrices
 {
 	mat4 projection;
 	mat4 view;
 };
-uniform mat4 model;
+#include "include/object.glsl"
 
 void main()
 {
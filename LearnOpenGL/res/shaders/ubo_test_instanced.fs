@@ -0,0 +1,9 @@
+#version 450 core
+flat in vec4 InstanceColor;
+
+out vec4 FragColor;
+
+void main()
+{
+	FragColor = InstanceColor;
+}
@@ -0,0 +1,19 @@
+#version 450 core
+layout(location = 0) in vec3 aPos;
+
+layout(std140, binding = 0) uniform Matrices
+{
+	mat4 projection;
+	mat4 view;
+};
+
+#include "include/instances.glsl"
+
+flat out vec4 InstanceColor;
+
+void main()
+{
+	Instance instance = instances[gl_InstanceID];
+	gl_Position = projection * view * instance.model * vec4(aPos, 1.0);
+	InstanceColor = instance.color;
+}